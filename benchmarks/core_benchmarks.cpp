@@ -0,0 +1,167 @@
+#include <benchmark/benchmark.h>
+
+#include <data.h>
+#include <operations.h>
+#include <preview_pipeline.h>
+#include <registration.h>
+#include <synthetic.h>
+#include <utils.h>
+
+/// <summary>
+/// Creates a single reproducible view of a synthetic surface.
+/// </summary>
+static open3d::geometry::PointCloud make_cloud(size_t count, uint64_t seed) {
+    SyntheticParameters parameters;
+    parameters.view_count = 1;
+    parameters.points_per_view = count;
+    parameters.seed = seed;
+    return SyntheticScene(parameters).generate_cloud(0);
+}
+
+static Eigen::Matrix4d small_motion() {
+    return make_matrix(0.01, -0.02, 0.015, 0.05, -0.03, 0.02);
+}
+
+/// Sizes around the threshold below which parallel_for stays on the calling thread.
+static void threading_sizes(benchmark::internal::Benchmark* benchmark) {
+    for (int64_t count : { 1000, 10000, 19999, 20000, 40000, 1000000 }) {
+        benchmark->Arg(count);
+    }
+}
+
+static void BM_RecalculateTransform(benchmark::State& state) {
+    Entry entry(make_cloud(size_t(state.range(0)), 1));
+    Eigen::Matrix4d motion = small_motion();
+
+    // Both calls recalculate the transformed data.
+    for (auto _ : state) {
+        entry.do_transform(motion);
+        entry.undo_transform();
+        benchmark::DoNotOptimize(entry.get_transformed().points_.data());
+    }
+
+    state.SetItemsProcessed(2 * state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RecalculateTransform)->Apply(threading_sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_EntryCopy(benchmark::State& state) {
+    Entry entry(make_cloud(size_t(state.range(0)), 2));
+
+    for (auto _ : state) {
+        Entry copy(entry);
+        benchmark::DoNotOptimize(copy.get_transformed().points_.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EntryCopy)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+
+static void BM_ColorizeUniform(benchmark::State& state) {
+    Entry entry(make_cloud(size_t(state.range(0)), 3));
+
+    for (auto _ : state) {
+        PreviewPipeline::colorize(entry, nullptr, 0.0);
+        benchmark::DoNotOptimize(entry.get_display_colors().get());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ColorizeUniform)->Apply(threading_sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_ColorizeResiduals(benchmark::State& state) {
+    size_t count = size_t(state.range(0));
+    Entry entry(make_cloud(count, 4));
+
+    std::vector<double> residuals(count);
+    for (size_t i = 0; i < count; i++) {
+        residuals[i] = double(i % 100) / 50.0;
+    }
+
+    for (auto _ : state) {
+        PreviewPipeline::colorize(entry, &residuals, 1.0);
+        benchmark::DoNotOptimize(entry.get_display_colors().get());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ColorizeResiduals)->Apply(threading_sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_GetTransformation(benchmark::State& state) {
+    // Few points, so that building the stack does not dominate the setup.
+    Entry entry(make_cloud(16, 5));
+    Eigen::Matrix4d motion = small_motion();
+
+    for (int64_t i = 0; i < state.range(0); i++) {
+        entry.do_transform(motion);
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(entry.get_transformation());
+    }
+}
+BENCHMARK(BM_GetTransformation)->Arg(1)->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_MakeMatrix(benchmark::State& state) {
+    double angle = 0.0;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(make_matrix(angle, 0.2, -0.3, 1.0, 2.0, 3.0));
+        angle += 1e-6;
+    }
+}
+BENCHMARK(BM_MakeMatrix);
+
+static void BM_Merge(benchmark::State& state) {
+    size_t count = size_t(state.range(0));
+    auto first = std::make_shared<Entry>(make_cloud(count, 6));
+    auto second = std::make_shared<Entry>(make_cloud(count, 7));
+    second->do_transform(small_motion());
+
+    std::vector<MergePart> parts = { capture_merge_part(first), capture_merge_part(second) };
+
+    for (auto _ : state) {
+        auto merged = merge_parts(parts);
+        benchmark::DoNotOptimize(merged.get());
+    }
+
+    state.SetItemsProcessed(2 * state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Merge)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+static void BM_Icp(benchmark::State& state) {
+    SyntheticParameters parameters;
+    parameters.points_per_view = size_t(state.range(0));
+    parameters.overlap = 0.7;
+    parameters.seed = 8;
+    SyntheticScene scene(parameters);
+
+    std::shared_ptr<Entry> target = scene.generate_entry(0);
+    std::shared_ptr<Entry> source = scene.generate_entry(1);
+
+    RegistrationMethod method = RegistrationMethod(state.range(1));
+    Eigen::Matrix4d transformation = Eigen::Matrix4d::Identity();
+    int iterations = 0;
+
+    for (auto _ : state) {
+        RegistrationOutput output = register_entries(*source, *target, method);
+        transformation = output.result.transformation_;
+        iterations = output.iterations;
+        benchmark::DoNotOptimize(transformation);
+    }
+
+    // The registration starts from the identity, so its result is compared to the ground truth directly.
+    TransformationError error = compare_transformations(transformation, scene.get_ground_truth(1));
+    state.counters["rotation_error"] = error.rotation;
+    state.counters["translation_error"] = error.translation;
+    state.counters["icp_iterations"] = iterations;
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Icp)
+    ->Args({ 10000, POINT_TO_POINT })
+    ->Args({ 100000, POINT_TO_POINT })
+    ->Args({ 100000, POINT_TO_PLANE })
+    ->Args({ 100000, GENERALIZED_ICP })
+    ->Args({ 1000000, POINT_TO_PLANE })
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
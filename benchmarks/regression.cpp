@@ -0,0 +1,529 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include <data.h>
+#include <operations.h>
+#include <registration.h>
+#include <synthetic.h>
+#include <utils.h>
+
+/// Every scenario is run this many times; the fastest run counts.
+static const int REGRESSION_REPEATS = 3;
+/// Allowed slowdown relative to the baseline.
+static const double DEFAULT_TIME_BUDGET = 1.3;
+/// Allowed growth of the peak memory relative to the baseline.
+static const double DEFAULT_MEMORY_BUDGET = 1.2;
+/// Time differences below this many seconds are treated as measurement noise.
+static const double TIME_SLACK = 0.01;
+/// Memory differences below this many bytes are treated as measurement noise.
+static const size_t MEMORY_SLACK = size_t(8) << 20;
+/// Exit code when there is no baseline to compare to, which ctest reports as a skipped test.
+static const int EXIT_NO_BASELINE = 77;
+
+/// Number of clouds used by the load and merge scenarios.
+static const size_t REGRESSION_CLOUDS = 4;
+/// Number of transformations in the transform burst and undo scenarios.
+static const size_t REGRESSION_TRANSFORMS = 100;
+
+struct Options {
+    size_t points = 1000000;
+    double time_budget = DEFAULT_TIME_BUDGET;
+    double memory_budget = DEFAULT_MEMORY_BUDGET;
+
+    /// <summary>
+    /// Only this scenario is run if set.
+    /// </summary>
+    std::string only;
+};
+
+struct Measurement {
+    double seconds = 0.0;
+
+    /// <summary>
+    /// Peak physical memory during the timed part, above the memory in use when it started.
+    /// </summary>
+    size_t peak_memory = 0;
+};
+
+#if defined(__linux__)
+/// <summary>
+/// Reads a memory field such as "VmRSS" from /proc/self/status, in bytes.
+/// </summary>
+static size_t read_status_field(const char* field) {
+    std::ifstream status("/proc/self/status");
+    size_t length = std::strlen(field);
+    std::string line;
+
+    while (std::getline(status, line)) {
+        if (line.compare(0, length, field) == 0 && line.size() > length && line[length] == ':') {
+            return size_t(std::stoull(line.substr(length + 1))) * 1024;
+        }
+    }
+    return 0;
+}
+#endif
+
+/// <summary>
+/// Returns the physical memory the process uses right now, in bytes. Zero where it is not known.
+/// </summary>
+static size_t get_current_memory() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.WorkingSetSize;
+#elif defined(__linux__)
+    return read_status_field("VmRSS");
+#else
+    return 0;
+#endif
+}
+
+/// <summary>
+/// Starts a new peak for `get_peak_memory`. Only Linux can do this, elsewhere the peak
+/// stays the one since the process started, which includes the untimed preparation.
+/// </summary>
+static void reset_peak_memory() {
+#if defined(__linux__)
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+#endif
+}
+
+/// <summary>
+/// Returns the largest amount of physical memory the process has used since `reset_peak_memory`, in bytes.
+/// </summary>
+static size_t get_peak_memory() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#elif defined(__linux__)
+    return read_status_field("VmHWM");
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss);
+#else
+    return size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// <summary>
+/// Measures the part of a scenario that counts, from construction to `stop`.
+/// The data a scenario prepares beforehand is neither timed nor counted towards the peak memory.
+/// </summary>
+class TimedSection {
+public:
+    TimedSection() {
+        reset_peak_memory();
+        this->memory_before = get_current_memory();
+        this->start = std::chrono::steady_clock::now();
+    }
+
+    Measurement stop() const {
+        Measurement measurement;
+        measurement.seconds = seconds_since(this->start);
+
+        size_t peak = get_peak_memory();
+        measurement.peak_memory = peak > this->memory_before ? peak - this->memory_before : 0;
+        return measurement;
+    }
+
+private:
+    size_t memory_before;
+    std::chrono::steady_clock::time_point start;
+};
+
+static SyntheticScene make_scene(const Options& options, size_t view_count) {
+    SyntheticParameters parameters;
+    parameters.shape = SYNTHETIC_ROOM;
+    parameters.view_count = view_count;
+    parameters.points_per_view = options.points;
+    parameters.overlap = 0.7;
+    return SyntheticScene(parameters);
+}
+
+// Scenarios prepare their data untimed and measure the rest with a `TimedSection`.
+
+static Measurement run_load(const Options& options) {
+    SyntheticScene scene = make_scene(options, REGRESSION_CLOUDS);
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "calibrator_regression";
+    std::filesystem::create_directories(directory);
+
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < scene.get_view_count(); i++) {
+        paths.push_back((directory / ("view_" + std::to_string(i) + ".ply")).string());
+        if (!scene.write_ply(i, paths.back())) {
+            throw std::runtime_error("could not write " + paths.back());
+        }
+    }
+
+    TimedSection section;
+    std::vector<std::shared_ptr<Entry>> entries;
+    for (const std::string& path : paths) {
+        entries.push_back(std::make_shared<Entry>(path, [](double) { return true; }));
+    }
+    Measurement measurement = section.stop();
+
+    std::filesystem::remove_all(directory);
+    return measurement;
+}
+
+static Measurement run_transform_burst(const Options& options) {
+    std::shared_ptr<Entry> entry = make_scene(options, 1).generate_entry(0);
+
+    // Small steps like those of a slider being dragged.
+    TimedSection section;
+    for (size_t i = 0; i < REGRESSION_TRANSFORMS; i++) {
+        entry->do_transform(make_matrix(0.001, 0.0, 0.002, 0.01, 0.0, 0.0));
+    }
+    return section.stop();
+}
+
+static Measurement run_undo_chain(const Options& options) {
+    std::shared_ptr<Entry> entry = make_scene(options, 1).generate_entry(0);
+
+    for (size_t i = 0; i < REGRESSION_TRANSFORMS; i++) {
+        entry->do_transform(make_matrix(0.001, 0.0, 0.002, 0.01, 0.0, 0.0));
+    }
+
+    TimedSection section;
+    while (entry->undo_transform()) {}
+    return section.stop();
+}
+
+static Measurement run_icp(const Options& options) {
+    SyntheticScene scene = make_scene(options, 2);
+    std::shared_ptr<Entry> target = scene.generate_entry(0);
+    std::shared_ptr<Entry> source = scene.generate_entry(1);
+
+    TimedSection section;
+    register_entries(*source, *target, POINT_TO_PLANE);
+    return section.stop();
+}
+
+static Measurement run_merge(const Options& options) {
+    SyntheticScene scene = make_scene(options, REGRESSION_CLOUDS);
+
+    std::vector<MergePart> parts;
+    for (size_t i = 0; i < scene.get_view_count(); i++) {
+        std::shared_ptr<Entry> entry = scene.generate_entry(i);
+        entry->do_transform(scene.get_ground_truth(i));
+        parts.push_back(capture_merge_part(entry));
+    }
+
+    TimedSection section;
+    std::shared_ptr<Entry> merged = merge_parts(parts);
+    return section.stop();
+}
+
+static const std::vector<std::pair<std::string, std::function<Measurement(const Options&)>>> SCENARIOS = {
+    { "load", run_load },
+    { "transform_burst", run_transform_burst },
+    { "undo_chain", run_undo_chain },
+    { "icp", run_icp },
+    { "merge", run_merge },
+};
+
+/// <summary>
+/// Runs a single scenario in this process and writes the measurement to a file.
+/// </summary>
+static int run_scenario(const std::string& name, const Options& options, const std::string& output) {
+    auto scenario = std::find_if(SCENARIOS.begin(), SCENARIOS.end(), [&name](const auto& s) { return s.first == name; });
+    if (scenario == SCENARIOS.end()) {
+        std::cerr << "Unknown scenario " << name << std::endl;
+        return 2;
+    }
+
+    // The fastest run counts, but the largest peak, so that memory is never underestimated.
+    Measurement measurement;
+    measurement.seconds = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < REGRESSION_REPEATS; i++) {
+        Measurement run = scenario->second(options);
+        measurement.seconds = std::min(measurement.seconds, run.seconds);
+        measurement.peak_memory = std::max(measurement.peak_memory, run.peak_memory);
+    }
+
+    std::ofstream file(output);
+    file << measurement.seconds << " " << measurement.peak_memory << "\n";
+    return file ? 0 : 2;
+}
+
+/// <summary>
+/// Runs every scenario, or only `Options::only`, in a fresh process, so that no scenario sees the memory of another.
+/// </summary>
+static std::map<std::string, Measurement> measure_all(const std::string& executable, const Options& options) {
+    std::map<std::string, Measurement> result;
+
+#ifdef _WIN32
+    unsigned long process_id = GetCurrentProcessId();
+#else
+    unsigned long process_id = (unsigned long)getpid();
+#endif
+
+    for (const auto& scenario : SCENARIOS) {
+        if (!options.only.empty() && scenario.first != options.only) {
+            continue;
+        }
+
+        std::cout << "Running " << scenario.first << "..." << std::endl;
+
+        // Every process and scenario has its own file, so that tests running at the same time do not mix up their results.
+        std::string output = (std::filesystem::temp_directory_path()
+            / ("calibrator_regression_" + std::to_string(process_id) + "_" + scenario.first + ".txt")).string();
+
+        std::string command = "\"\"" + executable + "\" --run " + scenario.first
+            + " --points " + std::to_string(options.points) + " --output \"" + output + "\"\"";
+#ifndef _WIN32
+        // Only cmd.exe strips the outer quotes.
+        command = command.substr(1, command.size() - 2);
+#endif
+
+        if (std::system(command.c_str()) != 0) {
+            throw std::runtime_error("scenario " + scenario.first + " failed");
+        }
+
+        Measurement measurement;
+        bool reported;
+        {
+            std::ifstream file(output);
+            reported = bool(file >> measurement.seconds >> measurement.peak_memory);
+        }
+        std::filesystem::remove(output);
+
+        if (!reported) {
+            throw std::runtime_error("scenario " + scenario.first + " did not report a result");
+        }
+        result[scenario.first] = measurement;
+    }
+
+    if (result.empty()) {
+        throw std::runtime_error("unknown scenario " + options.only);
+    }
+
+    return result;
+}
+
+static std::map<std::string, Measurement> read_baseline(const std::string& path, const Options& options) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("could not read baseline " + path);
+    }
+
+    std::map<std::string, Measurement> result;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+
+        // Measurements with a different cloud size can not be compared.
+        size_t points;
+        if (line.rfind("# points ", 0) == 0 && stream.ignore(9) >> points && points != options.points) {
+            throw std::runtime_error("baseline was recorded with " + std::to_string(points) + " points per cloud, not "
+                + std::to_string(options.points));
+        }
+
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::string name;
+        Measurement measurement;
+        if (stream >> name >> measurement.seconds >> measurement.peak_memory) {
+            result[name] = measurement;
+        }
+    }
+
+    return result;
+}
+
+static void write_baseline(const std::string& path, const std::map<std::string, Measurement>& measurements, const Options& options) {
+    std::ofstream file(path);
+    file << "# points " << options.points << "\n";
+    file << "# scenario seconds peak_bytes (above the memory in use when the timed part starts)\n";
+    for (const auto& [name, measurement] : measurements) {
+        file << name << " " << measurement.seconds << " " << measurement.peak_memory << "\n";
+    }
+
+    if (!file) {
+        throw std::runtime_error("could not write baseline " + path);
+    }
+}
+
+/// <summary>
+/// Prints a table comparing the measurements to the baseline.
+/// </summary>
+/// <returns>True if all scenarios stayed within their budgets.</returns>
+static bool report(const std::map<std::string, Measurement>& measurements, const std::map<std::string, Measurement>& baseline, const Options& options) {
+    bool success = true;
+    std::vector<std::string> failures;
+
+    std::printf("\n%-16s %10s %10s %7s %12s %12s %7s\n", "scenario", "time [s]", "baseline", "ratio", "peak [MB]", "baseline", "ratio");
+
+    for (const auto& [name, measurement] : measurements) {
+        double megabytes = double(measurement.peak_memory) / (1024.0 * 1024.0);
+        auto reference = baseline.find(name);
+
+        if (reference == baseline.end()) {
+            std::printf("%-16s %10.3f %10s %7s %12.1f %12s %7s   no baseline\n", name.c_str(), measurement.seconds, "-", "-", megabytes, "-", "-");
+            continue;
+        }
+
+        double time_ratio = measurement.seconds / std::max(reference->second.seconds, 1e-9);
+        double memory_ratio = double(measurement.peak_memory) / double(std::max<size_t>(reference->second.peak_memory, 1));
+
+        bool time_ok = measurement.seconds <= reference->second.seconds * options.time_budget + TIME_SLACK;
+        bool memory_ok = double(measurement.peak_memory) <= double(reference->second.peak_memory) * options.memory_budget + double(MEMORY_SLACK);
+
+        std::printf("%-16s %10.3f %10.3f %7.2f %12.1f %12.1f %7.2f   %s\n",
+            name.c_str(),
+            measurement.seconds, reference->second.seconds, time_ratio,
+            megabytes, double(reference->second.peak_memory) / (1024.0 * 1024.0), memory_ratio,
+            time_ok && memory_ok ? "ok" : "FAILED");
+
+        if (!time_ok) {
+            std::ostringstream message;
+            message << name << ": took " << measurement.seconds << " s, " << time_ratio
+                << " times the baseline of " << reference->second.seconds << " s (budget " << options.time_budget << ")";
+            failures.push_back(message.str());
+        }
+        if (!memory_ok) {
+            std::ostringstream message;
+            message << name << ": peak memory " << megabytes << " MB, " << memory_ratio
+                << " times the baseline (budget " << options.memory_budget << ")";
+            failures.push_back(message.str());
+        }
+
+        success = success && time_ok && memory_ok;
+    }
+
+    if (!failures.empty()) {
+        std::printf("\nBudgets exceeded:\n");
+        for (const std::string& failure : failures) {
+            std::printf("  %s\n", failure.c_str());
+        }
+    }
+
+    return success;
+}
+
+static void print_usage() {
+    std::cout
+        << "Usage: calibrator_regression (--record <baseline> | --check <baseline>) [options]\n"
+        << "  --record <file>         run all scenarios and store the results as the baseline\n"
+        << "  --check <file>          run all scenarios and compare them to the baseline\n"
+        << "  --only <scenario>       run a single scenario, as done by ctest\n"
+        << "  --points <count>        points per cloud, default 1000000\n"
+        << "  --time-budget <ratio>   allowed slowdown, default " << DEFAULT_TIME_BUDGET << "\n"
+        << "  --memory-budget <ratio> allowed growth of the peak memory, default " << DEFAULT_MEMORY_BUDGET << "\n";
+}
+
+int main(int argc, const char** argv) {
+    Options options;
+    std::string record_path;
+    std::string check_path;
+    std::string scenario;
+    std::string output;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string argument = argv[i];
+        std::string value = argv[i + 1];
+
+        if (argument == "--record") {
+            record_path = value;
+        }
+        else if (argument == "--check") {
+            check_path = value;
+        }
+        else if (argument == "--only") {
+            options.only = value;
+        }
+        else if (argument == "--points") {
+            options.points = std::stoull(value);
+        }
+        else if (argument == "--time-budget") {
+            options.time_budget = std::stod(value);
+        }
+        else if (argument == "--memory-budget") {
+            options.memory_budget = std::stod(value);
+        }
+        else if (argument == "--run") {
+            scenario = value;
+        }
+        else if (argument == "--output") {
+            output = value;
+        }
+        else {
+            print_usage();
+            return 2;
+        }
+    }
+
+    try {
+        if (!scenario.empty()) {
+            return run_scenario(scenario, options, output);
+        }
+
+        if (record_path.empty() == check_path.empty()) {
+            print_usage();
+            return 2;
+        }
+
+        // Without a baseline there is nothing to compare to, which is not a regression.
+        if (!check_path.empty() && !std::filesystem::exists(check_path)) {
+            std::cout << "No baseline at " << check_path << ", record one with --record first. Skipping." << std::endl;
+            return EXIT_NO_BASELINE;
+        }
+
+        std::map<std::string, Measurement> measurements = measure_all(argv[0], options);
+
+        if (!record_path.empty()) {
+            write_baseline(record_path, measurements, options);
+            report(measurements, {}, options);
+            std::cout << "\nBaseline written to " << record_path << std::endl;
+            return 0;
+        }
+
+        return report(measurements, read_baseline(check_path, options), options) ? 0 : 1;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+    catch (...) {
+        std::cerr << "Error: a scenario failed" << std::endl;
+        return 2;
+    }
+}
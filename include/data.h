@@ -5,19 +5,61 @@
 #include <optional>
 
 #include <functional>
+#include <unordered_map>
 
 #include <utils.h>
+#include <point_budget.h>
+#include <point_bvh.h>
+#include <point_compression.h>
+
+/// <summary>
+/// Normals and covariances estimated from the original data of an entry.
+/// </summary>
+struct SurfaceEstimate {
+    std::shared_ptr<const std::vector<Eigen::Vector3d>> normals;
+    std::shared_ptr<const std::vector<Eigen::Matrix3d>> covariances;
+};
+
+class Entry;
+
+/// <summary>
+/// Allocates an id that is unique among all entries of the process, such as "cloud_0". Safe to call from any thread.
+/// </summary>
+/// <returns></returns>
+std::string allocate_entry_id();
+
+/// <summary>
+/// A point cloud that is part of a group, together with its pose inside the group.
+/// </summary>
+struct EntryPart {
+    /// <summary>
+    /// A copy of the point cloud taken when the group was created, so that it never changes afterwards.
+    /// </summary>
+    std::shared_ptr<const Entry> entry;
+
+    /// <summary>
+    /// Transformation from the original data of `entry` into the original data of the group.
+    /// </summary>
+    Eigen::Matrix4d transformation;
+};
 
 class Entry {
     /// <summary>
-    /// The original data.
+    /// The original data. Never changes and is shared between copies.
     /// </summary>
-    const open3d::geometry::PointCloud base;
+    std::shared_ptr<const open3d::geometry::PointCloud> base;
 
     /// <summary>
-    /// The transformed data. Equal to `base` with `get_transformation()` applied
+    /// The transformed data. Equal to `base` with `get_transformation()` applied.
+    /// Shared between copies until one of them modifies it, see `unshare_transformed`.
     /// </summary>
-    open3d::geometry::PointCloud transformed;
+    std::shared_ptr<open3d::geometry::PointCloud> transformed;
+
+    /// <summary>
+    /// Colors the entry is drawn with instead of those of `transformed`, or nullptr. Kept apart from the points,
+    /// so that coloring a copy never copies its points. Shared between copies and only ever replaced as a whole.
+    /// </summary>
+    std::shared_ptr<const std::vector<Eigen::Vector3d>> display_colors;
 
     /// <summary>
     /// A list of transformations that turns the point cloud stored
@@ -25,6 +67,17 @@ class Entry {
     /// </summary>
     std::vector<Eigen::Matrix4d> transformations;
 
+    /// <summary>
+    /// Product of `transformations`, kept up to date by `do_transform` and `undo_transform`.
+    /// </summary>
+    Eigen::Matrix4d composed_transformation = Eigen::Matrix4d::Identity();
+
+    /// <summary>
+    /// The transformation `transformed` was computed with. Differs from `composed_transformation`
+    /// only for part views, which keep the points of their part and are drawn with a model matrix instead.
+    /// </summary>
+    Eigen::Matrix4d transformed_pose = Eigen::Matrix4d::Identity();
+
     /// <summary>
     /// A list of names for entries that were used to construct this instance.
     /// Associated with them are transformations which turn the referenced entries
@@ -32,6 +85,87 @@ class Entry {
     /// </summary>
     std::vector<std::pair<std::string, Eigen::Matrix4d>> origins;
 
+    /// <summary>
+    /// The point clouds a group consists of. Empty for entries that hold points of their own.
+    /// A group references its parts instead of copying them, so `base` and `transformed` stay empty.
+    /// </summary>
+    std::vector<EntryPart> parts;
+
+    /// <summary>
+    /// The parts of a group with the transformation of the group applied, used for drawing.
+    /// Copies of the parts under ids of their own. They always share the points of the parts,
+    /// moving the group only changes their pose, see `get_model_transformation`.
+    /// </summary>
+    std::vector<std::shared_ptr<Entry>> part_views;
+
+    /// <summary>
+    /// The points of all parts of a group merged into the original data of the group, together with the normals
+    /// and the search index estimated on them. Built on first use by `flattened_view` and shared between copies.
+    /// </summary>
+    std::shared_ptr<const Entry> flattened;
+
+    /// <summary>
+    /// Normals of `base`. Estimated once by `estimate_normals()` and shared between copies.
+    /// </summary>
+    std::shared_ptr<const std::vector<Eigen::Vector3d>> base_normals;
+
+    /// <summary>
+    /// Regularized covariances of `base` as used by generalized ICP.
+    /// Estimated alongside `base_normals` and shared between copies.
+    /// </summary>
+    std::shared_ptr<const std::vector<Eigen::Matrix3d>> base_covariances;
+
+    /// <summary>
+    /// Search index over `base`. Built on first use and shared between copies.
+    /// Since transformations are rigid, it stays valid regardless of the transformation stack.
+    /// </summary>
+    std::shared_ptr<const open3d::geometry::KDTreeFlann> base_index;
+
+    /// <summary>
+    /// Drawing order of `base` used when only part of the points can be drawn.
+    /// Applies to `transformed` as well, since transformations keep the order of the points.
+    /// </summary>
+    std::shared_ptr<const LodOrder> base_lod;
+
+    /// <summary>
+    /// Hierarchy over `base` used to pick points with the mouse. Built on first use and shared between copies.
+    /// </summary>
+    std::shared_ptr<const PointBvh> base_bvh;
+
+    /// <summary>
+    /// Compact copy of `base`, built by `build_compressed` and shared between copies.
+    /// Kept after `expand`, so that compressing the entry again takes constant time.
+    /// </summary>
+    std::shared_ptr<const CompressedCloud> compressed;
+
+    /// <summary>
+    /// Whether `base` and `transformed` are empty and only `compressed` holds the points, see `compress`.
+    /// </summary>
+    bool compressed_only = false;
+
+    /// <summary>
+    /// Whether `base` was restored by `expand` and so differs from the loaded points by the quantization of the compact copy.
+    /// </summary>
+    bool lossy = false;
+
+    /// <summary>
+    /// Bounding boxes of `base`, computed once on construction.
+    /// </summary>
+    open3d::geometry::AxisAlignedBoundingBox base_bounds;
+    open3d::geometry::OrientedBoundingBox base_oriented_bounds;
+
+    /// <summary>
+    /// Bounding boxes of `transformed`, derived from the boxes of `base` and the transformation
+    /// instead of the points.
+    /// </summary>
+    open3d::geometry::AxisAlignedBoundingBox transformed_bounds;
+    open3d::geometry::OrientedBoundingBox transformed_oriented_bounds;
+
+    /// <summary>
+    /// Changes whenever `transformed` is modified. Copies share the revision of their original.
+    /// </summary>
+    uint64_t revision = 0;
+
 public:
     /// <summary>
     /// Used to disambiguate entries for rendering.
@@ -46,10 +180,15 @@ public:
     /// <summary>
     /// Contructor that creates an Entry with zero points.
     /// </summary>
-    inline Entry(const std::string& path_) : id("cloud_" + std::to_string(id_counter++)), name(path_), transformations(), base(), transformed() {}
+    inline Entry(const std::string& path_) :
+        base(std::make_shared<const open3d::geometry::PointCloud>()),
+        transformed(std::make_shared<open3d::geometry::PointCloud>()),
+        transformations(),
+        id(allocate_entry_id()),
+        name(path_) {}
 
     /// <summary>
-    /// Copy Contructor
+    /// Copy Contructor. Takes constant time, since the point data is shared until either entry modifies it.
     /// </summary>
     /// <param name="arg">Entry to be copied.</param>
     Entry(const Entry& arg);
@@ -58,8 +197,8 @@ public:
     /// Contructor that creates an Entry by loading data from a path.
     /// </summary>
     /// <param name="path">The file path. Expected to be the ply file format.</param>
-    /// <param name="update_progress">Callback for loading progress.</param>
-    Entry(const std::string path, std::function<void(double)> update_progress);
+    /// <param name="update_progress">Callback for loading progress. Returning false aborts loading.</param>
+    Entry(const std::string path, std::function<bool(double)> update_progress);
 
     /// <summary>
     /// Contructor that creates an Entry using a pre-existing cloud.
@@ -67,6 +206,13 @@ public:
     /// <param name="cloud">Input cloud.</param>
     Entry(const open3d::geometry::PointCloud& cloud);
 
+    /// <summary>
+    /// Contructor that creates a group referencing other point clouds. Takes time linear in the number of parts,
+    /// not in the number of points.
+    /// </summary>
+    /// <param name="parts">The parts. Must not be groups themselves.</param>
+    Entry(std::vector<EntryPart> parts);
+
     /// <summary>
     /// Add a transformation to the transformation stack.
     /// Updates the transformed point cloud accordingly.
@@ -82,33 +228,486 @@ public:
     std::optional<Eigen::Matrix4d> undo_transform();
 
     /// <summary>
-    /// Return a reference to the transformed data.
+    /// Return a reference to the transformed data. Empty while the entry is compressed.
     /// </summary>
     /// <returns></returns>
-    open3d::geometry::PointCloud& get_transformed();
+    const open3d::geometry::PointCloud& get_transformed() const;
 
     /// <summary>
-    /// Returns the internal transformation.
+    /// Returns the colors the entry is drawn with instead of those of the transformed data, or nullptr.
     /// </summary>
     /// <returns></returns>
-    Eigen::Matrix4d get_transformation();
+    std::shared_ptr<const std::vector<Eigen::Vector3d>> get_display_colors() const;
+
+    /// <summary>
+    /// Replaces the colors the entry is drawn with. Takes constant time, the points are not touched.
+    /// `mark_modified()` has to be called afterwards.
+    /// </summary>
+    /// <param name="colors">One color per point, or nullptr for the colors of the transformed data.</param>
+    void set_display_colors(std::shared_ptr<const std::vector<Eigen::Vector3d>> colors);
+
+    /// <summary>
+    /// Returns whether this entry and the given one hold the same transformed data in memory.
+    /// </summary>
+    /// <returns></returns>
+    bool shares_transformed(const Entry& other) const;
+
+    /// <summary>
+    /// Return a reference to the original data.
+    /// The original data never changes, so it may be read from other threads while a copy of the entry is modified.
+    /// Empty while the entry is compressed.
+    /// </summary>
+    /// <returns></returns>
+    const open3d::geometry::PointCloud& get_base() const;
+
+    /// <summary>
+    /// Returns the internal transformation. Cached, so it takes constant time regardless of the number of transformations.
+    /// </summary>
+    /// <returns></returns>
+    Eigen::Matrix4d get_transformation() const;
+
+    /// <summary>
+    /// Returns the transformation `get_transformed` has to be drawn with to appear in the pose of the entry.
+    /// The identity for everything but the part views of a group that was moved.
+    /// </summary>
+    Eigen::Matrix4d get_model_transformation() const;
 
     /// <summary>
     /// Get a list of names for entries that were used to construct this instance.
     /// </summary>
     /// <returns></returns>
     std::vector<std::pair<std::string, Eigen::Matrix4d>>& get_origins();
+    const std::vector<std::pair<std::string, Eigen::Matrix4d>>& get_origins() const;
+
+    /// <summary>
+    /// Returns whether this entry is a group, which has no points of its own.
+    /// Features that need the points in a single buffer have to flatten the group first, see `flatten_group`.
+    /// </summary>
+    /// <returns></returns>
+    bool is_group() const;
+
+    /// <summary>
+    /// Returns the parts of a group, or an empty list.
+    /// </summary>
+    /// <returns></returns>
+    const std::vector<EntryPart>& get_parts() const;
+
+    /// <summary>
+    /// Returns the parts of a group with the transformation of the group applied, or an empty list.
+    /// </summary>
+    /// <returns></returns>
+    const std::vector<std::shared_ptr<Entry>>& get_part_views() const;
+
+    /// <summary>
+    /// Returns the parts of a group for modification, copying them first so that copies of this entry are not affected.
+    /// `mark_modified()` has to be called afterwards.
+    /// </summary>
+    /// <returns></returns>
+    std::vector<std::shared_ptr<Entry>>& modify_part_views();
+
+    /// <summary>
+    /// Returns the merged points of a group, or nullptr if they were not merged yet.
+    /// </summary>
+    /// <returns></returns>
+    std::shared_ptr<const Entry> get_flattened() const;
+
+    /// <summary>
+    /// Caches the merged points of a group. Takes constant time.
+    /// </summary>
+    /// <param name="flattened">The parts merged into the original data of this group, without a transformation.</param>
+    void set_flattened(std::shared_ptr<const Entry> flattened);
+
+    /// <summary>
+    /// Returns the number of points, including those of the parts of a group.
+    /// </summary>
+    /// <returns></returns>
+    size_t get_point_count() const;
+
+    /// <summary>
+    /// Returns a value that changes whenever the transformed data is modified.
+    /// Two entries with equal id and revision hold the same transformed data.
+    /// </summary>
+    /// <returns></returns>
+    uint64_t get_revision() const;
+
+    /// <summary>
+    /// Assigns a new revision. Has to be called after modifying the data returned by `get_transformed()`.
+    /// </summary>
+    void mark_modified();
+
+    /// <summary>
+    /// Estimates normals and covariances of the original data, unless they are already cached.
+    /// They stay in the coordinate system of the original data and are shared with all copies,
+    /// so they never have to be estimated again. Users rotate them when needed, see `register_entries`.
+    /// </summary>
+    void estimate_normals();
+
+    /// <summary>
+    /// Estimates normals and covariances of the original data.
+    /// Only reads the original data, so it may run on another thread while the entry is modified.
+    /// </summary>
+    /// <returns>The estimate, to be handed to `set_surface`.</returns>
+    SurfaceEstimate compute_surface() const;
+
+    /// <summary>
+    /// Caches normals and covariances computed by `compute_surface`. Takes constant time.
+    /// </summary>
+    /// <param name="surface">Estimate created by this entry or a copy of it.</param>
+    void set_surface(const SurfaceEstimate& surface);
+
+    /// <summary>
+    /// Returns whether normals and covariances of the original data are cached.
+    /// </summary>
+    /// <returns></returns>
+    bool has_normals() const;
+
+    /// <summary>
+    /// Returns the cached normals and covariances of the original data. Both are nullptr if they were not estimated yet.
+    /// </summary>
+    /// <returns></returns>
+    SurfaceEstimate get_surface() const;
+
+    /// <summary>
+    /// Returns a search index over the original data, building it if necessary.
+    /// Queries in the coordinate system of the transformed data have to be
+    /// mapped through the inverse of `get_transformation()` first.
+    /// </summary>
+    /// <returns></returns>
+    const open3d::geometry::KDTreeFlann& get_index();
+
+    /// <summary>
+    /// Builds a search index over the original data.
+    /// Only reads the original data, so it may run on another thread while the entry is modified.
+    /// </summary>
+    /// <returns>The index, to be handed to `set_index`.</returns>
+    std::shared_ptr<const open3d::geometry::KDTreeFlann> build_index() const;
+
+    /// <summary>
+    /// Caches a search index built by `build_index`. Ignored while the entry is compressed.
+    /// </summary>
+    /// <param name="index">Index built by this entry or a copy of it.</param>
+    void set_index(std::shared_ptr<const open3d::geometry::KDTreeFlann> index);
+
+    /// <summary>
+    /// Returns the search index, or nullptr if it was not built yet.
+    /// </summary>
+    /// <returns></returns>
+    std::shared_ptr<const open3d::geometry::KDTreeFlann> get_cached_index() const;
+
+    /// <summary>
+    /// Builds the drawing order of the original data.
+    /// Only reads the original data, so it may run on another thread while the entry is modified.
+    /// </summary>
+    /// <returns>The order, to be handed to `set_lod`.</returns>
+    std::shared_ptr<const LodOrder> build_lod() const;
+
+    /// <summary>
+    /// Caches a drawing order built by `build_lod`.
+    /// </summary>
+    /// <param name="lod">Order built by this entry or a copy of it.</param>
+    void set_lod(std::shared_ptr<const LodOrder> lod);
+
+    /// <summary>
+    /// Returns the drawing order, or nullptr if it was not built yet.
+    /// </summary>
+    /// <returns></returns>
+    std::shared_ptr<const LodOrder> get_lod() const;
+
+    /// <summary>
+    /// Builds the picking hierarchy of the original data.
+    /// Only reads the original data, so it may run on another thread while the entry is modified.
+    /// </summary>
+    /// <returns>The hierarchy, to be handed to `set_bvh`.</returns>
+    std::shared_ptr<const PointBvh> build_bvh() const;
+
+    /// <summary>
+    /// Caches a picking hierarchy built by `build_bvh`. Ignored while the entry is compressed.
+    /// </summary>
+    /// <param name="bvh">Hierarchy built by this entry or a copy of it.</param>
+    void set_bvh(std::shared_ptr<const PointBvh> bvh);
+
+    /// <summary>
+    /// Builds a compact copy of the original data, including the normals if they are estimated.
+    /// Only reads the original data, so it may run on another thread while the entry is modified.
+    /// </summary>
+    /// <returns>The copy, to be handed to `set_compressed`.</returns>
+    std::shared_ptr<const CompressedCloud> build_compressed() const;
+
+    /// <summary>
+    /// Caches a compact copy built by `build_compressed`. The entry keeps its points until `compress` is called.
+    /// </summary>
+    /// <param name="compressed">Copy built by this entry or a copy of it.</param>
+    void set_compressed(std::shared_ptr<const CompressedCloud> compressed);
+
+    /// <summary>
+    /// Returns the compact copy, or nullptr if it was not built yet.
+    /// </summary>
+    /// <returns></returns>
+    std::shared_ptr<const CompressedCloud> get_compressed() const;
+
+    /// <summary>
+    /// Drops the original and transformed data, the normals and covariances, the search index, which holds a copy of the points,
+    /// and the picking hierarchy, leaving only the compact copy and the drawing order. Together they take 16 bytes per point
+    /// with colors and normals. Does nothing for groups or if no compact copy is cached.
+    /// A compressed entry can still be transformed and drawn, see `CompressedCloud::expand_points`,
+    /// but everything that reads its points has to call `expand` first.
+    /// </summary>
+    void compress();
+
+    /// <summary>
+    /// Restores the original and transformed data of a compressed entry from the compact copy,
+    /// along with the normals and covariances if the copy kept normals. The revision stays the same, since the points only differ by the quantization of the compact copy.
+    /// </summary>
+    void expand();
+
+    /// <summary>
+    /// Returns whether the entry is compressed, see `compress`.
+    /// </summary>
+    /// <returns></returns>
+    bool is_compressed() const;
+
+    /// <summary>
+    /// Returns whether the original data was restored from the compact copy, see `expand`.
+    /// For groups, whether any of their parts was.
+    /// </summary>
+    bool is_lossy() const;
+
+    /// <summary>
+    /// Finds the point of the transformed data closest to the origin of a ray, building the picking hierarchy if necessary.
+    /// </summary>
+    /// <param name="origin">Origin of the ray in the coordinate system of the transformed data.</param>
+    /// <param name="direction">Direction of the ray, normalized.</param>
+    /// <param name="tolerance">Distance from the ray a point may have, per unit of distance along the ray.</param>
+    /// <returns>The index of the point, or nothing if the ray misses the data. Always nothing for groups and compressed entries.</returns>
+    std::optional<size_t> pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double tolerance);
+
+    /// <summary>
+    /// Returns the axis aligned bounding box of the transformed data.
+    /// The box contains the transformed bounding boxes of the original data, so it may be slightly larger than necessary.
+    /// </summary>
+    /// <returns></returns>
+    const open3d::geometry::AxisAlignedBoundingBox& get_bounds() const;
+
+    /// <summary>
+    /// Returns an oriented bounding box of the transformed data, aligned to the principal axes of the points.
+    /// </summary>
+    /// <returns></returns>
+    const open3d::geometry::OrientedBoundingBox& get_oriented_bounds() const;
+
+    /// <summary>
+    /// Returns the approximate number of bytes held by the entry. Caches shared with copies are counted fully.
+    /// The search index is not counted, since its size is not exposed.
+    /// </summary>
+    /// <returns></returns>
+    size_t get_memory_usage() const;
+
+    /// <summary>
+    /// Returns the number of bytes held by the transformed data and the display colors alone.
+    /// For groups, this includes the parts that no longer share their points with the original parts.
+    /// </summary>
+    /// <returns></returns>
+    size_t get_transformed_memory_usage() const;
+
+    /// <summary>
+    /// Takes over normals, covariances, the search index, the drawing order, the picking hierarchy, the compact copy
+    /// and the merged points of a group from a copy of this entry, if they are missing here. Used to keep results that were computed on a copy.
+    /// Compressed entries do not take the search index and the picking hierarchy.
+    /// </summary>
+    /// <param name="other">A copy of this entry.</param>
+    void share_caches(const Entry& other);
 
 private:
+    /// <summary>
+    /// Copies an entry under another id, so that both can be drawn at the same time.
+    /// </summary>
+    Entry(const Entry& arg, const std::string& id);
+
     /// <summary>
     /// Ensures that `transformed` is equal to `base` with the transformations in `transformations` applied.
     /// </summary>
     void recalculate_transform();
+
+    /// <summary>
+    /// Computes the bounding boxes of `transformed` from the bounding boxes of `base` and `composed_transformation`.
+    /// </summary>
+    void update_bounds();
+
+    /// <summary>
+    /// Moves a part view into the given pose. Only the bounds follow, the points stay those of the part.
+    /// </summary>
+    void place(const Eigen::Matrix4d& pose);
+
+    /// <summary>
+    /// Gives this entry its own transformed data if it is shared with a copy.
+    /// Points are only allocated, since callers overwrite them anyway. Colors are copied.
+    /// </summary>
+    /// <returns>The transformed data, safe to modify.</returns>
+    open3d::geometry::PointCloud& unshare_transformed();
+
+    /// <summary>
+    /// Computes the bounding boxes of `base` and resets the bounding boxes of `transformed` to them.
+    /// </summary>
+    void init_bounds();
+
+    /// <summary>
+    /// Brings `part_views` into the current transformation. Existing views keep their points,
+    /// display colors and revision, so that moving a group needs no upload.
+    /// </summary>
+    void rebuild_part_views();
+
+    /// <summary>
+    /// Computes the bounding boxes of a group from its parts and resets the bounding boxes of `transformed` to them.
+    /// </summary>
+    void init_group_bounds();
 };
 
-class Data {
+/// <summary>
+/// The loaded point clouds in the order they are listed, indexed by id and by name.
+/// No two entries share an id or a name. Entries are kept in slots that never move when another entry
+/// is removed; a removed entry leaves an empty slot behind, and the slots are only packed once more than
+/// half of them are empty. A Fenwick tree counts the occupied slots, so converting between a position
+/// in the list and a slot, removing and appending take logarithmic time, and lookups by id or name take
+/// constant time. Ids are the stable handles that are used to find an entry again later.
+/// </summary>
+class EntryRegistry {
 public:
+    /// <summary>
+    /// Iterates the entries in the order they are listed, skipping empty slots.
+    /// </summary>
+    class const_iterator {
+    public:
+        const_iterator(std::vector<std::shared_ptr<Entry>>::const_iterator position, std::vector<std::shared_ptr<Entry>>::const_iterator end);
+
+        const std::shared_ptr<Entry>& operator*() const;
+        const_iterator& operator++();
+        bool operator!=(const const_iterator& other) const;
+
+    private:
+        void skip_empty();
+
+        std::vector<std::shared_ptr<Entry>>::const_iterator position;
+        std::vector<std::shared_ptr<Entry>>::const_iterator end;
+    };
+
+    size_t size() const;
+    bool empty() const;
+
+    /// <summary>
+    /// Returns the entry at a position of the list.
+    /// </summary>
+    /// <returns></returns>
+    const std::shared_ptr<Entry>& at(size_t index) const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /// <summary>
+    /// Returns all entries in the order they are listed.
+    /// </summary>
+    /// <returns></returns>
+    std::vector<std::shared_ptr<Entry>> get_entries() const;
+
+    /// <summary>
+    /// Returns the position of the entry with the given id, or -1 if there is none.
+    /// </summary>
+    /// <returns></returns>
+    int index_of(const std::string& id) const;
+
+    /// <summary>
+    /// Returns the entry with the given id, or nullptr if there is none.
+    /// </summary>
+    /// <returns></returns>
+    std::shared_ptr<Entry> find(const std::string& id) const;
+
+    /// <summary>
+    /// Returns whether an entry other than the one with the given id has the given name.
+    /// </summary>
+    /// <returns></returns>
+    bool is_name_taken(const std::string& name, const std::string& except_id = "") const;
+
+    /// <summary>
+    /// Returns the name if it is free, or the name followed by the lowest free number in parentheses.
+    /// </summary>
+    /// <returns></returns>
+    std::string make_unique_name(const std::string& name) const;
+
+    /// <summary>
+    /// Appends an entry. The entry is renamed with `make_unique_name` if its name is taken.
+    /// </summary>
+    /// <param name="entry">A new entry, whose id is not in the registry yet.</param>
+    void push_back(std::shared_ptr<Entry> entry);
+
+    /// <summary>
+    /// Replaces the entry at a position, usually by a modified copy with the same id.
+    /// </summary>
+    /// <param name="index">The position.</param>
+    /// <param name="entry">The new entry. Its name must not be taken by another entry.</param>
+    void replace(size_t index, std::shared_ptr<Entry> entry);
+
+    /// <summary>
+    /// Removes the entry at a position. The slots of the other entries stay where they are.
+    /// </summary>
+    void erase(size_t index);
+
+    /// <summary>
+    /// Replaces all entries, for example by a snapshot taken earlier.
+    /// </summary>
+    void assign(const std::vector<std::shared_ptr<Entry>>& entries);
+
+    void clear();
+
 private:
-    std::vector<std::shared_ptr<Entry>> loaded_clouds;
+    /// <summary>
+    /// Returns the slot of the entry at a position of the list.
+    /// </summary>
+    /// <returns></returns>
+    size_t slot_at(size_t index) const;
+
+    /// <summary>
+    /// Returns the number of occupied slots before a slot.
+    /// </summary>
+    /// <returns></returns>
+    size_t count_before(size_t slot) const;
+
+    /// <summary>
+    /// Adds a value to the count of a slot in `occupied`.
+    /// </summary>
+    void add_occupied(size_t slot, int64_t value);
+
+    /// <summary>
+    /// Appends a slot holding the given entry.
+    /// </summary>
+    void append_slot(std::shared_ptr<Entry> entry);
+
+    /// <summary>
+    /// Moves all entries to the front of `slots`, dropping the empty slots.
+    /// </summary>
+    void pack();
+
+    /// <summary>
+    /// The entries in the order they are listed, with nullptr for removed ones.
+    /// </summary>
+    std::vector<std::shared_ptr<Entry>> slots;
+
+    /// <summary>
+    /// Fenwick tree over `slots` that counts the occupied ones. Element i covers the slots
+    /// from i - (i & -i) + 1 to i, counting from 1.
+    /// </summary>
+    std::vector<size_t> occupied;
+
+    /// <summary>
+    /// Number of entries, which is the number of occupied slots.
+    /// </summary>
+    size_t count = 0;
+
+    /// <summary>
+    /// Slot of every entry by its id.
+    /// </summary>
+    std::unordered_map<std::string, size_t> by_id;
+
+    /// <summary>
+    /// Id of every entry by its name.
+    /// </summary>
+    std::unordered_map<std::string, std::string> by_name;
 };
 
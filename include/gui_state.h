@@ -9,8 +9,22 @@
 
 #include <open3d/visualization/gui/NumberEdit.h>
 
+#include <chrono>
+#include <unordered_set>
+
 #include "utils.h"
 #include "manipulator_widget.h"
+#include "snap_worker.h"
+#include "preview_pipeline.h"
+#include "job_scheduler.h"
+#include "job_panel.h"
+#include "registration.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "tracing.h"
+#include "picking_scene_widget.h"
+#include "history.h"
+#include "journal.h"
 
 class MainWindow;
 
@@ -19,13 +33,42 @@ using namespace open3d::visualization;
 enum MenuId {
     FILE_OPEN,
     FILE_EXPORT_RGB,
+    FILE_EXPORT_CLOUD,
     FILE_QUIT,
     HELP_KEYS,
     HELP_CAMERA,
     HELP_ABOUT,
     HELP_CONTACT,
     HELP_INSTRUCTION_MANUAL,
-    UNDO_TRANSFORMATION
+    UNDO_TRANSFORMATION,
+    VIEW_POINT_BUDGET,
+    VIEW_DIFFERENCE,
+    HELP_PERFORMANCE,
+    HELP_TRACE_RECORD,
+    HELP_TRACE_SAVE,
+    REDO_TRANSFORMATION,
+    FLATTEN_GROUP,
+    VIEW_COMPRESSION
+};
+
+/// <summary>
+/// State of a point cloud that is part of the scene.
+/// </summary>
+struct SceneGeometry {
+    /// <summary>
+    /// Revision of the entry when it was uploaded.
+    /// </summary>
+    uint64_t revision;
+
+    /// <summary>
+    /// Number of points uploaded, see `Entry::get_lod`.
+    /// </summary>
+    size_t point_count;
+
+    /// <summary>
+    /// Model matrix of the entry when it was last drawn, see `Entry::get_model_transformation`.
+    /// </summary>
+    Eigen::Matrix4d model;
 };
 
 //
@@ -33,8 +76,11 @@ enum MenuId {
 struct GuiState {
     /// <summary>
     /// All point clouds currently loaded.
+    /// The entries are shared with `history` and must not be modified, apart from caching results computed from
+    /// their original data. Changes are made on a copy, which then replaces the entry, see `replace_entry`.
+    /// Entries are found by id in constant time, which stays valid when other entries are removed.
     /// </summary>
-    std::vector<std::shared_ptr<Entry>> loaded_entries;
+    EntryRegistry loaded_entries;
 
     /// <summary>
     /// The current point cloud selected by the user.
@@ -48,6 +94,155 @@ struct GuiState {
     /// </summary>
     int entry_index;
 
+    /// <summary>
+    /// Ids of the point clouds chosen with "Auswahl...". They are moved together with the current point cloud,
+    /// which is part of the selection in any case, see `selected_indices`. Ids of removed point clouds are ignored.
+    /// </summary>
+    std::unordered_set<std::string> selection;
+
+    /// <summary>
+    /// Transformation the other selected point clouds are drawn with while a slider is dragged, see `preview_selection`.
+    /// </summary>
+    std::optional<Eigen::Matrix4d> selection_preview;
+
+    /// <summary>
+    /// Ids of the geometries drawn with `selection_preview`.
+    /// </summary>
+    std::unordered_set<std::string> selection_preview_ids;
+
+    /// <summary>
+    /// The point cloud from `loaded_entries` the current point cloud is compared against, if any.
+    /// </summary>
+    std::shared_ptr<Entry> reference_entry;
+
+    /// <summary>
+    /// Whether the current point cloud is colored by its distance to `reference_entry`.
+    /// </summary>
+    bool show_residuals;
+
+    /// <summary>
+    /// Distance of every point in `current_entry` to `reference_entry`.
+    /// Only filled if `show_residuals` is set.
+    /// </summary>
+    std::vector<double> residuals;
+
+    /// <summary>
+    /// Distances above this value are considered outliers when coloring by residuals.
+    /// </summary>
+    double residual_max_distance;
+
+    /// <summary>
+    /// Formatted registration quality of the current point cloud. Empty if there is no reference
+    /// or while it is computed.
+    /// </summary>
+    std::string metrics_text;
+
+    /// <summary>
+    /// The job computing `metrics_text` and `residuals`, if it is still running.
+    /// </summary>
+    std::shared_ptr<Job> metrics_job;
+
+    /// <summary>
+    /// Whether the current point cloud is drawn colored by its distance to `reference_entry`, see `update_difference`.
+    /// </summary>
+    bool difference_enabled;
+
+    /// <summary>
+    /// Distances of the current point cloud to the reference for the most recent pose they were compared in.
+    /// </summary>
+    std::shared_ptr<const CloudDifference> difference;
+
+    /// <summary>
+    /// Ids of the point clouds `difference` belongs to.
+    /// </summary>
+    std::string difference_source_id;
+    std::string difference_target_id;
+
+    /// <summary>
+    /// Temporary entry colored by `difference`, drawn in place of the current point cloud. Not part of `loaded_entries`.
+    /// </summary>
+    std::shared_ptr<Entry> difference_entry;
+
+    /// <summary>
+    /// Pose of the current point cloud relative to the reference that is compared or being compared.
+    /// </summary>
+    std::optional<Eigen::Matrix4d> difference_pose;
+
+    /// <summary>
+    /// The job comparing the point clouds in `difference_pose`, if it is still running.
+    /// </summary>
+    std::shared_ptr<Job> difference_job;
+
+    /// <summary>
+    /// Whether clicks into the scene pick corresponding points on the current point cloud and `reference_entry`.
+    /// </summary>
+    bool picking_enabled;
+
+    /// <summary>
+    /// Points picked on the current point cloud and on the reference, alternating and starting with the current point cloud.
+    /// Stored in the coordinates of the original data, so that they stay attached to their points when either cloud is moved.
+    /// </summary>
+    std::vector<Eigen::Vector3d> source_picks;
+    std::vector<Eigen::Vector3d> target_picks;
+
+    /// <summary>
+    /// Ids of the point clouds the picks were made on. Picks are discarded once either of them is no longer selected.
+    /// </summary>
+    std::string picked_source_id;
+    std::string picked_target_id;
+
+    /// <summary>
+    /// The markers of the picked points that are part of the scene, empty if there are none.
+    /// Markers are only uploaded again if they differ, since the scene is updated far more often than the picks.
+    /// </summary>
+    open3d::geometry::PointCloud shown_picks;
+
+    /// <summary>
+    /// The most recent slider change that has not been previewed yet.
+    /// Newer changes replace older ones, so that at most one preview is computed per tick.
+    /// </summary>
+    std::optional<ManipulatorEvent> pending_slider_event;
+
+    /// <summary>
+    /// Computes slider previews of the current point cloud in the background.
+    /// </summary>
+    std::unique_ptr<PreviewPipeline> preview_pipeline;
+
+    /// <summary>
+    /// Snapshot of the current point cloud the previews of the ongoing drag are computed from.
+    /// </summary>
+    std::shared_ptr<const Entry> preview_source;
+
+    /// <summary>
+    /// Aligns proxies of the current point cloud against `reference_entry` while a slider is dragged.
+    /// </summary>
+    std::unique_ptr<SnapWorker> snap_worker;
+
+    /// <summary>
+    /// Whether the current point cloud snaps onto the reference while being moved.
+    /// </summary>
+    bool snap_enabled;
+
+    /// <summary>
+    /// Set between the first slider change and the release of the slider, if snapping is possible.
+    /// </summary>
+    bool snap_dragging;
+
+    /// <summary>
+    /// Result of the most recent snapping request, if it belongs to the current slider values.
+    /// </summary>
+    std::optional<Eigen::Matrix4d> snapped_pose;
+
+    /// <summary>
+    /// The job refining the pose of the last release, see `finish_snapping`, if it is still running.
+    /// </summary>
+    std::shared_ptr<Job> snap_job;
+
+    /// <summary>
+    /// Incremented for every refinement, so that results of dropped ones are recognized.
+    /// </summary>
+    uint64_t snap_refinement;
+
     /// <summary>
     /// This widget contains the tools to manipulate point clouds.
     /// </summary>
@@ -56,11 +251,77 @@ struct GuiState {
     /// <summary>
     /// This widget is used to render the clouds.
     /// </summary>
-    std::shared_ptr<gui::SceneWidget> scene_wgt;
+    std::shared_ptr<PickingSceneWidget> scene_wgt;
+
+    /// <summary>
+    /// The point clouds that are currently part of the scene, by id.
+    /// Used to only upload point clouds that actually changed.
+    /// </summary>
+    std::unordered_map<std::string, SceneGeometry> scene_geometries;
+
+    /// <summary>
+    /// Whether the number of points drawn is limited by distributing a fixed budget among the point clouds.
+    /// </summary>
+    bool point_budget_enabled;
+
+    /// <summary>
+    /// Whether point clouds that are neither selected nor the reference are kept compressed, see `update_compression`.
+    /// </summary>
+    bool compression_enabled;
+
+    /// <summary>
+    /// Jobs building the compact copy of a point cloud in the background, by id.
+    /// </summary>
+    std::unordered_map<std::string, std::shared_ptr<Job>> compressing;
+
+    /// <summary>
+    /// Number of points each point cloud should be drawn with for the current camera, by id.
+    /// </summary>
+    std::unordered_map<std::string, size_t> point_allocation;
+
+    /// <summary>
+    /// Camera state of the last tick, used to notice camera movement.
+    /// </summary>
+    Eigen::Vector3f last_camera_position;
+    Eigen::Vector3f last_camera_forward;
+    double last_field_of_view;
+
+    /// <summary>
+    /// Time of the last camera movement. Point clouds are only refined once the camera rests.
+    /// </summary>
+    std::chrono::steady_clock::time_point camera_changed;
+
+    /// <summary>
+    /// Shows the progress of background jobs.
+    /// </summary>
+    std::shared_ptr<JobPanel> job_panel;
+
+    /// <summary>
+    /// Time of the last refresh of `job_panel`. The panel is refreshed at a fixed rate,
+    /// independent of how often jobs report progress.
+    /// </summary>
+    std::chrono::steady_clock::time_point job_panel_updated;
+
+    /// <summary>
+    /// Number of jobs shown by `job_panel` after the last refresh.
+    /// </summary>
+    size_t job_panel_count;
 
     std::shared_ptr<gui::VGrid> help_keys;
     std::shared_ptr<gui::VGrid> help_camera;
 
+    /// <summary>
+    /// Shows timings of frequent operations, see `TimerId`, and the size of every point cloud.
+    /// Operations are only timed while it is visible.
+    /// </summary>
+    std::shared_ptr<gui::Vert> help_performance;
+    std::shared_ptr<gui::Label> performance_text;
+
+    /// <summary>
+    /// Time of the last refresh of `help_performance`.
+    /// </summary>
+    std::chrono::steady_clock::time_point performance_updated;
+
     int app_menu_custom_items_index_ = -1;
     std::shared_ptr<gui::Menu> app_menu;
 
@@ -73,6 +334,22 @@ struct GuiState {
 
     MainWindow* window_ptr;
 
+    /// <summary>
+    /// Changes to the loaded point clouds that can be undone and redone.
+    /// </summary>
+    std::unique_ptr<CommandHistory> history;
+
+    /// <summary>
+    /// Records every change to the loaded point clouds, so that the session can be recovered after a crash.
+    /// </summary>
+    std::unique_ptr<Journal> journal;
+
+    /// <summary>
+    /// Runs loading, preprocessing, registration, merging and exporting in the background.
+    /// Declared last, so that running jobs are stopped before anything they report back to is destroyed.
+    /// </summary>
+    std::unique_ptr<JobScheduler> jobs;
+
 public:
     GuiState(MainWindow* window);
 
@@ -83,13 +360,311 @@ public:
     void init_lighting(const GuiSettingsModel::LightingProfile& lighting);
     void colorize_current_entry();
 
-    void add_entry(const std::string& path, std::function<void(double)> update_progress, gui::Window* window);
+    /// <summary>
+    /// Refills the list of possible references after point clouds were added, removed or renamed.
+    /// </summary>
+    void update_reference_list();
+
+    /// <summary>
+    /// Starts comparing `current_entry` against `reference_entry` in a job and displays the result once it is done.
+    /// Then recolors the current point cloud if `show_residuals` is set. Results for point clouds that changed
+    /// in the meantime are dropped.
+    /// </summary>
+    void update_metrics();
+
+    /// <summary>
+    /// Requests a preview of the current point cloud with the transformation given by the slider values of the event.
+    /// </summary>
+    void preview_slider(const ManipulatorEvent& event_);
+
+    /// <summary>
+    /// Requests a preview of the current point cloud with the given transformation applied on top.
+    /// The preview replaces `current_entry` on a later tick.
+    /// </summary>
+    void request_preview(const Eigen::Matrix4d& transformation);
+
+    /// <summary>
+    /// Discards pending and unfinished previews.
+    /// </summary>
+    void stop_preview();
+
+    /// <summary>
+    /// Called once per UI tick. Applies results of background jobs, refreshes the job panel and the performance overlay,
+    /// shows the most recent finished preview and requests a preview for the most recent pending slider change, if any.
+    /// </summary>
+    /// <returns>Whether the window needs to be redrawn.</returns>
+    bool on_tick();
+
+    /// <summary>
+    /// Prepares the snap worker for the current point cloud and the reference.
+    /// </summary>
+    void start_snapping();
+
+    /// <summary>
+    /// Stops snapping and starts a job that refines the snapped pose with a full-resolution point-to-plane registration.
+    /// The snapped pose is previewed until the job commits its result to the selection.
+    /// </summary>
+    /// <param name="slider_transform">Transformation given by the sliders, used if nothing was snapped yet.</param>
+    void finish_snapping(const Eigen::Matrix4d& slider_transform);
+
+    /// <summary>
+    /// Drops the refinement started by `finish_snapping`, if it has not been committed yet.
+    /// </summary>
+    /// <returns>Whether a refinement was dropped.</returns>
+    bool cancel_snap_refinement();
+
+    /// <summary>
+    /// Previews a pose computed by the snap worker.
+    /// </summary>
+    void on_snap_result(uint64_t id, const Eigen::Matrix4d& pose);
+
+    /// <summary>
+    /// Loads a point cloud in the background and adds it once it is loaded.
+    /// </summary>
+    void load_entry(const std::string& path);
+
+    /// <summary>
+    /// Adds a point cloud to `loaded_entries` and selects it.
+    /// </summary>
+    void add_entry(std::shared_ptr<Entry> entry);
+
+    /// <summary>
+    /// Returns a snapshot of the loaded point clouds and the selection. Only copies pointers.
+    /// </summary>
+    HistoryState capture_state() const;
+
+    /// <summary>
+    /// Records a change to the loaded point clouds that was made since `before` was captured.
+    /// </summary>
+    /// <param name="description">Describes the change for the user.</param>
+    /// <param name="before">The state before the change.</param>
+    void commit(const std::string& description, HistoryState before);
+
+    /// <summary>
+    /// Makes a snapshot the live state and selects the point cloud that was selected when it was taken.
+    /// </summary>
+    void restore_state(const HistoryState& state);
+
+    /// <summary>
+    /// Asks whether the session recorded in the journal by an earlier run should be recovered.
+    /// </summary>
+    void offer_recovery();
+
+    /// <summary>
+    /// Rebuilds the point clouds of the earlier session in the background and adds them.
+    /// </summary>
+    void recover_session();
+
+    /// <summary>
+    /// Reverts the most recent change to the loaded point clouds.
+    /// </summary>
+    void undo();
+
+    /// <summary>
+    /// Applies the most recently reverted change again.
+    /// </summary>
+    void redo();
+
+    /// <summary>
+    /// Enables the undo and redo menu items depending on whether there is anything to undo or redo.
+    /// </summary>
+    void update_history_menu();
+
+    /// <summary>
+    /// Replaces a loaded point cloud by a modified copy, keeping the reference pointed at it.
+    /// </summary>
+    /// <param name="index">Index of the point cloud in `loaded_entries`.</param>
+    /// <param name="entry">The modified copy.</param>
+    void replace_entry(int index, std::shared_ptr<Entry> entry);
+
+    /// <summary>
+    /// Applies a transformation to the current point cloud only and records it in the history.
+    /// </summary>
+    /// <param name="transformation">The transformation, applied on top of the current one.</param>
+    /// <param name="description">Describes the change for the user.</param>
+    void transform_current_entry(const Eigen::Matrix4d& transformation, const std::string& description);
+
+    /// <summary>
+    /// Applies a transformation to all selected point clouds and records it in the history as a single change.
+    /// </summary>
+    /// <param name="transformation">The transformation, applied on top of the current one of every point cloud.</param>
+    /// <param name="description">Describes the change for the user. The number of other point clouds is appended.</param>
+    void transform_selection(const Eigen::Matrix4d& transformation, std::string description);
+
+    /// <summary>
+    /// Transforms copies of several loaded point clouds in one parallel pass and replaces the point clouds with them.
+    /// </summary>
+    /// <param name="indices">Indices of the point clouds in `loaded_entries`, starting with `entry_index`.</param>
+    /// <param name="transformation">The transformation, applied on top of the current one of every point cloud.</param>
+    /// <param name="description">Describes the change for the user.</param>
+    void transform_loaded_entries(const std::vector<int>& indices, const Eigen::Matrix4d& transformation, const std::string& description);
+
+    /// <summary>
+    /// Returns the indices of the selected point clouds in `loaded_entries`, starting with `entry_index`.
+    /// Empty if no point cloud is loaded.
+    /// </summary>
+    std::vector<int> selected_indices() const;
+
+    /// <summary>
+    /// Lets the user choose the point clouds that are moved together with the current one.
+    /// </summary>
+    void show_selection_dialog();
+
+    /// <summary>
+    /// Shows the number of selected point clouds in the manipulator and expands them, see `update_compression`.
+    /// </summary>
+    void update_selection();
+
+    /// <summary>
+    /// Draws the other selected point clouds moved by the given transformation, without touching their points,
+    /// so that they follow the preview of the current point cloud. Nothing moves them back but another call without a transformation.
+    /// </summary>
+    void preview_selection(const std::optional<Eigen::Matrix4d>& transformation);
+
+    /// <summary>
+    /// Fills the list of point clouds in the manipulator with the names of `loaded_entries`.
+    /// </summary>
+    void update_entry_list();
+
+    /// <summary>
+    /// Builds the search index and estimates normals of a point cloud in the background,
+    /// so that later comparisons and registrations do not have to.
+    /// </summary>
+    void preprocess_entry(std::shared_ptr<Entry> entry);
+
+    /// <summary>
+    /// Expands the selected point clouds and the reference, and compresses all other ones if `compression_enabled` is set.
+    /// The compact copies are built in the background, so a point cloud is compressed some time after it was left.
+    /// Entries in `history` are compressed along with the loaded ones, since they share their points.
+    /// </summary>
+    void update_compression();
+
+    /// <summary>
+    /// Builds the compact copy of a point cloud in the background and compresses it once it is done,
+    /// unless it became active in the meantime.
+    /// </summary>
+    void compress_entry(std::shared_ptr<Entry> entry);
+
+    /// <summary>
+    /// Expands loaded point clouds in one parallel pass, for operations that read their points.
+    /// </summary>
+    /// <param name="indices">Indices of the point clouds in `loaded_entries`.</param>
+    void expand_entries(const std::vector<int>& indices);
+
+    /// <summary>
+    /// Calls `action` on every entry that is a copy of the entry with the given id,
+    /// including `current_entry`.
+    /// </summary>
+    void for_each_copy(const std::string& id, std::function<void(Entry&)> action);
+
+    /// <summary>
+    /// Aligns the current point cloud to another one in the background.
+    /// The result is discarded if the current point cloud is transformed in the meantime.
+    /// </summary>
+    /// <param name="target_index">Index of the point cloud in `loaded_entries` that stays in place.</param>
+    void register_current_entry(int target_index, RegistrationMethod method, bool restrict_to_overlap);
+
+    /// <summary>
+    /// Merges the current point cloud with another one and adds the result.
+    /// The result is a group that references both point clouds, see `Entry::is_group`.
+    /// </summary>
+    /// <param name="other_index">Index of the other point cloud in `loaded_entries`.</param>
+    void merge_current_entry(int other_index);
+
+    /// <summary>
+    /// Copies the points of the current group into a single point cloud in the background and replaces the group with it.
+    /// Needed for features that do not work on groups, such as the metrics and picking point pairs.
+    /// </summary>
+    void flatten_current_entry();
+
+    /// <summary>
+    /// Writes the current point cloud with its transformation applied to a file in the background.
+    /// </summary>
+    void export_current_entry(const std::string& path);
+
+    /// <summary>
+    /// Shows the current state of all background jobs.
+    /// </summary>
+    /// <returns>Whether the panel is visible.</returns>
+    bool update_job_panel();
+
+    /// <summary>
+    /// Compares the current point cloud against the reference in the background, if the difference is shown
+    /// and either point cloud was moved since the last comparison. Distances of the last comparison are
+    /// reused for points that cannot have come close to the reference.
+    /// </summary>
+    void update_difference();
+
+    /// <summary>
+    /// Picks the point under the given position in the scene, alternating between the current point cloud and the reference.
+    /// </summary>
+    /// <param name="x">Horizontal position relative to the scene widget.</param>
+    /// <param name="y">Vertical position relative to the scene widget.</param>
+    void pick_point(int x, int y);
+
+    /// <summary>
+    /// Moves the current point cloud so that its picked points match the picked points of the reference.
+    /// </summary>
+    void align_picks();
+
+    /// <summary>
+    /// Discards picks that do not belong to the selected point clouds anymore,
+    /// then shows the remaining picks in the scene and their number in the manipulator. The scene is only
+    /// changed if the picks or the poses of their point clouds changed since the last call.
+    /// </summary>
+    void show_picks();
+
+    /// <summary>
+    /// Shows the current timings and point cloud sizes in `help_performance`.
+    /// </summary>
+    void update_performance();
+
+    /// <summary>
+    /// Returns all point clouds that are drawn, using `current_entry` in place of its original,
+    /// or `difference_entry` if it is up to date and no preview is shown. Groups are replaced by their parts.
+    /// </summary>
+    std::vector<std::shared_ptr<Entry>> visible_entries();
+
+    /// <summary>
+    /// Returns the point clouds drawn for an entry of `loaded_entries`, as in `visible_entries`.
+    /// </summary>
+    /// <param name="index">Index of the entry in `loaded_entries`.</param>
+    std::vector<std::shared_ptr<Entry>> shown_entries(int index);
+
+    /// <summary>
+    /// Returns the bounds of all point clouds that are drawn, without touching their points.
+    /// </summary>
+    open3d::geometry::AxisAlignedBoundingBox scene_bounds();
+
+    /// <summary>
+    /// Distributes the point budget among the given point clouds for the current camera
+    /// and stores the result in `point_allocation`.
+    /// </summary>
+    void allocate_points(const std::vector<std::shared_ptr<Entry>>& entries);
+
+    /// <summary>
+    /// Replaces the point cloud in the scene, drawing the given number of points.
+    /// </summary>
+    void upload_entry(Entry& entry, size_t point_count);
+
+    /// <summary>
+    /// Draws an uploaded geometry with its model matrix, combined with `selection_preview` if it follows the preview.
+    /// </summary>
+    void update_geometry_transform(const std::string& id);
+
+    /// <summary>
+    /// Called once per tick. Once the camera rests, brings one point cloud to the number of
+    /// points allocated to it, so that refinement is spread over several ticks.
+    /// </summary>
+    /// <returns>Whether the scene changed.</returns>
+    bool refine_points();
 
     /// <summary>
-    /// Re-renders existing point clouds.
+    /// Brings the scene up to date with the loaded point clouds.
+    /// Only point clouds that were added, removed or modified since the last call are uploaded or removed.
+    /// Point clouds that were allocated fewer points are reduced immediately; more points are added by `refine_points`.
     /// </summary>
-    /// <param name="only_update_selected">Settings this value to true only re-renders the cloud in current_entry.
-    /// Doing so may heavily increase performance.</param>
+    /// <param name="only_update_selected">Settings this value to true only checks the selected clouds for changes, see `selected_indices`.</param>
     /// <param name="keep_camera">Settings this value to true ensures that the camera stays at its current location.</param>
     void set_scene(bool only_update_selected, bool keep_camera);
 };
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <data.h>
+
+/// <summary>
+/// The loaded point clouds at one point in time.
+/// Entries are shared with the live state and other snapshots, so taking a snapshot only copies pointers.
+/// This only works as long as loaded entries are never modified in place: changes are made on a copy,
+/// which then replaces the entry. Copies share their point data until they modify it, see `Entry`.
+/// </summary>
+struct HistoryState {
+    std::vector<std::shared_ptr<Entry>> entries;
+
+    /// <summary>
+    /// Index of the selected entry, or -1 if there are none.
+    /// </summary>
+    int entry_index = -1;
+};
+
+/// <summary>
+/// A change to the loaded point clouds that can be undone and redone.
+/// </summary>
+struct HistoryCommand {
+    /// <summary>
+    /// Describes the change for the user, such as "Verschieben: Wolke 1".
+    /// </summary>
+    std::string description;
+
+    HistoryState before;
+    HistoryState after;
+
+    /// <summary>
+    /// Number of bytes kept alive only by this command, see `CommandHistory::retained_memory`.
+    /// </summary>
+    size_t memory;
+};
+
+/// <summary>
+/// Application wide list of changes to the loaded point clouds.
+/// Undoing and redoing swap whole snapshots, so no points have to be recomputed.
+/// The oldest changes are forgotten once the snapshots hold more memory than allowed.
+/// </summary>
+class CommandHistory {
+public:
+    /// <param name="memory_limit">Number of bytes the snapshots may keep alive in addition to the live state.
+    /// The most recent change is kept regardless.</param>
+    CommandHistory(size_t memory_limit);
+
+    /// <summary>
+    /// Records a change. Changes that were undone can no longer be redone afterwards.
+    /// </summary>
+    /// <param name="description">Describes the change for the user.</param>
+    /// <param name="before">The state before the change.</param>
+    /// <param name="after">The state after the change, which should be the live state.</param>
+    void push(const std::string& description, HistoryState before, HistoryState after);
+
+    /// <summary>
+    /// Steps back one change.
+    /// </summary>
+    /// <returns>The state to restore, or nothing if there is no change to undo.</returns>
+    std::optional<HistoryState> undo();
+
+    /// <summary>
+    /// Steps forward one change that was undone.
+    /// </summary>
+    /// <returns>The state to restore, or nothing if there is no change to redo.</returns>
+    std::optional<HistoryState> redo();
+
+    bool can_undo() const;
+    bool can_redo() const;
+
+    /// <summary>
+    /// Returns the description of the change `undo` would revert, or an empty string.
+    /// </summary>
+    std::string get_undo_description() const;
+
+    /// <summary>
+    /// Returns the description of the change `redo` would apply, or an empty string.
+    /// </summary>
+    std::string get_redo_description() const;
+
+    /// <summary>
+    /// Returns the number of bytes currently kept alive by the recorded changes.
+    /// </summary>
+    size_t get_memory_usage() const;
+
+    /// <summary>
+    /// Forgets all changes.
+    /// </summary>
+    void clear();
+
+    /// <summary>
+    /// Calls `action` on every entry of every recorded state. Entries shared between states are visited once per state.
+    /// Only meant for changes that keep the snapshots intact, such as compressing entries, see `Entry::compress`.
+    /// </summary>
+    void for_each_entry(const std::function<void(Entry&)>& action);
+
+    /// <summary>
+    /// Estimates the memory of every recorded change again and forgets the oldest changes if the limit is exceeded.
+    /// Called after entries in the snapshots changed their size, such as by `Entry::compress` or `Entry::expand`.
+    /// </summary>
+    void update_memory_usage();
+
+private:
+    /// <summary>
+    /// Estimates the memory a command keeps alive: the entries the change replaced or removed.
+    /// Entries that were replaced by a copy only count their transformed data, unless they share it as well.
+    /// </summary>
+    static size_t retained_memory(const HistoryState& before, const HistoryState& after);
+
+    /// <summary>
+    /// Forgets the oldest changes until the memory limit is met. Changes that can be redone are kept.
+    /// </summary>
+    void enforce_limit();
+
+    size_t memory_limit;
+    size_t memory_usage;
+
+    /// <summary>
+    /// Changes that can be undone, oldest first.
+    /// </summary>
+    std::deque<HistoryCommand> undo_stack;
+
+    /// <summary>
+    /// Changes that were undone, most recently undone last.
+    /// </summary>
+    std::vector<HistoryCommand> redo_stack;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+
+#include <job_scheduler.h>
+
+using namespace open3d::visualization;
+
+/// <summary>
+/// Lists running and queued background jobs with their progress and allows cancelling them.
+/// Shows a fixed number of rows; further jobs are summarized in a single line.
+/// </summary>
+class JobPanel : public gui::Vert {
+public:
+    JobPanel(int spacing, const gui::Margins& margins = gui::Margins());
+
+    /// <summary>
+    /// Displays the given jobs. Hides the panel if there are none.
+    /// </summary>
+    /// <param name="jobs">Queued and running jobs, see `JobScheduler::get_jobs`.</param>
+    void SetJobs(const std::vector<std::shared_ptr<Job>>& jobs);
+
+private:
+    struct Row {
+        std::shared_ptr<gui::Horiz> layout;
+        std::shared_ptr<gui::Label> name;
+        std::shared_ptr<gui::ProgressBar> progress;
+        std::shared_ptr<gui::Button> cancel;
+        std::weak_ptr<Job> job;
+    };
+
+    std::vector<std::shared_ptr<Row>> rows;
+    std::shared_ptr<gui::Label> overflow;
+};
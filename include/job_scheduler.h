@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Order in which queued jobs are started. Jobs of equal priority start in submission order.
+/// </summary>
+enum JobPriority {
+    /// <summary>
+    /// Work the user did not ask for directly, such as precomputing caches.
+    /// </summary>
+    PRIORITY_LOW,
+    PRIORITY_NORMAL,
+    /// <summary>
+    /// Work the user is actively waiting for.
+    /// </summary>
+    PRIORITY_HIGH
+};
+
+enum JobState {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_FINISHED,
+    JOB_CANCELLED,
+    JOB_FAILED
+};
+
+/// <summary>
+/// A unit of work executed by a `JobScheduler`.
+/// Progress and cancellation are shared between the worker running the job and the user interface.
+/// </summary>
+class Job {
+    friend class JobScheduler;
+public:
+    Job(uint64_t id, const std::string& name, JobPriority priority);
+
+    uint64_t get_id() const;
+    const std::string& get_name() const;
+    JobPriority get_priority() const;
+    JobState get_state() const;
+
+    /// <summary>
+    /// Requests cancellation. Queued jobs never start, running jobs are expected to poll `is_cancelled`.
+    /// </summary>
+    void cancel();
+    bool is_cancelled() const;
+
+    /// <summary>
+    /// Reports progress from within the job.
+    /// </summary>
+    /// <param name="progress">Fraction of the work done, between 0 and 1.</param>
+    /// <returns>False if the job was cancelled and should stop.</returns>
+    bool set_progress(double progress);
+    double get_progress() const;
+
+private:
+    const uint64_t id;
+    const std::string name;
+    const JobPriority priority;
+
+    std::atomic<JobState> state;
+    std::atomic<bool> cancelled;
+    std::atomic<double> progress;
+};
+
+/// <summary>
+/// Runs jobs on a fixed number of worker threads.
+/// Jobs must not touch state owned by the user interface. Results are handed back with `post`
+/// and applied on the main thread by `dispatch`.
+/// </summary>
+class JobScheduler {
+public:
+    /// <summary>
+    /// Starts the worker threads.
+    /// </summary>
+    /// <param name="worker_count">Number of jobs running at the same time. Chosen from the number of cores if zero.</param>
+    JobScheduler(size_t worker_count = 0);
+
+    /// <summary>
+    /// Cancels all jobs and waits for running jobs to return. Posted callbacks are discarded.
+    /// </summary>
+    ~JobScheduler();
+
+    /// <summary>
+    /// Queues a job.
+    /// </summary>
+    /// <param name="name">Displayed while the job is queued or running.</param>
+    /// <param name="priority">Decides which queued job starts next.</param>
+    /// <param name="work">Called on a worker thread. Exceptions mark the job as failed.</param>
+    /// <returns>The job, which may be used to cancel it.</returns>
+    std::shared_ptr<Job> submit(const std::string& name, JobPriority priority, std::function<void(Job&)> work);
+
+    /// <summary>
+    /// Queues a callback to be run by the next call to `dispatch`. May be called from any thread.
+    /// </summary>
+    void post(std::function<void()> callback);
+
+    /// <summary>
+    /// Runs all posted callbacks. Must be called from the main thread.
+    /// </summary>
+    /// <returns>The number of callbacks run.</returns>
+    size_t dispatch();
+
+    /// <summary>
+    /// Returns all jobs that are queued or running, in submission order.
+    /// </summary>
+    std::vector<std::shared_ptr<Job>> get_jobs();
+
+    /// <summary>
+    /// Cancels all jobs that are queued or running.
+    /// </summary>
+    void cancel_all();
+
+private:
+    struct QueuedJob {
+        std::shared_ptr<Job> job;
+        std::function<void(Job&)> work;
+    };
+
+    struct QueueOrder {
+        bool operator()(const QueuedJob& a, const QueuedJob& b) const;
+    };
+
+    void run();
+    void retire(const std::shared_ptr<Job>& job);
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+    uint64_t next_id;
+
+    std::priority_queue<QueuedJob, std::vector<QueuedJob>, QueueOrder> queue;
+
+    /// <summary>
+    /// Jobs that are queued or running, in submission order.
+    /// </summary>
+    std::vector<std::shared_ptr<Job>> jobs;
+
+    std::mutex posted_mutex;
+    std::vector<std::function<void()>> posted;
+
+    std::vector<std::thread> workers;
+};
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <data.h>
+
+/// <summary>
+/// Kinds of records stored in a journal. The values are part of the file format.
+/// </summary>
+enum JournalRecordType {
+    /// <summary>
+    /// A session started appending to the journal. Ids are only unique within a session.
+    /// </summary>
+    JOURNAL_SESSION = 1,
+    /// <summary>
+    /// A point cloud was loaded from a file.
+    /// </summary>
+    JOURNAL_LOAD,
+    /// <summary>
+    /// A transformation was applied to a point cloud, by hand or as the result of a registration.
+    /// </summary>
+    JOURNAL_TRANSFORM,
+    JOURNAL_RENAME,
+    JOURNAL_REMOVE,
+    /// <summary>
+    /// Point clouds were merged into a group, see `group_entries`.
+    /// </summary>
+    JOURNAL_MERGE,
+    /// <summary>
+    /// A group was replaced by a point cloud holding all its points, see `flatten_group`.
+    /// </summary>
+    JOURNAL_FLATTEN,
+    /// <summary>
+    /// The loaded point clouds were replaced as a whole, by undoing or redoing a change.
+    /// </summary>
+    JOURNAL_STATE,
+    /// <summary>
+    /// A point cloud was recovered from an earlier session and given a new id.
+    /// </summary>
+    JOURNAL_ALIAS
+};
+
+/// <summary>
+/// Append-only binary log of every change to the loaded point clouds, used to recover a session after a crash.
+/// Only paths, names and matrices are written, never points, so records are small and cheap to write.
+/// Every record is flushed to the operating system right away, so a crash of the application loses nothing.
+/// Syncing to the disk is left to a thread of the journal, started by `sync` at most once per `JOURNAL_SYNC_INTERVAL`.
+/// As long as `sync` is called regularly, a crash of the system loses at most the changes of the last interval
+/// and the time between two calls. Records carry a checksum, a record torn by a crash is dropped.
+/// Every instance of the application writes its own journal and holds an exclusive lock on it, see `claim_journal`.
+/// </summary>
+class Journal {
+public:
+    /// <summary>
+    /// Opens and locks a journal for appending and starts a new session in it. Records of earlier sessions are kept
+    /// until `discard_recovered` is called. A journal that cannot be opened or is locked by another instance drops all records.
+    /// </summary>
+    /// <param name="path">The file path.</param>
+    Journal(const std::string& path);
+
+    /// <summary>
+    /// Closes the journal. The file is emptied before the lock is released and then deleted,
+    /// since a session that ends this way does not need to be recovered.
+    /// </summary>
+    ~Journal();
+
+    bool is_open() const;
+
+    /// <summary>
+    /// Lets the sync thread write the records flushed since the last sync to the disk, if that sync is long enough ago.
+    /// Never waits for the disk, so it can be called from a timer of the GUI thread.
+    /// </summary>
+    void sync();
+
+    const std::string& get_path() const;
+
+    /// <summary>
+    /// Returns the number of bytes written by earlier sessions, which can be recovered with `replay_journal`.
+    /// Zero if there is nothing to recover.
+    /// </summary>
+    /// <returns></returns>
+    uint64_t get_recovered_size() const;
+
+    /// <summary>
+    /// Forgets the earlier sessions, so that they are not offered for recovery again.
+    /// </summary>
+    void discard_recovered();
+
+    void record_load(const Entry& entry, const std::string& path);
+    void record_transform(const Entry& entry, const Eigen::Matrix4d& transformation);
+    void record_rename(const Entry& entry);
+    void record_remove(const Entry& entry);
+
+    /// <param name="group">The new group.</param>
+    /// <param name="inputs">The point clouds merged into the group, in their pose at the time of the merge.</param>
+    void record_merge(const Entry& group, const std::vector<std::shared_ptr<Entry>>& inputs);
+
+    /// <param name="entry">The new point cloud.</param>
+    /// <param name="group">The group it was created from.</param>
+    void record_flatten(const Entry& entry, const Entry& group);
+
+    /// <param name="entries">All loaded point clouds, in order.</param>
+    void record_state(const std::vector<std::shared_ptr<Entry>>& entries);
+
+    /// <param name="entry">The recovered point cloud.</param>
+    /// <param name="session">Session the point cloud was recovered from, see `RecoveredEntry`.</param>
+    /// <param name="id">Id of the point cloud in that session.</param>
+    void record_alias(const Entry& entry, uint32_t session, const std::string& id);
+
+private:
+    /// <summary>
+    /// Writes a record and flushes it to the operating system. It reaches the disk with the next `sync`.
+    /// </summary>
+    void append(JournalRecordType type, const std::vector<uint8_t>& payload);
+
+    /// <summary>
+    /// Closes the file, after waiting for a sync that is still running.
+    /// </summary>
+    /// <param name="discard">Whether to empty the file first, so that nobody takes it over once the lock is released.</param>
+    void close(bool discard);
+
+    /// <summary>
+    /// Body of the sync thread.
+    /// </summary>
+    void run_sync();
+
+    /// <summary>
+    /// Starts a new session at the end of the file, dropping a torn record left by a crash.
+    /// </summary>
+    void open(bool keep_records);
+
+    std::string path;
+    FILE* file;
+    uint64_t recovered_size;
+    std::chrono::steady_clock::time_point last_sync;
+
+    /// <summary>
+    /// Whether records were written since the last sync.
+    /// </summary>
+    bool unsynced;
+
+    /// <summary>
+    /// Held by the sync thread while it syncs, and by the GUI thread while it replaces `file`.
+    /// </summary>
+    std::mutex sync_mutex;
+    std::condition_variable sync_condition;
+    bool sync_requested;
+    bool stopping;
+    std::thread sync_thread;
+};
+
+/// <summary>
+/// Returns the path of the journal of this instance in the given directory, named after the process id.
+/// If another instance crashed and left a journal behind that is not locked and has something to recover,
+/// it is moved to that path first, so that this instance offers to recover it. At most one journal is taken over per call.
+/// </summary>
+/// <param name="directory">The directory holding the journals, usually the temporary directory.</param>
+/// <returns>The path, to be handed to `Journal`.</returns>
+std::string claim_journal(const std::string& directory);
+
+/// <summary>
+/// A point cloud rebuilt from a journal.
+/// </summary>
+struct RecoveredEntry {
+    std::shared_ptr<Entry> entry;
+
+    /// <summary>
+    /// Number of the session the point cloud was last changed in, counted from zero.
+    /// </summary>
+    uint32_t session;
+
+    /// <summary>
+    /// Id of the point cloud in that session.
+    /// </summary>
+    std::string id;
+};
+
+/// <summary>
+/// Result of `replay_journal`.
+/// </summary>
+struct JournalReplay {
+    /// <summary>
+    /// The point clouds that were loaded when the journal ended, in order.
+    /// </summary>
+    std::vector<RecoveredEntry> entries;
+
+    /// <summary>
+    /// Names of the point clouds that could not be rebuilt, because a file could not be loaded.
+    /// </summary>
+    std::vector<std::string> missing;
+
+    size_t record_count = 0;
+};
+
+/// <summary>
+/// Rebuilds the point clouds described by a journal. The records are read first to find the final pose of every
+/// point cloud, then every file is loaded once and every point cloud is transformed once, both in parallel.
+/// Registrations are not repeated, their results are part of the journal.
+/// </summary>
+/// <param name="path">The file path.</param>
+/// <param name="size">Number of bytes to read, see `Journal::get_recovered_size`.</param>
+/// <param name="update_progress">Called with the fraction done. Returning false stops the replay.</param>
+/// <returns>The point clouds, or nothing if the journal could not be read or the replay was stopped.</returns>
+std::optional<JournalReplay> replay_journal(const std::string& path, uint64_t size, std::function<bool(double)> update_progress = nullptr);
@@ -17,7 +17,7 @@ public:
 
     void SetTitle(const std::string& title);
 
-    /// Loads asynchronously, will return immediately.
+    /// Loads as a background job, will return immediately.
     void LoadCloud(const std::string& path);
 
     void ExportCurrentImage(const std::string& path);
@@ -30,7 +30,14 @@ enum ManipulatorEventType {
     SLIDER_MOUSE_RELEASE,
     INDEX_CHANGED,
     NAME_CHANGED,
-    SLIDER_VALUE_CHANGED
+    SLIDER_VALUE_CHANGED,
+    REFERENCE_CHANGED,
+    RESIDUALS_TOGGLED,
+    SNAP_TOGGLED,
+    PICKING_TOGGLED,
+    ALIGN_PAIRS_CLICKED,
+    CLEAR_PAIRS_CLICKED,
+    SELECTION_CLICKED
 };
 
 struct ManipulatorEvent {
@@ -47,6 +54,11 @@ public:
 
     std::string name;
 
+    int reference_index;
+    bool show_residuals;
+    bool snap;
+    bool picking;
+
     ManipulatorEvent(Manipulator* manipulator);
 };
 
@@ -63,10 +75,32 @@ public:
     /// <param name="name">Name of the point cloud</param>
     void SetName(const char* name);
     void ResetSliders();
+    /// <summary>
+    /// Overwrites the displayed registration quality.
+    /// </summary>
+    /// <param name="text">Formatted metrics</param>
+    void SetMetrics(const char* text);
+    /// <summary>
+    /// Overwrites the displayed state of the picked point pairs.
+    /// </summary>
+    /// <param name="text">Formatted number of pairs</param>
+    void SetPairs(const char* text);
+    void SetPicking(bool picking);
+    /// <summary>
+    /// Overwrites the displayed size of the selection.
+    /// </summary>
+    /// <param name="text">Formatted number of selected point clouds</param>
+    void SetSelection(const char* text);
     std::shared_ptr<gui::Combobox> entries;
+    /// <summary>
+    /// The point cloud the selected point cloud is compared against.
+    /// </summary>
+    std::shared_ptr<gui::Combobox> reference;
 private:
     std::shared_ptr<gui::TextEdit> name_edit;
     std::shared_ptr<gui::Button> remove;
+    std::shared_ptr<gui::Button> select;
+    std::shared_ptr<gui::Label> selection;
 
     std::shared_ptr<MouseEventSlider> x_translation;
     std::shared_ptr<MouseEventSlider> y_translation;
@@ -80,6 +114,15 @@ private:
     std::shared_ptr<gui::Button> read_matrix;
     std::shared_ptr<gui::Button> show_matrix;
 
+    std::shared_ptr<gui::Checkbox> show_residuals;
+    std::shared_ptr<gui::Checkbox> snap;
+    std::shared_ptr<gui::Label> metrics;
+
+    std::shared_ptr<gui::Checkbox> picking;
+    std::shared_ptr<gui::Label> pairs;
+    std::shared_ptr<gui::Button> align_pairs;
+    std::shared_ptr<gui::Button> clear_pairs;
+
     std::function<void(ManipulatorEvent&)> handler;
 
     std::function<void(void)> make_button_handler(ManipulatorEventType type);
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <data.h>
+
+/// <summary>
+/// Describes how well one entry is aligned against another.
+/// </summary>
+struct RegistrationMetrics {
+    /// <summary>
+    /// Number of source points that were evaluated.
+    /// </summary>
+    size_t point_count;
+
+    /// <summary>
+    /// Source points closer than this to the target are considered inliers.
+    /// </summary>
+    double max_distance;
+
+    /// <summary>
+    /// Fraction of evaluated source points that are inliers.
+    /// </summary>
+    double fitness;
+
+    /// <summary>
+    /// Root mean square distance of all inliers.
+    /// </summary>
+    double rmse;
+
+    /// <summary>
+    /// Percentiles of the distances of all evaluated source points.
+    /// </summary>
+    double p50;
+    double p90;
+    double p95;
+    double p99;
+};
+
+/// <summary>
+/// Computes the distance between transformed points of `source` and the closest transformed point of `target`.
+/// Queries run in parallel against the search index of `target`.
+/// </summary>
+/// <param name="source">The entry whose points are evaluated.</param>
+/// <param name="target">The reference entry. Its search index is built if necessary.</param>
+/// <param name="stride">Only every n-th point of `source` is evaluated.</param>
+/// <returns>One distance per evaluated source point, in the order of the source points.</returns>
+std::vector<double> compute_distances(Entry& source, Entry& target, size_t stride = 1);
+
+/// <summary>
+/// Like `compute_distances`, but with a given search index, so that neither entry is modified.
+/// </summary>
+/// <param name="source">The entry whose points are evaluated.</param>
+/// <param name="target">The reference entry.</param>
+/// <param name="target_index">Search index over the original data of `target`.</param>
+/// <param name="stride">Only every n-th point of `source` is evaluated.</param>
+/// <returns>One distance per evaluated source point, in the order of the source points.</returns>
+std::vector<double> compute_distances(const Entry& source, const Entry& target, const open3d::geometry::KDTreeFlann& target_index, size_t stride = 1);
+
+/// <summary>
+/// Summarizes a list of distances created by `compute_distances`.
+/// </summary>
+/// <param name="distances">The distances.</param>
+/// <param name="max_distance">Distances above this value are counted as outliers.</param>
+/// <returns>The summary. All values are zero if `distances` is empty.</returns>
+RegistrationMetrics compute_metrics(const std::vector<double>& distances, double max_distance);
+
+/// <summary>
+/// Maps a distance onto a color ramp from blue (zero) over green and yellow to red (`max_distance`).
+/// Larger distances are shown in gray, as such points have no counterpart in the other cloud.
+/// </summary>
+/// <param name="distance">The distance.</param>
+/// <param name="max_distance">The distance mapped to red.</param>
+/// <returns>The color.</returns>
+Eigen::Vector3d residual_color(double distance, double max_distance);
+
+/// <summary>
+/// Distances from every point of one entry to the closest point of another, for one pose of both entries relative to each other.
+/// </summary>
+struct CloudDifference {
+    /// <summary>
+    /// Maps the original data of the source into the coordinate system of the original data of the target.
+    /// </summary>
+    Eigen::Matrix4d relative_transformation;
+
+    /// <summary>
+    /// The distance mapped to red, see `residual_color`.
+    /// </summary>
+    double max_distance;
+
+    /// <summary>
+    /// One distance per point of the source, in the order of its points.
+    /// Distances above twice `max_distance` are only lower bounds, as such points are not searched any further.
+    /// </summary>
+    std::vector<double> distances;
+};
+
+/// <summary>
+/// Computes the distance of every source point to the closest target point in parallel.
+/// Since transformations are rigid, only the original data of both entries and the pose between them are needed.
+/// A result for an earlier pose lets points skip the search if they moved too little to come within reach of the target.
+/// </summary>
+/// <param name="source">Original data of the source.</param>
+/// <param name="target_index">Search index over the original data of the target.</param>
+/// <param name="relative_transformation">Maps `source` into the coordinate system of the target's original data.</param>
+/// <param name="max_distance">The distance mapped to red.</param>
+/// <param name="previous">Result for the same entries at an earlier pose. May be nullptr.</param>
+/// <param name="update_progress">Called with the fraction of points done. Returning false stops the computation.</param>
+/// <returns>The distances, or nullptr if the computation was stopped.</returns>
+std::shared_ptr<const CloudDifference> compute_difference(
+    const open3d::geometry::PointCloud& source,
+    const open3d::geometry::KDTreeFlann& target_index,
+    const Eigen::Matrix4d& relative_transformation,
+    double max_distance,
+    const CloudDifference* previous,
+    std::function<bool(double)> update_progress = nullptr
+);
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <data.h>
+
+/// <summary>
+/// Copies a cloud with the given transformation applied to its points and normals.
+/// </summary>
+/// <param name="cloud">The cloud.</param>
+/// <param name="transformation">A rigid transformation.</param>
+/// <returns>The transformed copy, with the colors of `cloud`.</returns>
+open3d::geometry::PointCloud transform_cloud(const open3d::geometry::PointCloud& cloud, const Eigen::Matrix4d& transformation);
+
+/// <summary>
+/// Copies several entries and applies the same transformation to every copy.
+/// Used to move point clouds together, for example scans that are already aligned to each other.
+/// </summary>
+/// <param name="entries">The entries, which are not modified.</param>
+/// <param name="transformation">The transformation, applied on top of the current one of every entry.</param>
+/// <returns>The transformed copies, in the order of `entries`.</returns>
+std::vector<std::shared_ptr<Entry>> transform_entries(const std::vector<std::shared_ptr<Entry>>& entries, const Eigen::Matrix4d& transformation);
+
+/// <summary>
+/// A point cloud taking part in a merge, together with the pose it is merged in.
+/// </summary>
+struct MergePart {
+    /// <summary>
+    /// The entry. Only its original data is read by the merge.
+    /// </summary>
+    std::shared_ptr<const Entry> entry;
+
+    /// <summary>
+    /// Transformation applied to the original data before merging.
+    /// </summary>
+    Eigen::Matrix4d transformation;
+
+    /// <summary>
+    /// The point clouds the entry originates from, with their transformation into the merged data.
+    /// </summary>
+    std::vector<std::pair<std::string, Eigen::Matrix4d>> origins;
+};
+
+/// <summary>
+/// Captures the current pose and origins of an entry for a later merge.
+/// Must not run while the entry is modified, but the merge itself may.
+/// </summary>
+/// <param name="entry">The entry.</param>
+/// <returns>The part, referencing the entry.</returns>
+MergePart capture_merge_part(const std::shared_ptr<Entry>& entry);
+
+/// <summary>
+/// Combines the transformed original data of several point clouds into a new entry.
+/// The new entry remembers the names and transformations of the point clouds it originates from.
+/// </summary>
+/// <param name="parts">The point clouds, captured by `capture_merge_part`.</param>
+/// <param name="update_progress">Called after every part with the fraction of parts merged. Returning false stops the merge.</param>
+/// <returns>The merged entry, or nullptr if the merge was stopped.</returns>
+std::shared_ptr<Entry> merge_parts(const std::vector<MergePart>& parts, std::function<bool(double)> update_progress = nullptr);
+
+/// <summary>
+/// Combines several point clouds into a group that references them instead of copying their points.
+/// Groups among them are not nested, their parts are taken over instead.
+/// The group remembers the names and transformations of the point clouds it originates from.
+/// </summary>
+/// <param name="entries">The point clouds in their current pose.</param>
+/// <returns>The group.</returns>
+std::shared_ptr<Entry> group_entries(const std::vector<std::shared_ptr<Entry>>& entries);
+
+/// <summary>
+/// Copies the points of a group into a single point cloud with the same name, pose and origins.
+/// Only reads the parts, which never change, so it may run on another thread.
+/// </summary>
+/// <param name="group">The group.</param>
+/// <param name="update_progress">Called after every part with the fraction of parts copied. Returning false stops copying.</param>
+/// <returns>The new entry, or nullptr if copying was stopped.</returns>
+std::shared_ptr<Entry> flatten_group(const Entry& group, std::function<bool(double)> update_progress = nullptr);
+
+/// <summary>
+/// Returns the points of a group as a single point cloud in the current pose of the group, for algorithms that need one cloud.
+/// The merged points are cached on the group, see `Entry::get_flattened`, so only the first call copies the points of the parts.
+/// Only reads the parts, so it may run on another thread on a copy of the group.
+/// </summary>
+/// <param name="group">The group.</param>
+/// <returns>A copy of the merged points that shares their caches. Hand it to `keep_flattened_caches` once caches were built on it.</returns>
+std::shared_ptr<Entry> flattened_view(Entry& group);
+
+/// <summary>
+/// Keeps the normals and the search index built on a view returned by `flattened_view`, so that later views share them.
+/// </summary>
+/// <param name="group">The group the view was taken from.</param>
+/// <param name="view">The view.</param>
+void keep_flattened_caches(Entry& group, const Entry& view);
+
+/// <summary>
+/// Writes a cloud with a transformation applied to a file. The format is chosen by the file extension.
+/// </summary>
+/// <param name="cloud">The cloud, usually the original data of an entry.</param>
+/// <param name="transformation">A rigid transformation.</param>
+/// <param name="path">The file path.</param>
+/// <param name="update_progress">Called with the fraction written. Returning false stops writing.</param>
+/// <returns>Whether the file was written completely.</returns>
+bool export_cloud(
+    const open3d::geometry::PointCloud& cloud,
+    const Eigen::Matrix4d& transformation,
+    const std::string& path,
+    std::function<bool(double)> update_progress = nullptr
+);
+
+/// <summary>
+/// Writes the points of a group with its transformation applied to a binary PLY file.
+/// The parts are transformed and written block by block, so the group is never copied as a whole.
+/// </summary>
+/// <param name="group">The group.</param>
+/// <param name="path">The file path.</param>
+/// <param name="update_progress">Called with the fraction written. Returning false stops writing.</param>
+/// <returns>Whether the file was written completely.</returns>
+bool export_group(const Entry& group, const std::string& path, std::function<bool(double)> update_progress = nullptr);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+
+#include <open3d/Open3D.h>
+
+using namespace open3d::visualization;
+
+/// <summary>
+/// Scene widget that reports clicks, meaning the left mouse button being released close to where it was pressed.
+/// All mouse events are still handled by the scene widget, so the camera can be moved as usual.
+/// </summary>
+class PickingSceneWidget : public gui::SceneWidget {
+public:
+    PickingSceneWidget();
+    virtual gui::Widget::EventResult Mouse(const gui::MouseEvent& e) override;
+
+    /// <summary>
+    /// Sets the function called on clicks with the position relative to the widget.
+    /// </summary>
+    void SetOnClicked(std::function<void(int, int)> handler);
+
+private:
+    std::function<void(int, int)> handler;
+
+    bool button_down;
+    int down_x;
+    int down_y;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+
+#include <memory>
+#include <vector>
+
+/// <summary>
+/// An ordering of the points of a cloud in which every prefix is a roughly uniform subsample of the whole cloud.
+/// Points are ordered by the depth of the first octree node they represent, so the first points cover
+/// the coarse nodes and later points refine them.
+/// </summary>
+struct LodOrder {
+    /// <summary>
+    /// Point indices in drawing order.
+    /// </summary>
+    std::vector<uint32_t> order;
+
+    /// <summary>
+    /// Number of points that represent octree nodes up to the given depth.
+    /// </summary>
+    std::vector<size_t> depth_ends;
+};
+
+/// <summary>
+/// Builds the drawing order of a cloud.
+/// </summary>
+/// <param name="cloud">The cloud.</param>
+/// <returns>The order, or nullptr if the cloud is empty or too large to be indexed with 32 bits.</returns>
+std::shared_ptr<const LodOrder> build_lod_order(const open3d::geometry::PointCloud& cloud);
+
+/// <summary>
+/// The camera a point budget is distributed for.
+/// </summary>
+struct BudgetView {
+    Eigen::Vector3d camera_position;
+
+    /// <summary>
+    /// Unit vectors along the viewing direction and towards the top of the viewport.
+    /// </summary>
+    Eigen::Vector3d camera_forward;
+    Eigen::Vector3d camera_up;
+
+    /// <summary>
+    /// Vertical field of view in degrees.
+    /// </summary>
+    double field_of_view;
+
+    /// <summary>
+    /// Size of the viewport in pixels.
+    /// </summary>
+    int viewport_width;
+    int viewport_height;
+};
+
+/// <summary>
+/// A cloud competing for a share of the point budget.
+/// </summary>
+struct BudgetRequest {
+    size_t point_count;
+
+    /// <summary>
+    /// Bounds of the cloud in world coordinates.
+    /// </summary>
+    Eigen::Vector3d min_bound;
+    Eigen::Vector3d max_bound;
+};
+
+/// <summary>
+/// Distributes a point budget among several clouds.
+/// Every cloud gets as many points as it covers pixels on screen, scaled down evenly if that exceeds the budget.
+/// Clouds whose bounding sphere lies outside the view frustum, including those behind the camera, only get
+/// a small number of points, so that they are not missing while the camera turns towards them.
+/// Clouds are drawn completely if all of them fit into the budget.
+/// </summary>
+/// <param name="requests">The clouds.</param>
+/// <param name="view">The camera.</param>
+/// <param name="budget">Total number of points that may be drawn.</param>
+/// <returns>The number of points to draw for every cloud.</returns>
+std::vector<size_t> allocate_point_budget(const std::vector<BudgetRequest>& requests, const BudgetView& view, size_t budget);
+
+/// <summary>
+/// Copies the first points of a cloud in drawing order, together with their colors.
+/// </summary>
+/// <param name="cloud">The cloud.</param>
+/// <param name="lod">Drawing order of the cloud. Points are taken with a fixed stride if missing.</param>
+/// <param name="count">Number of points to copy.</param>
+/// <param name="colors">Colors to copy instead of those of the cloud, one per point. May be nullptr.</param>
+std::shared_ptr<open3d::geometry::PointCloud> select_points(
+    const open3d::geometry::PointCloud& cloud,
+    const LodOrder* lod,
+    size_t count,
+    const std::vector<Eigen::Vector3d>* colors = nullptr
+);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+
+#include <optional>
+#include <vector>
+
+/// <summary>
+/// Bounding volume hierarchy over the points of a cloud, answering ray queries for picking.
+/// Only indices are stored; queries take the points the hierarchy was built from.
+/// </summary>
+class PointBvh {
+public:
+    /// <summary>
+    /// Builds the hierarchy by recursively splitting the points at the median of the longest axis.
+    /// </summary>
+    /// <param name="points">The points. Must be passed unchanged to `pick`.</param>
+    PointBvh(const std::vector<Eigen::Vector3d>& points);
+
+    /// <summary>
+    /// Finds the point closest to the origin of a ray among all points within a cone around the ray.
+    /// </summary>
+    /// <param name="points">The points the hierarchy was built from.</param>
+    /// <param name="origin">Origin of the ray.</param>
+    /// <param name="direction">Direction of the ray, normalized.</param>
+    /// <param name="tolerance">Distance from the ray a point may have, per unit of distance along the ray.</param>
+    /// <returns>The index of the point, or nothing if no point lies within the cone.</returns>
+    std::optional<size_t> pick(
+        const std::vector<Eigen::Vector3d>& points,
+        const Eigen::Vector3d& origin,
+        const Eigen::Vector3d& direction,
+        double tolerance
+    ) const;
+
+    /// <summary>
+    /// Returns the number of bytes held by the hierarchy.
+    /// </summary>
+    size_t get_memory_usage() const;
+
+private:
+    struct Node {
+        /// <summary>
+        /// Bounding sphere of all points below this node.
+        /// </summary>
+        Eigen::Vector3d center;
+        double radius;
+
+        /// <summary>
+        /// Range in `indices` covered by this node.
+        /// </summary>
+        uint32_t start;
+        uint32_t count;
+
+        /// <summary>
+        /// Index of the second child. The first child directly follows its parent. Zero for leaves.
+        /// </summary>
+        uint32_t second_child;
+    };
+
+    uint32_t build(const std::vector<Eigen::Vector3d>& points, uint32_t start, uint32_t end);
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> indices;
+};
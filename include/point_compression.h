@@ -0,0 +1,101 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <point_budget.h>
+
+/// <summary>
+/// Compact copy of the points, colors and normals of a cloud. Every coordinate is quantized to 16 bits within the bounding box
+/// of the points, every color channel and every component of a normal to 8 bits. A point with color and normal takes 12 bytes
+/// instead of 48 for point and color, 24 for the normal and 72 for the covariance derived from it.
+/// Restored points differ from the original ones by at most half a quantization step, 1/131070 of the extent of the box,
+/// restored normals by less than a degree.
+/// </summary>
+class CompressedCloud {
+public:
+    /// <summary>
+    /// Quantizes a cloud. Only reads it, so it may run on another thread.
+    /// </summary>
+    /// <param name="cloud">The cloud.</param>
+    /// <param name="bounds">Axis aligned bounds of the points of the cloud.</param>
+    /// <param name="normals">Unit normals of the points, or nullptr if they are not kept.</param>
+    CompressedCloud(
+        const open3d::geometry::PointCloud& cloud,
+        const open3d::geometry::AxisAlignedBoundingBox& bounds,
+        const std::vector<Eigen::Vector3d>* normals = nullptr
+    );
+
+    /// <summary>
+    /// Returns the number of points.
+    /// </summary>
+    size_t size() const;
+
+    /// <summary>
+    /// Returns the number of bytes held by the compact copy.
+    /// </summary>
+    size_t get_memory_usage() const;
+
+    /// <summary>
+    /// Restores points and colors. As long as any caller holds the result, later calls return it again
+    /// instead of restoring another copy. Safe to call from any thread.
+    /// </summary>
+    /// <returns>The restored cloud.</returns>
+    std::shared_ptr<const open3d::geometry::PointCloud> expand() const;
+
+    /// <summary>
+    /// Returns whether the normals of the points were kept.
+    /// </summary>
+    bool has_normals() const;
+
+    /// <summary>
+    /// Restores the normals, normalized again after quantization.
+    /// </summary>
+    /// <returns>The normals, or nullptr if they were not kept.</returns>
+    std::shared_ptr<const std::vector<Eigen::Vector3d>> expand_normals() const;
+
+    /// <summary>
+    /// Restores the first points in drawing order with a transformation applied, like `select_points`.
+    /// Used to draw a cloud without restoring all of it.
+    /// </summary>
+    /// <param name="transformation">A rigid transformation.</param>
+    /// <param name="lod">Drawing order of the cloud. Points are taken with a fixed stride if missing.</param>
+    /// <param name="count">Number of points to restore.</param>
+    std::shared_ptr<open3d::geometry::PointCloud> expand_points(const Eigen::Matrix4d& transformation, const LodOrder* lod, size_t count) const;
+
+private:
+    Eigen::Vector3d restore_point(size_t index) const;
+    Eigen::Vector3d restore_color(size_t index) const;
+
+    /// <summary>
+    /// Restored coordinates are `origin + step * quantized`.
+    /// </summary>
+    Eigen::Vector3d origin;
+    Eigen::Vector3d step;
+
+    /// <summary>
+    /// Three quantized coordinates per point.
+    /// </summary>
+    std::vector<uint16_t> points;
+
+    /// <summary>
+    /// Three quantized channels per point. Empty if the cloud has no colors.
+    /// </summary>
+    std::vector<uint8_t> colors;
+
+    /// <summary>
+    /// Three quantized components per point. Empty if no normals were given.
+    /// </summary>
+    std::vector<int8_t> normals;
+
+    mutable std::mutex mutex;
+
+    /// <summary>
+    /// The most recent result of `expand`, if anyone still holds it.
+    /// </summary>
+    mutable std::weak_ptr<const open3d::geometry::PointCloud> expanded;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <data.h>
+
+/// <summary>
+/// Computes transformed and colored previews of a point cloud in the background.
+/// While the main thread uploads one preview, the next one is computed. Only the most
+/// recent request is worked on, and only the most recent result is kept.
+/// </summary>
+class PreviewPipeline {
+public:
+    /// <summary>
+    /// Starts the worker thread.
+    /// </summary>
+    PreviewPipeline();
+
+    /// <summary>
+    /// Stops the worker thread, discarding pending requests.
+    /// </summary>
+    ~PreviewPipeline();
+
+    /// <summary>
+    /// Replaces the point cloud previews are computed for. Pending requests and results are discarded.
+    /// </summary>
+    /// <param name="source">A snapshot of the point cloud that is not modified afterwards.</param>
+    /// <param name="residuals">Distances used for coloring, see `colorize`. May be nullptr.</param>
+    /// <param name="max_distance">Distances above this value are outliers.</param>
+    void set_source(
+        std::shared_ptr<const Entry> source,
+        std::shared_ptr<const std::vector<double>> residuals,
+        double max_distance
+    );
+
+    /// <summary>
+    /// Requests a preview of the source with the given transformation applied on top. Replaces any pending request.
+    /// </summary>
+    void request(const Eigen::Matrix4d& transformation);
+
+    /// <summary>
+    /// Discards pending requests and results. Results of requests in progress are dropped.
+    /// </summary>
+    void cancel();
+
+    /// <summary>
+    /// Returns the most recent finished preview and removes it from the pipeline.
+    /// </summary>
+    /// <returns>The preview, or nullptr if none was finished since the last call.</returns>
+    std::shared_ptr<Entry> take();
+
+    /// <summary>
+    /// Colors a point cloud by the given distances, or uniformly if there are none for every point.
+    /// Only replaces the display colors of the entry, its points are neither copied nor modified. Marks the entry as modified.
+    /// </summary>
+    /// <param name="entry">The point cloud.</param>
+    /// <param name="residuals">Distance of every point to a reference. May be nullptr.</param>
+    /// <param name="max_distance">Distances above this value are outliers.</param>
+    static void colorize(Entry& entry, const std::vector<double>* residuals, double max_distance);
+
+private:
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+
+    /// <summary>
+    /// Incremented whenever pending work becomes obsolete.
+    /// </summary>
+    uint64_t generation;
+    std::optional<Eigen::Matrix4d> pending;
+
+    std::shared_ptr<const Entry> source;
+    std::shared_ptr<const std::vector<double>> residuals;
+    double max_distance;
+
+    /// <summary>
+    /// The finished preview that was not taken yet.
+    /// </summary>
+    std::shared_ptr<Entry> ready;
+
+    std::thread thread;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/// <summary>
+/// Operations whose duration is measured while profiling is enabled.
+/// </summary>
+enum TimerId {
+    /// <summary>
+    /// Work done by the main thread per UI tick.
+    /// </summary>
+    TIMER_TICK,
+    /// <summary>
+    /// Applying the transformation stack to a point cloud.
+    /// </summary>
+    TIMER_TRANSFORM,
+    /// <summary>
+    /// Coloring a point cloud uniformly or by its residuals.
+    /// </summary>
+    TIMER_COLORIZE,
+    /// <summary>
+    /// Handing a point cloud to the renderer.
+    /// </summary>
+    TIMER_UPLOAD,
+    /// <summary>
+    /// A registration run. The amount is the number of ICP iterations.
+    /// </summary>
+    TIMER_ICP,
+    /// <summary>
+    /// Reading a point cloud from disk. The amount is the size of the file in bytes.
+    /// </summary>
+    TIMER_LOAD,
+    TIMER_COUNT
+};
+
+/// <summary>
+/// Accumulated measurements of one operation.
+/// </summary>
+struct TimerStats {
+    /// <summary>
+    /// Number of measurements.
+    /// </summary>
+    uint64_t count;
+
+    /// <summary>
+    /// Sum of all durations.
+    /// </summary>
+    std::chrono::nanoseconds total;
+
+    /// <summary>
+    /// Duration of the most recent measurement.
+    /// </summary>
+    std::chrono::nanoseconds last;
+
+    /// <summary>
+    /// Sum of the amounts of work reported by all measurements, see `TimerId`.
+    /// </summary>
+    uint64_t amount;
+};
+
+/// <summary>
+/// Enables or disables profiling. Measurements are only taken while profiling is enabled.
+/// Enabling discards all previous measurements.
+/// </summary>
+void set_profiling_enabled(bool enabled);
+
+/// <summary>
+/// Returns whether profiling is enabled. Cheap enough to be called in hot paths.
+/// </summary>
+bool is_profiling_enabled();
+
+/// <summary>
+/// Adds a measurement. May be called from any thread.
+/// </summary>
+void record_timer(TimerId id, std::chrono::nanoseconds duration, uint64_t amount);
+
+/// <summary>
+/// Returns the measurements of an operation taken since profiling was enabled.
+/// </summary>
+TimerStats get_timer_stats(TimerId id);
+
+/// <summary>
+/// Measures the time between its construction and destruction, if profiling was enabled on construction.
+/// Otherwise, it does not read the clock at all.
+/// </summary>
+class ScopedTimer {
+public:
+    explicit ScopedTimer(TimerId id) : id(id), amount(0), running(is_profiling_enabled()) {
+        if (running) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer() {
+        if (running) {
+            record_timer(id, std::chrono::steady_clock::now() - start, amount);
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    /// <summary>
+    /// Reports the amount of work done within the measured scope, see `TimerId`.
+    /// </summary>
+    void add_amount(uint64_t amount) {
+        this->amount += amount;
+    }
+
+private:
+    TimerId id;
+    uint64_t amount;
+    bool running;
+    std::chrono::steady_clock::time_point start;
+};
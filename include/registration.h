@@ -0,0 +1,158 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+
+#include <data.h>
+
+/// <summary>
+/// Error metrics that can be minimized by the iterative closest point algorithm.
+/// </summary>
+enum RegistrationMethod {
+    /// <summary>
+    /// Minimizes the distance between corresponding points.
+    /// </summary>
+    POINT_TO_POINT,
+    /// <summary>
+    /// Minimizes the distance between source points and the tangent planes of the target.
+    /// Converges in far fewer iterations on planar surfaces.
+    /// </summary>
+    POINT_TO_PLANE,
+    /// <summary>
+    /// Minimizes the distance between the local surface models of both clouds.
+    /// </summary>
+    GENERALIZED_ICP
+};
+
+/// <summary>
+/// Indices of the points of two clouds that lie within the region in which both clouds overlap.
+/// </summary>
+struct Overlap {
+    std::vector<size_t> source_indices;
+    std::vector<size_t> target_indices;
+};
+
+/// <summary>
+/// Estimates the region in which two clouds overlap.
+/// The intersection of both bounding boxes is refined by intersecting coarse voxel occupancy grids of both clouds.
+/// </summary>
+/// <param name="source">The first cloud.</param>
+/// <param name="target">The second cloud.</param>
+/// <param name="margin">Points that are closer than this to the other cloud's occupied region are kept.</param>
+/// <returns>The points of both clouds within the overlap. Both lists are empty if the clouds do not overlap.</returns>
+Overlap estimate_overlap(
+    const open3d::geometry::PointCloud& source,
+    const open3d::geometry::PointCloud& target,
+    double margin
+);
+
+/// <summary>
+/// Parameters of a single registration run, chosen according to the density and alignment of both clouds.
+/// </summary>
+struct RegistrationParameters {
+    /// <summary>
+    /// Median distance between neighbouring points of the target.
+    /// </summary>
+    double point_spacing;
+
+    /// <summary>
+    /// Median distance between source points and their closest target point before registration.
+    /// </summary>
+    double median_residual;
+
+    /// <summary>
+    /// Maximum distance between points that are considered corresponding.
+    /// </summary>
+    double max_correspondence_distance;
+
+    /// <summary>
+    /// Maximum number of ICP iterations.
+    /// </summary>
+    int max_iteration;
+
+    /// <summary>
+    /// ICP stops once the fitness, the fraction of source points with a correspondence, changes by less than this value
+    /// and the inlier RMSE changes by less than `rmse_change`.
+    /// </summary>
+    double relative_fitness;
+
+    /// <summary>
+    /// ICP stops once the inlier RMSE changes by less than this distance, in the units of the point coordinates,
+    /// and the fitness changes by less than `relative_fitness`.
+    /// </summary>
+    double rmse_change;
+};
+
+/// <summary>
+/// The outcome of a registration, together with the parameters it was computed with.
+/// </summary>
+struct RegistrationOutput {
+    open3d::pipelines::registration::RegistrationResult result;
+    RegistrationParameters parameters;
+
+    /// <summary>
+    /// Set if the registration was stopped before convergence. `result` holds the last completed step.
+    /// </summary>
+    bool cancelled;
+
+    /// <summary>
+    /// Number of ICP iterations that were actually run, at most `parameters.max_iteration`.
+    /// </summary>
+    int iterations;
+};
+
+/// <summary>
+/// Estimates the median distance between neighbouring points of an entry from a sample of its points.
+/// </summary>
+/// <param name="entry">The entry. Its search index is built if necessary.</param>
+/// <returns>The median spacing, or zero if it could not be determined.</returns>
+double estimate_point_spacing(Entry& entry);
+
+/// <summary>
+/// Estimates the median distance between neighbouring points of a cloud from a sample of its points.
+/// Only reads its arguments, so it may run on another thread.
+/// </summary>
+/// <param name="cloud">The cloud.</param>
+/// <param name="index">Search index over `cloud`.</param>
+/// <returns>The median spacing, or zero if it could not be determined.</returns>
+double estimate_point_spacing(const open3d::geometry::PointCloud& cloud, const open3d::geometry::KDTreeFlann& index);
+
+/// <summary>
+/// Chooses registration parameters by sampling the point spacing of `target`
+/// and the distances between `source` and `target` in parallel.
+/// </summary>
+/// <param name="source">The entry that is to be moved.</param>
+/// <param name="target">The entry that stays in place. Its search index is built if necessary.</param>
+/// <returns>The estimated parameters.</returns>
+RegistrationParameters estimate_registration_parameters(Entry& source, Entry& target);
+
+/// <summary>
+/// Computes a transformation that aligns the transformed data of `source` to the transformed data of `target`.
+/// Normals and covariances required by `method` are estimated and cached on the entries.
+/// Parameters are chosen by `estimate_registration_parameters`. The search index of the target is built
+/// once and reused by every iteration, unless the target is cropped to the overlap.
+/// </summary>
+/// <param name="source">The entry that is to be moved.</param>
+/// <param name="target">The entry that stays in place.</param>
+/// <param name="method">The error metric to be minimized.</param>
+/// <param name="restrict_to_overlap">Only use points within the overlap of both clouds, see `estimate_overlap`.</param>
+/// <param name="update_progress">Called before every iteration with the fraction of the iteration limit used.
+/// Returning false stops the registration.</param>
+/// <returns>The registration result. Its transformation is meant to be applied on top of `source`.</returns>
+RegistrationOutput register_entries(
+    Entry& source,
+    Entry& target,
+    RegistrationMethod method,
+    bool restrict_to_overlap = true,
+    std::function<bool(double)> update_progress = nullptr
+);
+
+/// <summary>
+/// Computes the rigid transformation that best maps a set of points onto corresponding points in the least squares sense.
+/// </summary>
+/// <param name="source">The points that are to be moved.</param>
+/// <param name="target">The corresponding points. Must be as many as in `source`.</param>
+/// <returns>The transformation, or nothing if there are fewer than three pairs or all points of either set lie on a line.</returns>
+std::optional<Eigen::Matrix4d> estimate_rigid_transform(
+    const std::vector<Eigen::Vector3d>& source,
+    const std::vector<Eigen::Vector3d>& target
+);
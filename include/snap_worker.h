@@ -0,0 +1,111 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+/// <summary>
+/// The proxies a drag is aligned with.
+/// </summary>
+struct SnapClouds {
+    /// <summary>
+    /// Proxy of the cloud that is to be moved.
+    /// </summary>
+    std::shared_ptr<const open3d::geometry::PointCloud> source;
+
+    /// <summary>
+    /// Proxy of the cloud that stays in place.
+    /// </summary>
+    std::shared_ptr<const open3d::geometry::PointCloud> target;
+
+    /// <summary>
+    /// Maximum distance between points that are considered corresponding.
+    /// </summary>
+    double max_correspondence_distance;
+};
+
+/// <summary>
+/// Aligns a heavily downsampled proxy of one point cloud against another in the background.
+/// Only the most recent request is worked on; older requests are dropped.
+/// </summary>
+class SnapWorker {
+public:
+    /// <summary>
+    /// Starts the worker thread.
+    /// </summary>
+    /// <param name="on_result">Called on the worker thread with the id of a request and the resulting pose.
+    /// Only called for results of the most recent request.</param>
+    SnapWorker(std::function<void(uint64_t, const Eigen::Matrix4d&)> on_result);
+
+    /// <summary>
+    /// Stops the worker thread, discarding pending requests.
+    /// </summary>
+    ~SnapWorker();
+
+    /// <summary>
+    /// Replaces the clouds that are aligned. Pending requests are discarded.
+    /// </summary>
+    /// <param name="prepare">Creates the proxies. Called on the worker thread before the next request is worked on,
+    /// so that downsampling and estimating parameters never keep the caller waiting.</param>
+    void set_clouds(std::function<SnapClouds()> prepare);
+
+    /// <summary>
+    /// Requests alignment of the source, starting from the given pose. Replaces any pending request.
+    /// </summary>
+    /// <param name="pose">Initial transformation of the source proxy.</param>
+    /// <returns>The id of the request.</returns>
+    uint64_t request(const Eigen::Matrix4d& pose);
+
+    /// <summary>
+    /// Discards the pending request. Results of earlier requests are no longer reported.
+    /// </summary>
+    void cancel();
+
+    /// <summary>
+    /// Returns whether the given request is the most recent one.
+    /// </summary>
+    bool is_current(uint64_t id);
+
+    /// <summary>
+    /// Creates a proxy for the given cloud with roughly `SNAP_PROXY_POINTS` points.
+    /// </summary>
+    static std::shared_ptr<open3d::geometry::PointCloud> make_proxy(const open3d::geometry::PointCloud& cloud);
+
+    /// <summary>
+    /// Estimated point spacing of a proxy, given the point spacing of the original cloud.
+    /// </summary>
+    static double proxy_spacing(const open3d::geometry::PointCloud& cloud, double point_spacing);
+
+private:
+    void run();
+
+    std::function<void(uint64_t, const Eigen::Matrix4d&)> on_result;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+
+    /// <summary>
+    /// Id of the most recent request.
+    /// </summary>
+    uint64_t generation;
+    std::optional<Eigen::Matrix4d> pending;
+
+    /// <summary>
+    /// Creates the clouds for the next request, if they were replaced since the last one.
+    /// </summary>
+    std::function<SnapClouds()> prepare;
+
+    /// <summary>
+    /// Incremented whenever `prepare` is replaced, so that outdated proxies are not stored.
+    /// </summary>
+    uint64_t clouds_version;
+
+    SnapClouds clouds;
+
+    std::thread thread;
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <open3d/Open3D.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <data.h>
+
+/// <summary>
+/// The surfaces a synthetic scene can be sampled from.
+/// </summary>
+enum SyntheticShape {
+    /// <summary>
+    /// A flat square of 10 by 10 meters. Degenerate for registration along the plane.
+    /// </summary>
+    SYNTHETIC_PLANE,
+    /// <summary>
+    /// The inside of a box shaped room of 8 by 6 by 3 meters, seen from a scanner in its center.
+    /// Views cover neighbouring sectors around the scanner.
+    /// </summary>
+    SYNTHETIC_ROOM,
+    /// <summary>
+    /// Rolling terrain of 10 by 10 meters with bumps down to a few centimeters.
+    /// </summary>
+    SYNTHETIC_SURFACE
+};
+
+/// <summary>
+/// Describes a synthetic scene. Equal parameters always produce the same points.
+/// </summary>
+struct SyntheticParameters {
+    SyntheticShape shape = SYNTHETIC_SURFACE;
+
+    /// <summary>
+    /// Number of views the scene is split into.
+    /// </summary>
+    size_t view_count = 2;
+
+    /// <summary>
+    /// Number of points in every view.
+    /// </summary>
+    size_t points_per_view = 100000;
+
+    /// <summary>
+    /// Fraction of the area of a view that is also covered by the next view, between 0 and 1.
+    /// </summary>
+    double overlap = 0.5;
+
+    /// <summary>
+    /// Standard deviation of the gaussian noise added to every coordinate, in meters.
+    /// </summary>
+    double noise = 0.002;
+
+    /// <summary>
+    /// Upper bound for the rotation around every axis of the ground truth transformations, in radians.
+    /// </summary>
+    double max_rotation = 0.1;
+
+    /// <summary>
+    /// Upper bound for the translation along every axis of the ground truth transformations, in meters.
+    /// </summary>
+    double max_translation = 0.5;
+
+    uint64_t seed = 0;
+};
+
+/// <summary>
+/// Difference between an estimated and an exact transformation.
+/// </summary>
+struct TransformationError {
+    /// <summary>
+    /// Angle of the remaining rotation, in radians.
+    /// </summary>
+    double rotation;
+
+    /// <summary>
+    /// Length of the remaining translation.
+    /// </summary>
+    double translation;
+};
+
+/// <summary>
+/// Computes how far an estimated rigid transformation is off from the exact one.
+/// </summary>
+TransformationError compare_transformations(const Eigen::Matrix4d& estimate, const Eigen::Matrix4d& truth);
+
+/// <summary>
+/// Generates reproducible point clouds of a known scene, split into overlapping views with known poses.
+/// Every view is stored in its own coordinate frame; its ground truth transformation maps it into the frame of
+/// the first view. Points are generated in fixed blocks with their own random state, so the result does not
+/// depend on the number of threads.
+/// </summary>
+class SyntheticScene {
+public:
+    /// <summary>
+    /// Draws the ground truth transformations. Points are only generated on request.
+    /// </summary>
+    SyntheticScene(const SyntheticParameters& parameters);
+
+    size_t get_view_count() const;
+
+    /// <summary>
+    /// Returns the transformation that maps a view into the frame of the first view.
+    /// Registering `view` onto the first view should result in this transformation.
+    /// </summary>
+    const Eigen::Matrix4d& get_ground_truth(size_t view) const;
+
+    /// <summary>
+    /// Generates the points of a view in its own frame.
+    /// </summary>
+    open3d::geometry::PointCloud generate_cloud(size_t view) const;
+
+    /// <summary>
+    /// Generates a view as an entry named after the view.
+    /// </summary>
+    std::shared_ptr<Entry> generate_entry(size_t view) const;
+
+    /// <summary>
+    /// Writes a view as a binary PLY file with single precision coordinates.
+    /// The points are streamed in batches, so views larger than the available memory can be written.
+    /// </summary>
+    /// <param name="view">The view.</param>
+    /// <param name="path">Path of the file.</param>
+    /// <param name="update_progress">Called after every batch with the fraction of points written. Returning false stops writing.</param>
+    /// <returns>True on success. False if the file could not be written or writing was stopped.</returns>
+    bool write_ply(size_t view, const std::string& path, std::function<bool(double)> update_progress = nullptr) const;
+
+private:
+    /// <summary>
+    /// Generates the points of a single block of a view.
+    /// </summary>
+    void generate_block(size_t view, size_t block, Eigen::Vector3d* points) const;
+
+    size_t get_block_count() const;
+    size_t get_block_size(size_t block) const;
+
+    SyntheticParameters parameters;
+
+    /// <summary>
+    /// Width of the part of the scene covered by a single view, as a fraction of the whole scene.
+    /// </summary>
+    double view_width;
+
+    std::vector<Eigen::Matrix4d> ground_truth;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+/// <summary>
+/// Enables or disables recording of trace spans. Enabling starts a new trace;
+/// spans recorded before are not written anymore, and every thread clears them when it records its next span.
+/// </summary>
+void set_tracing_enabled(bool enabled);
+
+/// <summary>
+/// Returns whether trace spans are recorded. Cheap enough to be called in hot paths.
+/// </summary>
+bool is_tracing_enabled();
+
+/// <summary>
+/// Names the calling thread in written traces.
+/// </summary>
+/// <param name="name">The name. Must outlive the program, e.g. a string literal.</param>
+void set_trace_thread_name(const char* name);
+
+/// <summary>
+/// Appends a span to the buffer of the calling thread. Buffers are only written by their
+/// own thread, so recording only waits for `write_trace` with the first span of a new trace.
+/// Spans beyond a fixed number per thread and trace are dropped.
+/// </summary>
+/// <param name="name">Name of the span. Must outlive the program, e.g. a string literal.</param>
+void record_trace_span(const char* name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+
+/// <summary>
+/// Writes all spans recorded since tracing was last enabled to a file in the Chrome trace event format,
+/// which can be opened with Perfetto or chrome://tracing. Threads may keep recording while the file is written.
+/// </summary>
+/// <param name="path">The file path.</param>
+/// <returns>Whether the file was written.</returns>
+bool write_trace(const std::string& path);
+
+/// <summary>
+/// Records the time between its construction and destruction as a span, if tracing was enabled on construction.
+/// </summary>
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : name(name), running(is_tracing_enabled()) {
+        if (running) {
+            begin = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (running) {
+            record_trace_span(name, begin, std::chrono::steady_clock::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    bool running;
+    std::chrono::steady_clock::time_point begin;
+};
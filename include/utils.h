@@ -2,6 +2,27 @@
 
 #include <open3d/Open3D.h>
 
-static uint64_t id_counter = 0;
+#include <functional>
 
 Eigen::Matrix4d make_matrix(double x_rotation, double y_rotation, double z_rotation, double x_translation, double y_translation, double z_translation);
+
+/// <summary>
+/// Splits the range [0, count) into contiguous chunks and processes them on all available cores.
+/// Ranges below `min_parallel` elements are processed on the calling thread. Within a task of `for_each_parallel`,
+/// only the share of the cores given to that task is used.
+/// </summary>
+/// <param name="count">Number of elements.</param>
+/// <param name="body">Called with the half-open range [start, end) of a single chunk.</param>
+/// <param name="min_parallel">Minimum number of elements that warrants spawning threads.</param>
+void parallel_for(size_t count, const std::function<void(size_t, size_t)>& body, size_t min_parallel = 20000);
+
+/// <summary>
+/// Calls `body` for every index in [0, count), one index per thread at a time.
+/// Unlike `parallel_for`, this suits a few long tasks such as loading files. The cores are split evenly among the threads,
+/// and `parallel_for` within a task only uses the share of its thread, so that the number of threads never exceeds
+/// the number of cores while a few large tasks still use all of them. Work that parallelizes over points on its own,
+/// such as transforming whole point clouds, is better done one task after another.
+/// </summary>
+/// <param name="count">Number of tasks.</param>
+/// <param name="body">Called with the index of a single task.</param>
+void for_each_parallel(size_t count, const std::function<void(size_t)>& body);
@@ -1,92 +1,614 @@
 #include <data.h>
+#include <profiler.h>
+#include <tracing.h>
 
 
+#include <atomic>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
 #include <thread>
 
-void Entry::recalculate_transform() {
-    Eigen::Matrix4d t = get_transformation();
+/// Number of neighbours used to estimate normals and covariances.
+static const int NORMAL_NEIGHBOURS = 20;
 
-    if (base.points_.size() < 20000) {
-        for (int i = 0; i < base.points_.size(); i++) {
-            Eigen::Vector3d p(base.points_.at(i));
-            Eigen::Vector4d extended;
-            extended << p, 1;
-            Eigen::Vector4d result(t * extended);
-            transformed.points_.at(i) = result.head<3>();
+/// Thickness of the flattened covariances, relative to their extent along the surface.
+static const double COVARIANCE_EPSILON = 1e-3;
+
+/// Source of revisions, shared by all entries.
+static std::atomic<uint64_t> revision_counter(0);
+
+/// Source of ids, shared by all entries. Entries are created on background jobs as well.
+static std::atomic<uint64_t> id_counter(0);
+
+std::string allocate_entry_id() {
+    return "cloud_" + std::to_string(id_counter++);
+}
+
+/// <summary>
+/// Name of a new entry, numbered like its id but starting at one.
+/// </summary>
+static std::string default_name(const std::string& id) {
+    return "Wolke " + std::to_string(std::stoull(id.substr(id.find('_') + 1)) + 1);
+}
+
+/// <summary>
+/// Axis aligned bounds of a box with the given center, orientation and half extent.
+/// </summary>
+static open3d::geometry::AxisAlignedBoundingBox box_bounds(
+    const Eigen::Vector3d& center,
+    const Eigen::Matrix3d& r,
+    const Eigen::Vector3d& half_extent
+) {
+    Eigen::Vector3d radius = r.cwiseAbs() * half_extent;
+    return open3d::geometry::AxisAlignedBoundingBox(center - radius, center + radius);
+}
+
+void Entry::init_bounds() {
+    const auto& points = base->points_;
+
+    if (points.empty()) {
+        return;
+    }
+
+    // Sums are taken relative to the first point to limit cancellation for distant clouds.
+    const Eigen::Vector3d origin = points[0];
+    Eigen::Vector3d min_bound = origin;
+    Eigen::Vector3d max_bound = origin;
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d sum_squares = Eigen::Matrix3d::Zero();
+    std::mutex mutex;
+
+    parallel_for(points.size(), [&](size_t start, size_t end) {
+        Eigen::Vector3d local_min = points[start];
+        Eigen::Vector3d local_max = points[start];
+        Eigen::Vector3d local_sum = Eigen::Vector3d::Zero();
+        Eigen::Matrix3d local_squares = Eigen::Matrix3d::Zero();
+
+        for (size_t i = start; i < end; i++) {
+            Eigen::Vector3d d = points[i] - origin;
+            local_min = local_min.cwiseMin(points[i]);
+            local_max = local_max.cwiseMax(points[i]);
+            local_sum += d;
+            local_squares += d * d.transpose();
         }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        min_bound = min_bound.cwiseMin(local_min);
+        max_bound = max_bound.cwiseMax(local_max);
+        sum += local_sum;
+        sum_squares += local_squares;
+    });
+
+    base_bounds = open3d::geometry::AxisAlignedBoundingBox(min_bound, max_bound);
+
+    // The oriented box is aligned to the principal axes of the points.
+    double n = double(points.size());
+    Eigen::Vector3d mean = sum / n;
+    Eigen::Matrix3d covariance = sum_squares / n - mean * mean.transpose();
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+    Eigen::Matrix3d r = solver.eigenvectors();
+    if (r.determinant() < 0.0) {
+        r.col(2) = -r.col(2);
     }
-    else {
-        int core_count = std::thread::hardware_concurrency();
-        int start = 0;
-        int diff = base.points_.size() / core_count;
-
-        const Eigen::Vector3d* base_ptr = base.points_.data();
-        Eigen::Vector3d* transformed_ptr = transformed.points_.data();
-
-        std::vector<std::thread> threads;
-
-        for (int k = 0; k < core_count - 1; k++) {
-            threads.emplace_back([base_ptr, transformed_ptr, start, diff, &t]() {
-                    for (int i = start; i < start + diff; i++) {
-                        Eigen::Vector3d p(base_ptr[i]);
-                        Eigen::Vector4d extended;
-                        extended << p, 1;
-                        Eigen::Vector4d result(t * extended);
-                        transformed_ptr[i] = result.head<3>();
-                    }
-                });
-            start += diff;
+
+    Eigen::Vector3d local_min = Eigen::Vector3d::Constant(std::numeric_limits<double>::infinity());
+    Eigen::Vector3d local_max = -local_min;
+
+    parallel_for(points.size(), [&](size_t start, size_t end) {
+        Eigen::Vector3d chunk_min = local_min;
+        Eigen::Vector3d chunk_max = local_max;
+
+        for (size_t i = start; i < end; i++) {
+            Eigen::Vector3d q = r.transpose() * (points[i] - origin);
+            chunk_min = chunk_min.cwiseMin(q);
+            chunk_max = chunk_max.cwiseMax(q);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        local_min = local_min.cwiseMin(chunk_min);
+        local_max = local_max.cwiseMax(chunk_max);
+    });
+
+    Eigen::Vector3d center = origin + r * (0.5 * (local_min + local_max));
+    base_oriented_bounds = open3d::geometry::OrientedBoundingBox(center, r, local_max - local_min);
+
+    transformed_bounds = base_bounds;
+    transformed_oriented_bounds = base_oriented_bounds;
+}
+
+void Entry::init_group_bounds() {
+    bool first = true;
+
+    for (const auto& view : part_views) {
+        if (view->get_point_count() == 0) {
+            continue;
+        }
+
+        const auto& bounds = view->get_bounds();
+        if (first) {
+            base_bounds = bounds;
+            first = false;
+        }
+        else {
+            base_bounds.min_bound_ = base_bounds.min_bound_.cwiseMin(bounds.min_bound_);
+            base_bounds.max_bound_ = base_bounds.max_bound_.cwiseMax(bounds.max_bound_);
         }
+    }
+
+    // The points are not looked at, so the oriented box is the axis aligned one.
+    base_oriented_bounds = open3d::geometry::OrientedBoundingBox(
+        base_bounds.GetCenter(), Eigen::Matrix3d::Identity(), base_bounds.GetExtent());
+
+    transformed_bounds = base_bounds;
+    transformed_oriented_bounds = base_oriented_bounds;
+}
+
+void Entry::rebuild_part_views() {
+    std::vector<std::shared_ptr<Entry>> views;
+    views.reserve(parts.size());
+
+    for (size_t i = 0; i < parts.size(); i++) {
+        // Views are replaced instead of modified, since copies of the group share them.
+        std::shared_ptr<Entry> view = i < part_views.size()
+            ? std::make_shared<Entry>(*part_views[i])
+            : std::shared_ptr<Entry>(new Entry(*parts[i].entry, id + "_part_" + std::to_string(i)));
+
+        view->place(composed_transformation * parts[i].transformation);
+        views.push_back(view);
+    }
 
-        for (int i = start; i < base.points_.size(); i++) {
-            Eigen::Vector3d p(base_ptr[i]);
+    part_views = std::move(views);
+}
+
+void Entry::place(const Eigen::Matrix4d& pose) {
+    // A view is never undone, so its pose is all it needs to remember.
+    transformations.assign(1, pose);
+    composed_transformation = pose;
+    update_bounds();
+}
+
+void Entry::update_bounds() {
+    Eigen::Matrix4d t = composed_transformation;
+
+    // Rigid transformations map boxes to boxes, so the bounds follow without looking at the points.
+    Eigen::Matrix3d rotation = t.block<3, 3>(0, 0);
+    Eigen::Vector3d translation = t.block<3, 1>(0, 3);
+
+    transformed_oriented_bounds = open3d::geometry::OrientedBoundingBox(
+        rotation * base_oriented_bounds.center_ + translation,
+        rotation * base_oriented_bounds.R_,
+        base_oriented_bounds.extent_
+    );
+
+    // Both boxes contain the points, and so does their intersection.
+    auto from_box = box_bounds(rotation * base_bounds.GetCenter() + translation, rotation, 0.5 * base_bounds.GetExtent());
+    auto from_oriented = box_bounds(transformed_oriented_bounds.center_, transformed_oriented_bounds.R_, 0.5 * base_oriented_bounds.extent_);
+    transformed_bounds = open3d::geometry::AxisAlignedBoundingBox(
+        from_box.min_bound_.cwiseMax(from_oriented.min_bound_),
+        from_box.max_bound_.cwiseMin(from_oriented.max_bound_)
+    );
+}
+
+void Entry::recalculate_transform() {
+    ScopedTimer timer(TIMER_TRANSFORM);
+    TraceSpan span("recalculate_transform");
+    Eigen::Matrix4d t = composed_transformation;
+
+    update_bounds();
+    transformed_pose = t;
+
+    // Compressed entries only keep track of their pose, the points follow once they are expanded.
+    if (compressed_only) {
+        return;
+    }
+
+    // Every point is overwritten, so shared data is replaced instead of copied.
+    open3d::geometry::PointCloud& cloud = unshare_transformed();
+
+    const Eigen::Vector3d* base_ptr = base->points_.data();
+    Eigen::Vector3d* transformed_ptr = cloud.points_.data();
+
+    parallel_for(base->points_.size(), [base_ptr, transformed_ptr, &t](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
             Eigen::Vector4d extended;
-            extended << p, 1;
+            extended << base_ptr[i], 1;
             Eigen::Vector4d result(t * extended);
             transformed_ptr[i] = result.head<3>();
         }
+    });
+
+    if (!parts.empty()) {
+        rebuild_part_views();
+    }
+}
+
+SurfaceEstimate Entry::compute_surface() const {
+    SurfaceEstimate surface;
+
+    if (base->points_.empty()) {
+        return surface;
+    }
+
+    std::vector<Eigen::Matrix3d> covariances = open3d::geometry::PointCloud::EstimatePerPointCovariances(
+        *base, open3d::geometry::KDTreeSearchParamKNN(NORMAL_NEIGHBOURS));
+    std::vector<Eigen::Vector3d> normals(covariances.size());
+
+    Eigen::Matrix3d* covariances_ptr = covariances.data();
+    Eigen::Vector3d* normals_ptr = normals.data();
+
+    parallel_for(covariances.size(), [covariances_ptr, normals_ptr](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            // Eigenvalues are sorted in increasing order, so the first
+            // eigenvector points along the normal of the local surface.
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariances_ptr[i]);
+            const Eigen::Matrix3d& v = solver.eigenvectors();
+            normals_ptr[i] = v.col(0);
+            covariances_ptr[i] = v * Eigen::Vector3d(COVARIANCE_EPSILON, 1.0, 1.0).asDiagonal() * v.transpose();
+        }
+    });
+
+    surface.normals = std::make_shared<const std::vector<Eigen::Vector3d>>(std::move(normals));
+    surface.covariances = std::make_shared<const std::vector<Eigen::Matrix3d>>(std::move(covariances));
+    return surface;
+}
+
+/// <summary>
+/// Derives the covariances `compute_surface` estimates from the normals alone.
+/// With the eigenvectors orthonormal, `v * diag(epsilon, 1, 1) * v^T` equals `I - (1 - epsilon) * n * n^T`.
+/// </summary>
+static std::shared_ptr<const std::vector<Eigen::Matrix3d>> covariances_from_normals(const std::vector<Eigen::Vector3d>& normals) {
+    auto covariances = std::make_shared<std::vector<Eigen::Matrix3d>>(normals.size());
+    const Eigen::Vector3d* normals_ptr = normals.data();
+    Eigen::Matrix3d* covariances_ptr = covariances->data();
+
+    parallel_for(normals.size(), [normals_ptr, covariances_ptr](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            const Eigen::Vector3d& n = normals_ptr[i];
+            covariances_ptr[i] = Eigen::Matrix3d::Identity() - (1.0 - COVARIANCE_EPSILON) * n * n.transpose();
+        }
+    });
+
+    return covariances;
+}
+
+void Entry::set_surface(const SurfaceEstimate& surface) {
+    size_t count = compressed_only ? compressed->size() : base->points_.size();
+    if (!surface.normals || surface.normals->size() != count) {
+        return;
+    }
+
+    base_normals = surface.normals;
+    base_covariances = surface.covariances;
+}
+
+void Entry::estimate_normals() {
+    if (base_normals) {
+        return;
+    }
+
+    set_surface(compute_surface());
+}
+
+bool Entry::has_normals() const {
+    return base_normals != nullptr;
+}
+
+SurfaceEstimate Entry::get_surface() const {
+    return SurfaceEstimate{ base_normals, base_covariances };
+}
+
+const open3d::geometry::KDTreeFlann& Entry::get_index() {
+    if (!base_index) {
+        base_index = build_index();
+    }
+
+    return *base_index;
+}
+
+std::shared_ptr<const open3d::geometry::KDTreeFlann> Entry::build_index() const {
+    return std::make_shared<const open3d::geometry::KDTreeFlann>(*base);
+}
 
-        for (int i = 0; i < threads.size(); i++) {
-            threads.at(i).join();
+void Entry::set_index(std::shared_ptr<const open3d::geometry::KDTreeFlann> index) {
+    if (!compressed_only) {
+        base_index = index;
+    }
+}
+
+std::shared_ptr<const open3d::geometry::KDTreeFlann> Entry::get_cached_index() const {
+    return base_index;
+}
+
+void Entry::share_caches(const Entry& other) {
+    if (other.id != id) {
+        return;
+    }
+
+    if (!base_normals && other.base_normals) {
+        set_surface(SurfaceEstimate{ other.base_normals, other.base_covariances });
+    }
+
+    // Compressed entries rebuild their search structures once they are needed again.
+    if (!base_index && other.base_index && !compressed_only) {
+        base_index = other.base_index;
+    }
+
+    if (!base_lod && other.base_lod) {
+        base_lod = other.base_lod;
+    }
+
+    if (!compressed && other.compressed) {
+        compressed = other.compressed;
+    }
+
+    if (!base_bvh && other.base_bvh && !compressed_only) {
+        base_bvh = other.base_bvh;
+    }
+
+    if (!flattened) {
+        flattened = other.flattened;
+    }
+    else if (other.flattened && other.flattened != flattened) {
+        // Both were derived from the same merged points, but may have built different caches on them.
+        auto merged = std::make_shared<Entry>(*flattened);
+        merged->share_caches(*other.flattened);
+        flattened = merged;
+    }
+}
+
+std::shared_ptr<const LodOrder> Entry::build_lod() const {
+    return build_lod_order(*base);
+}
+
+void Entry::set_lod(std::shared_ptr<const LodOrder> lod) {
+    base_lod = lod;
+}
+
+std::shared_ptr<const LodOrder> Entry::get_lod() const {
+    return base_lod;
+}
+
+std::shared_ptr<const PointBvh> Entry::build_bvh() const {
+    return std::make_shared<const PointBvh>(base->points_);
+}
+
+void Entry::set_bvh(std::shared_ptr<const PointBvh> bvh) {
+    if (!compressed_only) {
+        base_bvh = bvh;
+    }
+}
+
+std::shared_ptr<const CompressedCloud> Entry::build_compressed() const {
+    return std::make_shared<const CompressedCloud>(*base, base_bounds, base_normals.get());
+}
+
+void Entry::set_compressed(std::shared_ptr<const CompressedCloud> compressed_) {
+    compressed = compressed_;
+}
+
+std::shared_ptr<const CompressedCloud> Entry::get_compressed() const {
+    return compressed;
+}
+
+void Entry::compress() {
+    if (is_group() || compressed_only || !compressed) {
+        return;
+    }
+
+    // Copies that are not compressed keep their own references to the data.
+    // Normals live on in the compact copy, and the covariances follow from them.
+    base = std::make_shared<const open3d::geometry::PointCloud>();
+    transformed = std::make_shared<open3d::geometry::PointCloud>();
+    base_normals.reset();
+    base_covariances.reset();
+    base_index.reset();
+    base_bvh.reset();
+    compressed_only = true;
+}
+
+void Entry::expand() {
+    if (!compressed_only) {
+        return;
+    }
+
+    base = compressed->expand();
+    compressed_only = false;
+    lossy = true;
+
+    if (compressed->has_normals()) {
+        base_normals = compressed->expand_normals();
+        base_covariances = covariances_from_normals(*base_normals);
+    }
+
+    auto cloud = std::make_shared<open3d::geometry::PointCloud>();
+    cloud->points_.resize(base->points_.size());
+    cloud->colors_ = base->colors_;
+
+    transformed = cloud;
+    recalculate_transform();
+}
+
+bool Entry::is_compressed() const {
+    return compressed_only;
+}
+
+bool Entry::is_lossy() const {
+    for (const EntryPart& part : parts) {
+        if (part.entry->is_lossy()) {
+            return true;
         }
     }
+
+    return lossy;
+}
+
+std::optional<size_t> Entry::pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double tolerance) {
+    if (is_group() || compressed_only) {
+        return std::nullopt;
+    }
+
+    if (!base_bvh) {
+        base_bvh = build_bvh();
+    }
+
+    // The hierarchy is built over the original data, so the ray is moved there instead of the points.
+    // Transformations are rigid, which keeps the direction normalized and the tolerance unchanged.
+    Eigen::Matrix4d inverse = get_transformation().inverse();
+    Eigen::Vector3d local_origin = (inverse * origin.homogeneous()).head<3>();
+    Eigen::Vector3d local_direction = inverse.block<3, 3>(0, 0) * direction;
+
+    return base_bvh->pick(base->points_, local_origin, local_direction, tolerance);
+}
+
+static size_t cloud_memory_usage(const open3d::geometry::PointCloud& cloud) {
+    return (cloud.points_.capacity() + cloud.normals_.capacity() + cloud.colors_.capacity()) * sizeof(Eigen::Vector3d)
+        + cloud.covariances_.capacity() * sizeof(Eigen::Matrix3d);
 }
 
+static size_t colors_memory_usage(const std::shared_ptr<const std::vector<Eigen::Vector3d>>& colors) {
+    return colors ? colors->capacity() * sizeof(Eigen::Vector3d) : 0;
+}
+
+size_t Entry::get_memory_usage() const {
+    size_t bytes = cloud_memory_usage(*base) + get_transformed_memory_usage();
 
-Entry::Entry(const Entry& arg):
-    id(arg.id),
+    if (base_normals) {
+        bytes += base_normals->capacity() * sizeof(Eigen::Vector3d);
+    }
+
+    if (base_covariances) {
+        bytes += base_covariances->capacity() * sizeof(Eigen::Matrix3d);
+    }
+
+    if (base_lod) {
+        bytes += base_lod->order.capacity() * sizeof(uint32_t) + base_lod->depth_ends.capacity() * sizeof(size_t);
+    }
+
+    if (base_bvh) {
+        bytes += base_bvh->get_memory_usage();
+    }
+
+    if (compressed) {
+        bytes += compressed->get_memory_usage();
+    }
+
+    if (flattened) {
+        bytes += flattened->get_memory_usage();
+    }
+
+    return bytes;
+}
+
+size_t Entry::get_transformed_memory_usage() const {
+    size_t bytes = cloud_memory_usage(*transformed) + colors_memory_usage(display_colors);
+
+    // The points of the parts themselves belong to the entries the group was created from.
+    for (size_t i = 0; i < part_views.size(); i++) {
+        const Entry& view = *part_views[i];
+        bytes += view.shares_transformed(*parts[i].entry) ? colors_memory_usage(view.display_colors) : view.get_transformed_memory_usage();
+    }
+
+    return bytes;
+}
+
+const open3d::geometry::AxisAlignedBoundingBox& Entry::get_bounds() const {
+    return transformed_bounds;
+}
+
+const open3d::geometry::OrientedBoundingBox& Entry::get_oriented_bounds() const {
+    return transformed_oriented_bounds;
+}
+
+
+Entry::Entry(const Entry& arg): Entry(arg, arg.id) {}
+
+Entry::Entry(const Entry& arg, const std::string& id):
+    id(id),
     base(arg.base),
     transformed(arg.transformed),
+    display_colors(arg.display_colors),
     transformations(arg.transformations),
+    composed_transformation(arg.composed_transformation),
+    transformed_pose(arg.transformed_pose),
     name(arg.name),
-    origins(arg.origins)
+    origins(arg.origins),
+    parts(arg.parts),
+    part_views(arg.part_views),
+    flattened(arg.flattened),
+    base_normals(arg.base_normals),
+    base_covariances(arg.base_covariances),
+    base_index(arg.base_index),
+    base_lod(arg.base_lod),
+    base_bvh(arg.base_bvh),
+    compressed(arg.compressed),
+    compressed_only(arg.compressed_only),
+    lossy(arg.lossy),
+    base_bounds(arg.base_bounds),
+    base_oriented_bounds(arg.base_oriented_bounds),
+    transformed_bounds(arg.transformed_bounds),
+    transformed_oriented_bounds(arg.transformed_oriented_bounds),
+    revision(arg.revision)
 {}
 
 
-Eigen::Matrix4d Entry::get_transformation() {
-    Eigen::Matrix4d result = Eigen::Matrix4d::Identity();
+Eigen::Matrix4d Entry::get_transformation() const {
+    return composed_transformation;
+}
 
-    for (const Eigen::Matrix4d& t : transformations) {
-        // Be careful with operator ordering: transormations that get applied
-        // first are on the right.
-        result = t * result;
+Eigen::Matrix4d Entry::get_model_transformation() const {
+    if (transformed_pose == composed_transformation) {
+        return Eigen::Matrix4d::Identity();
     }
 
-    return result;
+    return composed_transformation * transformed_pose.inverse();
+}
+
+open3d::geometry::PointCloud& Entry::unshare_transformed() {
+    if (transformed.use_count() == 1) {
+        // A copy that released the data on another thread may have read it just before.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return *transformed;
+    }
+
+    auto cloud = std::make_shared<open3d::geometry::PointCloud>();
+    cloud->points_.resize(transformed->points_.size());
+    cloud->colors_ = transformed->colors_;
+
+    transformed = cloud;
+    return *transformed;
 }
 
 
-open3d::geometry::PointCloud load(std::string path, std::function<void(double)> UpdateProgress) {
+/// <summary>
+/// Copies the points and colors of a cloud. Normals are only kept for the original data, see `Entry::get_surface`.
+/// </summary>
+static std::shared_ptr<open3d::geometry::PointCloud> drawable_copy(const open3d::geometry::PointCloud& cloud) {
+    auto result = std::make_shared<open3d::geometry::PointCloud>();
+    result->points_ = cloud.points_;
+    result->colors_ = cloud.colors_;
+    return result;
+}
+
+open3d::geometry::PointCloud load(std::string path, std::function<bool(double)> UpdateProgress) {
     bool success = false;
     auto geometry_type = open3d::io::ReadFileGeometryType(path);
 
     open3d::geometry::PointCloud cloud;
 
+    ScopedTimer timer(TIMER_LOAD);
+    TraceSpan span("load");
+    std::error_code error;
+    uintmax_t file_size = std::filesystem::file_size(path, error);
+    if (!error) {
+        timer.add_amount(file_size);
+    }
+
     try {
         open3d::io::ReadPointCloudOption opt;
         opt.update_progress = [UpdateProgress](double percent) -> bool {
-            UpdateProgress(float(percent / 100.0));
-            return true;
+            return UpdateProgress(percent / 100.0);
         };
         success = open3d::io::ReadPointCloud(path, cloud, opt);
     }
@@ -101,27 +623,45 @@ open3d::geometry::PointCloud load(std::string path, std::function<void(double)>
     return cloud;
 }
 
-Entry::Entry(const std::string path, std::function<void(double)> UpdateProgress):
-    id("cloud_" + std::to_string(id_counter++)),
-    base(load(path, UpdateProgress)),
-    transformed(base),
+Entry::Entry(const std::string path, std::function<bool(double)> UpdateProgress):
+    id(allocate_entry_id()),
+    base(std::make_shared<const open3d::geometry::PointCloud>(load(path, UpdateProgress))),
+    transformed(drawable_copy(*base)),
     transformations(),
     name() {
-    name = std::string("Wolke ") + std::to_string(id_counter);
+    name = default_name(id);
+    init_bounds();
 }
 
 Entry::Entry(const open3d::geometry::PointCloud& cloud):
-    id("cloud_" + std::to_string(id_counter++)),
-    base(cloud), transformed(cloud),
+    id(allocate_entry_id()),
+    base(std::make_shared<const open3d::geometry::PointCloud>(cloud)),
+    transformed(drawable_copy(cloud)),
     transformations(),
     origins(),
     name() {
-    name = std::string("Wolke ") + std::to_string(id_counter);
+    name = default_name(id);
+    init_bounds();
+}
+
+Entry::Entry(std::vector<EntryPart> parts_):
+    id(allocate_entry_id()),
+    base(std::make_shared<const open3d::geometry::PointCloud>()),
+    transformed(std::make_shared<open3d::geometry::PointCloud>()),
+    transformations(),
+    origins(),
+    parts(std::move(parts_)),
+    name() {
+    name = default_name(id);
+    rebuild_part_views();
+    init_group_bounds();
 }
 
 void Entry::do_transform(Eigen::Matrix4d transformation) {
     transformations.push_back(transformation);
+    composed_transformation = transformation * composed_transformation;
     recalculate_transform();
+    mark_modified();
 }
 
 std::optional<Eigen::Matrix4d> Entry::undo_transform() {
@@ -131,14 +671,283 @@ std::optional<Eigen::Matrix4d> Entry::undo_transform() {
 
     auto result = std::optional{ Eigen::Matrix4d(transformations.back()) };
     transformations.pop_back();
+
+    // Composed again instead of multiplying with the inverse, so that no rounding errors accumulate.
+    composed_transformation = Eigen::Matrix4d::Identity();
+    for (const Eigen::Matrix4d& t : transformations) {
+        // Be careful with operator ordering: transormations that get applied
+        // first are on the right.
+        composed_transformation = t * composed_transformation;
+    }
+
     recalculate_transform();
+    mark_modified();
     return result;
 }
 
-open3d::geometry::PointCloud& Entry::get_transformed() {
-    return transformed;
+const open3d::geometry::PointCloud& Entry::get_transformed() const {
+    return *transformed;
+}
+
+std::shared_ptr<const std::vector<Eigen::Vector3d>> Entry::get_display_colors() const {
+    return display_colors;
+}
+
+void Entry::set_display_colors(std::shared_ptr<const std::vector<Eigen::Vector3d>> colors) {
+    display_colors = colors;
+}
+
+bool Entry::shares_transformed(const Entry& other) const {
+    return transformed == other.transformed && part_views == other.part_views;
+}
+
+const open3d::geometry::PointCloud& Entry::get_base() const {
+    return *base;
 }
 
 std::vector<std::pair<std::string, Eigen::Matrix4d>>& Entry::get_origins() {
     return origins;
-}
\ No newline at end of file
+}
+
+const std::vector<std::pair<std::string, Eigen::Matrix4d>>& Entry::get_origins() const {
+    return origins;
+}
+
+bool Entry::is_group() const {
+    return !parts.empty();
+}
+
+const std::vector<EntryPart>& Entry::get_parts() const {
+    return parts;
+}
+
+const std::vector<std::shared_ptr<Entry>>& Entry::get_part_views() const {
+    return part_views;
+}
+
+std::shared_ptr<const Entry> Entry::get_flattened() const {
+    return flattened;
+}
+
+void Entry::set_flattened(std::shared_ptr<const Entry> flattened_) {
+    flattened = flattened_;
+}
+
+std::vector<std::shared_ptr<Entry>>& Entry::modify_part_views() {
+    for (auto& view : part_views) {
+        view = std::make_shared<Entry>(*view);
+    }
+
+    return part_views;
+}
+
+size_t Entry::get_point_count() const {
+    size_t count = compressed_only ? compressed->size() : base->points_.size();
+
+    for (const EntryPart& part : parts) {
+        count += part.entry->get_point_count();
+    }
+
+    return count;
+}
+
+uint64_t Entry::get_revision() const {
+    return revision;
+}
+
+void Entry::mark_modified() {
+    revision = ++revision_counter;
+}
+
+EntryRegistry::const_iterator::const_iterator(std::vector<std::shared_ptr<Entry>>::const_iterator position, std::vector<std::shared_ptr<Entry>>::const_iterator end)
+    : position(position), end(end) {
+    skip_empty();
+}
+
+const std::shared_ptr<Entry>& EntryRegistry::const_iterator::operator*() const {
+    return *position;
+}
+
+EntryRegistry::const_iterator& EntryRegistry::const_iterator::operator++() {
+    ++position;
+    skip_empty();
+    return *this;
+}
+
+bool EntryRegistry::const_iterator::operator!=(const const_iterator& other) const {
+    return position != other.position;
+}
+
+void EntryRegistry::const_iterator::skip_empty() {
+    while (position != end && !*position) {
+        ++position;
+    }
+}
+
+size_t EntryRegistry::size() const {
+    return count;
+}
+
+bool EntryRegistry::empty() const {
+    return count == 0;
+}
+
+const std::shared_ptr<Entry>& EntryRegistry::at(size_t index) const {
+    return slots[slot_at(index)];
+}
+
+EntryRegistry::const_iterator EntryRegistry::begin() const {
+    return const_iterator(slots.begin(), slots.end());
+}
+
+EntryRegistry::const_iterator EntryRegistry::end() const {
+    return const_iterator(slots.end(), slots.end());
+}
+
+std::vector<std::shared_ptr<Entry>> EntryRegistry::get_entries() const {
+    std::vector<std::shared_ptr<Entry>> entries;
+    entries.reserve(count);
+
+    for (const auto& entry : *this) {
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+int EntryRegistry::index_of(const std::string& id) const {
+    auto it = by_id.find(id);
+    return it != by_id.end() ? int(count_before(it->second)) : -1;
+}
+
+std::shared_ptr<Entry> EntryRegistry::find(const std::string& id) const {
+    auto it = by_id.find(id);
+    return it != by_id.end() ? slots[it->second] : nullptr;
+}
+
+bool EntryRegistry::is_name_taken(const std::string& name, const std::string& except_id) const {
+    auto it = by_name.find(name);
+    return it != by_name.end() && it->second != except_id;
+}
+
+std::string EntryRegistry::make_unique_name(const std::string& name) const {
+    if (!is_name_taken(name)) {
+        return name;
+    }
+
+    for (size_t number = 2;; number++) {
+        std::string candidate = name + " (" + std::to_string(number) + ")";
+        if (!is_name_taken(candidate)) {
+            return candidate;
+        }
+    }
+}
+
+void EntryRegistry::push_back(std::shared_ptr<Entry> entry) {
+    entry->name = make_unique_name(entry->name);
+    by_name[entry->name] = entry->id;
+    append_slot(entry);
+}
+
+void EntryRegistry::replace(size_t index, std::shared_ptr<Entry> entry) {
+    size_t slot = slot_at(index);
+    std::shared_ptr<Entry>& previous = slots[slot];
+    by_id.erase(previous->id);
+    by_name.erase(previous->name);
+
+    by_id[entry->id] = slot;
+    by_name[entry->name] = entry->id;
+    previous = entry;
+}
+
+void EntryRegistry::erase(size_t index) {
+    size_t slot = slot_at(index);
+    by_id.erase(slots[slot]->id);
+    by_name.erase(slots[slot]->name);
+
+    slots[slot] = nullptr;
+    add_occupied(slot, -1);
+    count--;
+
+    // packing touches every entry, so it only happens after as many removals as there are entries left
+    if (slots.size() - count > count) {
+        pack();
+    }
+}
+
+void EntryRegistry::assign(const std::vector<std::shared_ptr<Entry>>& entries) {
+    clear();
+
+    for (const auto& entry : entries) {
+        by_name[entry->name] = entry->id;
+        append_slot(entry);
+    }
+}
+
+void EntryRegistry::clear() {
+    slots.clear();
+    occupied.assign(1, 0);
+    count = 0;
+    by_id.clear();
+    by_name.clear();
+}
+
+size_t EntryRegistry::slot_at(size_t index) const {
+    if (index >= count) {
+        throw std::out_of_range("EntryRegistry: position " + std::to_string(index) + " out of range");
+    }
+
+    size_t step = 1;
+    while (step * 2 <= slots.size()) {
+        step *= 2;
+    }
+
+    // descends the Fenwick tree to the last slot before which at most `index` slots are occupied
+    size_t slot = 0;
+    size_t remaining = index + 1;
+    for (; step > 0; step /= 2) {
+        if (slot + step <= slots.size() && occupied[slot + step] < remaining) {
+            slot += step;
+            remaining -= occupied[slot];
+        }
+    }
+    return slot;
+}
+
+size_t EntryRegistry::count_before(size_t slot) const {
+    size_t result = 0;
+    for (size_t i = slot; i > 0; i -= i & (~i + 1)) {
+        result += occupied[i];
+    }
+    return result;
+}
+
+void EntryRegistry::add_occupied(size_t slot, int64_t value) {
+    for (size_t i = slot + 1; i < occupied.size(); i += i & (~i + 1)) {
+        occupied[i] = size_t(int64_t(occupied[i]) + value);
+    }
+}
+
+void EntryRegistry::append_slot(std::shared_ptr<Entry> entry) {
+    if (occupied.empty()) {
+        occupied.push_back(0);
+    }
+
+    // the new element covers itself and the slots from i - (i & -i) + 1 to i - 1, counting from 1
+    size_t i = slots.size() + 1;
+    occupied.push_back(1 + count_before(i - 1) - count_before(i - (i & (~i + 1))));
+
+    by_id[entry->id] = slots.size();
+    slots.push_back(entry);
+    count++;
+}
+
+void EntryRegistry::pack() {
+    std::vector<std::shared_ptr<Entry>> entries = get_entries();
+    slots.clear();
+    occupied.assign(1, 0);
+    count = 0;
+
+    for (const auto& entry : entries) {
+        append_slot(entry);
+    }
+}
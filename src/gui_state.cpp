@@ -1,8 +1,47 @@
 #include <data.h>
 #include <main_window.h>
 #include <gui_state.h>
+#include <registration.h>
+#include <metrics.h>
+#include <operations.h>
 
+#include <filesystem>
 #include <fstream>
+#include <unordered_set>
+
+/// Registration quality is estimated from at most this many points,
+/// unless every point has to be colored.
+static const size_t METRICS_SAMPLES = 250000;
+
+/// Points further away from the reference than this multiple of its point spacing are outliers.
+static const double INLIER_SPACING_FACTOR = 3.0;
+
+/// The job panel is refreshed at most this often.
+static const std::chrono::milliseconds JOB_PANEL_INTERVAL(100);
+
+/// Number of points drawn in total while the point budget is enabled.
+static const size_t POINT_BUDGET = 5000000;
+
+/// Point clouds are refined once the camera rested for this long.
+static const std::chrono::milliseconds CAMERA_REST_TIME(250);
+
+/// The performance overlay is refreshed at most this often.
+static const std::chrono::milliseconds PERFORMANCE_INTERVAL(500);
+
+/// Snapshots kept for undoing may hold at most this many bytes in addition to the loaded point clouds.
+static const size_t HISTORY_MEMORY_LIMIT = size_t(2) << 30;
+
+/// Points up to this many pixels away from the mouse cursor can be picked.
+static const double PICK_RADIUS = 5.0;
+
+/// Picked points are drawn this many times larger than other points.
+static const float PICK_MARKER_SCALE = 4.0f;
+
+/// Name of the geometry holding the picked points.
+static const char* PICKS_GEOMETRY = "picked_points";
+
+/// Shown when points restored from a compact copy are exported or registered.
+static const char* LOSSY_NOTE = "Die Punktewolke war komprimiert. Ihre Punkte weichen daher geringf\xC3\xBCgig von den geladenen ab."; // geringfügig
 
 std::shared_ptr<gui::VGrid> CreateHelpDisplay(gui::Window* window) {
     auto& theme = window->GetTheme();
@@ -67,11 +106,38 @@ std::shared_ptr<gui::VGrid> CreateCameraDisplay(gui::Window* window) {
     return layout;
 }
 
+std::shared_ptr<gui::Vert> CreatePerformanceDisplay(gui::Window* window, std::shared_ptr<gui::Label> text) {
+    auto& theme = window->GetTheme();
+
+    gui::Margins margins(theme.font_size);
+    auto layout = std::make_shared<gui::Vert>(0, margins);
+    layout->SetBackgroundColor(gui::Color(0, 0, 0, 0.5));
+
+    text->SetTextColor(gui::Color(1, 1, 1));
+    layout->AddChild(text);
+
+    return layout;
+}
+
+/// Formats the most recent and the average duration of an operation.
+static std::string format_timer(const char* name, TimerId id) {
+    TimerStats stats = get_timer_stats(id);
+
+    if (stats.count == 0) {
+        return fmt::format("{}: -\n", name);
+    }
+
+    double last = std::chrono::duration<double, std::milli>(stats.last).count();
+    double average = std::chrono::duration<double, std::milli>(stats.total).count() / double(stats.count);
+    return fmt::format("{}: {:.2f} ms (\xC3\x98 {:.2f} ms, {}x)\n", name, last, average, stats.count); // Ø
+}
+
 void GuiState::init_menu() {
     auto menu = std::make_shared<gui::Menu>();
     auto file_menu = std::make_shared<gui::Menu>();
     file_menu->AddItem("\xC3\x96""ffnen...", FILE_OPEN, gui::KEY_O); // Öffnen
     file_menu->AddItem("Bild exportieren...", FILE_EXPORT_RGB);
+    file_menu->AddItem("Punktewolke exportieren...", FILE_EXPORT_CLOUD);
     file_menu->AddSeparator();
 #if defined(WIN32)
     file_menu->AddItem("Beenden", FILE_QUIT);
@@ -80,11 +146,27 @@ void GuiState::init_menu() {
 
     auto edit_menu = std::make_shared<gui::Menu>();
     edit_menu->AddItem("R\xC3\xBC""ckg\xC3\xA4ngig", UNDO_TRANSFORMATION); // Rückgängig
+    edit_menu->AddItem("Wiederholen", REDO_TRANSFORMATION);
+    edit_menu->AddSeparator();
+    edit_menu->AddItem("Gruppe zusammenfassen", FLATTEN_GROUP);
     menu->AddMenu("Bearbeiten", edit_menu);
 
+    auto view_menu = std::make_shared<gui::Menu>();
+    view_menu->AddItem("Punktbudget", VIEW_POINT_BUDGET);
+    view_menu->SetChecked(VIEW_POINT_BUDGET, true);
+    view_menu->AddItem("Differenz zur Referenz", VIEW_DIFFERENCE);
+    view_menu->SetChecked(VIEW_DIFFERENCE, false);
+    view_menu->AddItem("Inaktive Wolken komprimieren", VIEW_COMPRESSION);
+    view_menu->SetChecked(VIEW_COMPRESSION, false);
+    menu->AddMenu("Ansicht", view_menu);
+
     auto help_menu = std::make_shared<gui::Menu>();
     help_menu->AddItem("Bedienung anzeigen", HELP_KEYS);
     help_menu->AddItem("Kamerainfo anzeigen", HELP_CAMERA);
+    help_menu->AddItem("Leistung anzeigen", HELP_PERFORMANCE);
+    help_menu->AddItem("Ablauf aufzeichnen", HELP_TRACE_RECORD);
+    help_menu->SetChecked(HELP_TRACE_RECORD, is_tracing_enabled());
+    help_menu->AddItem("Ablauf speichern...", HELP_TRACE_SAVE);
     help_menu->AddSeparator();
     help_menu->AddItem("\xC3\x9C""ber", HELP_ABOUT); // Über
     help_menu->AddItem("Anleitung", HELP_INSTRUCTION_MANUAL);
@@ -94,7 +176,7 @@ void GuiState::init_menu() {
 }
 
 void GuiState::init_scene() {
-    scene_wgt = std::make_shared<gui::SceneWidget>();
+    scene_wgt = std::make_shared<PickingSceneWidget>();
     scene_wgt->SetScene(
         std::make_shared<rendering::Open3DScene>(window_ptr->GetRenderer()));
     scene_wgt->EnableSceneCaching(true);
@@ -105,6 +187,7 @@ void GuiState::init_scene() {
         });
     auto* render_scene = scene_wgt->GetScene()->GetScene();
     render_scene->SetSunLightDirection(scene_wgt->GetScene()->GetCamera()->GetForwardVector());
+    scene_wgt->SetOnClicked([this](int x, int y) { this->pick_point(x, y); });
 }
 
 void GuiState::init_manipulator() {
@@ -124,20 +207,26 @@ void GuiState::init_manipulator() {
         switch (event_.type) {
         case INDEX_CHANGED: {
             int index = event_.entry_index;
+            this->stop_preview();
             /// Making a distinct copy keeps the original cloud intact, allowing
             /// free manipulation.
             this->current_entry = std::make_shared<Entry>(*this->loaded_entries.at(index));
             this->colorize_current_entry();
             this->entry_index = index;
             this->manipulator->SetName(this->current_entry->name.c_str());
+            this->update_selection();
+            this->update_metrics();
             break;
         }
         case REMOVE_CLICKED: {
+            this->stop_preview();
             int index = this->entry_index;
+            HistoryState before = this->capture_state();
 
-            const char* name = this->loaded_entries.at(index)->name.c_str();
-            this->manipulator->entries->RemoveItem(name);
-            this->loaded_entries.erase(this->loaded_entries.begin() + index);
+            std::string name = this->loaded_entries.at(index)->name;
+            this->journal->record_remove(*this->loaded_entries.at(index));
+            this->manipulator->entries->RemoveItem(index);
+            this->loaded_entries.erase(index);
 
             index -= 1;
             if (index < 0 && this->loaded_entries.size() > 0) {
@@ -154,12 +243,16 @@ void GuiState::init_manipulator() {
                 this->manipulator->SetName(this->current_entry->name.c_str());
             }
             else {
-                this->loaded_entries = {};
+                this->loaded_entries.clear();
                 this->current_entry = std::make_shared<Entry>("empty");
                 this->entry_index = -1;
             }
 
             this->manipulator->ResetSliders();
+            this->update_reference_list();
+            this->update_selection();
+            this->update_metrics();
+            this->commit("Entfernen: " + name, before);
             break;
         }
         case ICP_CLICKED: {
@@ -176,26 +269,25 @@ void GuiState::init_manipulator() {
             }
             entries->SetSelectedIndex(0);
 
+            // Order matches the RegistrationMethod enum.
+            auto methods = std::make_shared<gui::Combobox>();
+            methods->AddItem("Punkt-zu-Punkt");
+            methods->AddItem("Punkt-zu-Ebene");
+            methods->AddItem("Generalisiertes ICP");
+            methods->SetSelectedIndex(0);
+
+            auto overlap_only = std::make_shared<gui::Checkbox>("Nur \xC3\xBC""berlappenden Bereich verwenden"); // überlappenden
+            overlap_only->SetChecked(true);
+
             auto ok = std::make_shared<gui::Button>("OK");
-            ok->SetOnClicked([this, entries]() {
+            ok->SetOnClicked([this, entries, methods, overlap_only]() {
                 int i = entries->GetSelectedIndex();
                 if (i >= this->entry_index) {
                     i += 1;
                 }
 
-                auto result = open3d::pipelines::registration::RegistrationICP(
-                    this->current_entry->get_transformed(),
-                    this->loaded_entries.at(i)->get_transformed(),
-                    250.0
-                );
-                Eigen::Matrix4d matrix = result.transformation_;
-
-                this->loaded_entries.at(entry_index)->do_transform(matrix);
-                this->current_entry = std::make_shared<Entry>(*this->loaded_entries.at(this->entry_index));
-                this->colorize_current_entry();
-
                 this->window_ptr->CloseDialog();
-                this->set_scene(true, true);
+                this->register_current_entry(i, RegistrationMethod(methods->GetSelectedIndex()), overlap_only->IsChecked());
                 });
 
             auto cancel = std::make_shared<gui::Button>("Abbrechen");
@@ -204,6 +296,10 @@ void GuiState::init_manipulator() {
             auto layout = std::make_shared<gui::Vert>(0, gui::Margins(this->window_ptr->GetTheme().font_size));
             layout->AddChild(gui::Horiz::MakeCentered(entries));
             layout->AddFixed(this->window_ptr->GetTheme().font_size);
+            layout->AddChild(gui::Horiz::MakeCentered(methods));
+            layout->AddFixed(this->window_ptr->GetTheme().font_size);
+            layout->AddChild(overlap_only);
+            layout->AddFixed(this->window_ptr->GetTheme().font_size);
 
             auto buttons = std::make_shared<gui::Horiz>(0, this->window_ptr->GetTheme().font_size);
             buttons->AddChild(ok);
@@ -239,57 +335,8 @@ void GuiState::init_manipulator() {
                     i += 1;
                 }
 
-                auto& e_1 = this->loaded_entries.at(entry_index);
-                auto& e_2 = this->loaded_entries.at(i);
-
-                // Do not use current_entry, since it is recolored.
-                auto& cloud_1 = e_1->get_transformed();
-                auto& cloud_2 = e_2->get_transformed();
-
-                open3d::geometry::PointCloud cloud = open3d::geometry::PointCloud(cloud_1);
-                cloud += cloud_2;
-
-                std::shared_ptr<Entry> entry = std::make_shared<Entry>(cloud);
-
-                auto& origins = entry->get_origins();
-
-                auto& o_1 = e_1->get_origins();
-                auto& o_2 = e_2->get_origins();
-
-                if (o_1.size() == 0) {
-                    origins.push_back(std::make_pair(
-                        std::string(e_1->name),
-                        e_1->get_transformation()
-                    ));
-                }
-                else {
-                    for (auto& pair : o_1) {
-                        origins.push_back(std::make_pair(
-                            std::string(pair.first),
-                            e_1->get_transformation() * pair.second
-                        ));
-                    }
-                }
-
-                if (o_2.size() == 0) {
-                    origins.push_back(std::make_pair(
-                        std::string(e_2->name),
-                        e_2->get_transformation()
-                    ));
-                }
-                else {
-                    for (auto& pair : o_2) {
-                        origins.push_back(std::make_pair(
-                            std::string(pair.first),
-                            e_2->get_transformation() * pair.second
-                        ));
-                    }
-                }
-
-                this->loaded_entries.push_back(entry);
-                this->manipulator->entries->AddItem(entry->name.c_str());
                 this->window_ptr->CloseDialog();
-                this->set_scene(false, true);
+                this->merge_current_entry(i);
                 });
 
             auto cancel = std::make_shared<gui::Button>("Abbrechen");
@@ -364,9 +411,7 @@ void GuiState::init_manipulator() {
 
                 m(3, 3) = 1.0;
 
-                this->loaded_entries.at(entry_index)->do_transform(m);
-                this->current_entry = std::make_shared<Entry>(*this->loaded_entries.at(this->entry_index));
-                this->colorize_current_entry();
+                this->transform_selection(m, "Matrix: " + this->current_entry->name);
                 this->set_scene(true, true);
 
                 this->window_ptr->CloseDialog();
@@ -443,6 +488,12 @@ void GuiState::init_manipulator() {
             layout->AddChild(gui::Horiz::MakeCentered(text_box));
             layout->AddFixed(this->window_ptr->GetTheme().font_size);
 
+            if (!this->metrics_text.empty()) {
+                auto metrics_box = std::make_shared<gui::Label>(this->metrics_text.c_str());
+                layout->AddChild(gui::Horiz::MakeCentered(metrics_box));
+                layout->AddFixed(this->window_ptr->GetTheme().font_size);
+            }
+
             auto buttons = std::make_shared<gui::Horiz>();
             buttons->AddChild(ok);
             buttons->AddFixed(this->window_ptr->GetTheme().font_size);
@@ -458,21 +509,26 @@ void GuiState::init_manipulator() {
             break;
         }
         case SLIDER_VALUE_CHANGED: {
-            Eigen::Matrix4d t = make_matrix(event_.x_rotation, event_.y_rotation, event_.z_rotation, event_.x_translation, event_.y_translation, event_.z_translation);
-            this->current_entry = std::make_shared<Entry>(*this->loaded_entries.at(this->entry_index));
-            this->current_entry->do_transform(t);
-            this->colorize_current_entry();
-            only_update_selected = true;
-            break;
+            // Sliders may change far more often than the preview can be computed.
+            // Only the most recent values are previewed on the next tick.
+            this->pending_slider_event = event_;
+            return;
         }
         case SLIDER_MOUSE_RELEASE: {
             if (this->loaded_entries.size() == 0) {
                 break;
             }
             Eigen::Matrix4d t = make_matrix(event_.x_rotation, event_.y_rotation, event_.z_rotation, event_.x_translation, event_.y_translation, event_.z_translation);
-            this->loaded_entries.at(entry_index)->do_transform(t);
-            this->current_entry = std::make_shared<Entry>(*this->loaded_entries.at(this->entry_index));
-            this->colorize_current_entry();
+            if (this->snap_dragging) {
+                // The snapped pose stays previewed, and the sliders keep their values, until its refinement is committed.
+                this->pending_slider_event.reset();
+                this->finish_snapping(t);
+                return;
+            }
+
+            // The release commits the final slider values, a pending preview is obsolete.
+            this->stop_preview();
+            this->transform_selection(t, "Verschieben: " + this->current_entry->name);
             this->manipulator->ResetSliders();
             only_update_selected = true;
             break;
@@ -484,16 +540,79 @@ void GuiState::init_manipulator() {
 
             auto name = std::string(event_.name);
 
-            for (int i = 0; i < this->loaded_entries.size(); i++) {
-                if (i != this->entry_index && this->loaded_entries.at(i)->name == name) {
-                    this->window_ptr->ShowMessageBox("Umbenennung fehlgeschlagen", "Es existiert bereits eine Punktewolke mit diesem Namen");
-                    return;
-                }
+            if (this->loaded_entries.is_name_taken(name, this->loaded_entries.at(this->entry_index)->id)) {
+                this->window_ptr->ShowMessageBox("Umbenennung fehlgeschlagen", "Es existiert bereits eine Punktewolke mit diesem Namen");
+                return;
             }
 
+            // The copy shares the point data, so renaming does not copy any points.
+            HistoryState before = this->capture_state();
+            std::string old_name = this->loaded_entries.at(this->entry_index)->name;
+            auto renamed = std::make_shared<Entry>(*this->loaded_entries.at(this->entry_index));
+            renamed->name = name;
+            this->replace_entry(this->entry_index, renamed);
+            this->journal->record_rename(*renamed);
+
             this->current_entry->name = name;
-            this->loaded_entries.at(this->entry_index)->name = event_.name;
             this->manipulator->SetName(event_.name.c_str());
+            this->update_entry_list();
+            this->update_reference_list();
+            this->commit("Umbenennen: " + old_name + " \xE2\x86\x92 " + name, before); // →
+            return;
+        }
+        case REFERENCE_CHANGED: {
+            // The first item stands for "no reference".
+            int index = event_.reference_index - 1;
+            if (index >= 0 && index < this->loaded_entries.size()) {
+                this->reference_entry = this->loaded_entries.at(index);
+            }
+            else {
+                this->reference_entry.reset();
+            }
+
+            this->update_compression();
+            this->update_metrics();
+            only_update_selected = true;
+            break;
+        }
+        case SNAP_TOGGLED: {
+            this->snap_enabled = event_.snap;
+            if (!this->snap_enabled && this->snap_dragging) {
+                this->snap_worker->cancel();
+                this->snap_dragging = false;
+            }
+
+            bool has_group = this->current_entry->is_group() || (this->reference_entry && this->reference_entry->is_group());
+            if (this->snap_enabled && has_group) {
+                this->window_ptr->ShowMessageBox("", "Gruppen rasten beim Verschieben nicht ein. "
+                    "Sie lassen sich unter \"Bearbeiten > Gruppe zusammenfassen\" zu einer Punktewolke zusammenfassen.");
+            }
+            return;
+        }
+        case RESIDUALS_TOGGLED: {
+            this->show_residuals = event_.show_residuals;
+            this->update_metrics();
+            this->colorize_current_entry();
+            only_update_selected = true;
+            break;
+        }
+        case PICKING_TOGGLED: {
+            this->picking_enabled = event_.picking;
+            return;
+        }
+        case ALIGN_PAIRS_CLICKED: {
+            this->align_picks();
+            only_update_selected = true;
+            break;
+        }
+        case CLEAR_PAIRS_CLICKED: {
+            this->source_picks.clear();
+            this->target_picks.clear();
+            only_update_selected = true;
+            break;
+        }
+        case SELECTION_CLICKED: {
+            this->show_selection_dialog();
             return;
         }
         }
@@ -503,14 +622,38 @@ void GuiState::init_manipulator() {
 }
 
 GuiState::GuiState(MainWindow* window) : window_ptr(window) {
-    loaded_entries = {};
     current_entry = std::make_shared<Entry>("empty");
     entry_index = -1;
+    show_residuals = false;
+    residual_max_distance = 0.0;
+    snap_enabled = false;
+    snap_dragging = false;
+    snap_refinement = 0;
+    difference_enabled = false;
+    picking_enabled = false;
+    job_panel_count = 0;
+    point_budget_enabled = true;
+    compression_enabled = false;
+    last_camera_position = Eigen::Vector3f::Zero();
+    last_camera_forward = Eigen::Vector3f::Zero();
+    last_field_of_view = 0.0;
+    history = std::make_unique<CommandHistory>(HISTORY_MEMORY_LIMIT);
+    journal = std::make_unique<Journal>(claim_journal(std::filesystem::temp_directory_path().string()));
+    jobs = std::make_unique<JobScheduler>();
+
+    preview_pipeline = std::make_unique<PreviewPipeline>();
+
+    snap_worker = std::make_unique<SnapWorker>([this](uint64_t id, const Eigen::Matrix4d& pose) {
+        gui::Application::GetInstance().PostToMainThread(this->window_ptr, [this, id, pose]() {
+            this->on_snap_result(id, pose);
+        });
+    });
 
     if (!gui::Application::GetInstance().GetMenubar()) {
         init_menu();
         gui::Application::GetInstance().SetMenubar(app_menu);
     }
+    update_history_menu();
     init_scene();
     window_ptr->AddChild(scene_wgt);
 
@@ -537,6 +680,19 @@ GuiState::GuiState(MainWindow* window) : window_ptr(window) {
     help_camera = CreateCameraDisplay(window_ptr);
     help_camera->SetVisible(false);
     window_ptr->AddChild(help_camera);
+    performance_text = std::make_shared<gui::Label>("");
+    help_performance = CreatePerformanceDisplay(window_ptr, performance_text);
+    help_performance->SetVisible(false);
+    window_ptr->AddChild(help_performance);
+
+    const int em = window_ptr->GetTheme().font_size;
+    job_panel = std::make_shared<JobPanel>(int(std::ceil(0.25 * em)), gui::Margins(em / 2));
+    window_ptr->AddChild(job_panel);
+
+    if (journal->get_recovered_size() > 0) {
+        // The window has to be shown before it can show a dialog.
+        gui::Application::GetInstance().PostToMainThread(window_ptr, [this]() { this->offer_recovery(); });
+    }
 }
 
 void GuiState::init_materials() {
@@ -570,94 +726,1675 @@ void GuiState::init_lighting(const GuiSettingsModel::LightingProfile& lighting)
     render_scene->EnableSunLight(lighting.sun_enabled);
 }
 
-void GuiState::add_entry(const std::string& path, std::function<void(double)> update_progress, gui::Window* window) {
-    std::shared_ptr<Entry> entry = NULL;
+void GuiState::load_entry(const std::string& path) {
+    std::string name = std::string("L\xC3\xA4""dt ") + path; // Lädt
+
+    this->jobs->submit(name, PRIORITY_HIGH, [this, path](Job& job) {
+        std::shared_ptr<Entry> entry = NULL;
+
+        try {
+            entry = std::make_shared<Entry>(path, [&job](double progress) { return job.set_progress(progress); });
+        }
+        catch (...) {
+            entry.reset();
+        }
+
+        if (job.is_cancelled()) {
+            return;
+        }
+
+        this->jobs->post([this, entry, path]() {
+            if (entry) {
+                this->add_entry(entry);
+                this->journal->record_load(*entry, path);
+            }
+            else {
+                auto msg = std::string("Konnte '") + path + "' nicht laden.";
+                this->window_ptr->ShowMessageBox("Error", msg.c_str());
+            }
+        });
+    });
+}
+
+void GuiState::add_entry(std::shared_ptr<Entry> entry) {
+    HistoryState before = this->capture_state();
+
+    // Renames the entry if another point cloud has the same name.
+    this->loaded_entries.push_back(entry);
+    this->manipulator->entries->AddItem(entry->name.c_str());
+
+    this->current_entry = std::make_shared<Entry>(*entry);
+    this->colorize_current_entry();
+    this->entry_index = this->loaded_entries.size() - 1;
+    this->manipulator->entries->SetSelectedIndex(this->entry_index);
+    this->manipulator->SetName(this->current_entry->name.c_str());
+    this->update_reference_list();
+    this->update_selection();
+    this->update_metrics();
+    this->commit("Laden: " + entry->name, before);
+
+    this->set_scene(false, false);
+    this->preprocess_entry(entry);
+}
+
+HistoryState GuiState::capture_state() const {
+    HistoryState state;
+    state.entries = this->loaded_entries.get_entries();
+    state.entry_index = this->entry_index;
+    return state;
+}
+
+void GuiState::commit(const std::string& description, HistoryState before) {
+    this->history->push(description, std::move(before), this->capture_state());
+    this->update_history_menu();
+}
 
-    try {
-        entry = std::make_shared<Entry>(path, update_progress);
+void GuiState::restore_state(const HistoryState& state) {
+    this->stop_preview();
+    if (this->snap_dragging) {
+        this->snap_worker->cancel();
+        this->snap_dragging = false;
     }
-    catch (...) {
-        entry.reset();
+
+    // Caches computed since the snapshot was taken are kept, they only depend on the original data.
+    for (auto& entry : state.entries) {
+        auto live = this->loaded_entries.find(entry->id);
+        if (live && live != entry) {
+            entry->share_caches(*live);
+        }
     }
 
-    if (entry) {
-        gui::Application::GetInstance().PostToMainThread(
-            window, [this, window, entry, path]() {
-                while (std::any_of(this->loaded_entries.begin(), this->loaded_entries.end(),
-                    [&entry](std::shared_ptr<Entry>& e) { return e->name == entry->name; })) {
-                    entry->name.push_back('0');
-                }
+    this->loaded_entries.assign(state.entries);
+    this->entry_index = state.entry_index;
+    this->journal->record_state(state.entries);
 
-                this->loaded_entries.push_back(entry);
-                this->manipulator->entries->AddItem(entry->name.c_str());
+    // The reference follows its point cloud into the snapshot, if it is part of it.
+    if (this->reference_entry) {
+        this->reference_entry = this->loaded_entries.find(this->reference_entry->id);
+    }
 
-                this->current_entry = std::make_shared<Entry>(*entry);
+    this->update_entry_list();
+
+    if (this->entry_index >= 0) {
+        this->current_entry = std::make_shared<Entry>(*this->loaded_entries.at(this->entry_index));
+        this->colorize_current_entry();
+        this->manipulator->SetName(this->current_entry->name.c_str());
+    }
+    else {
+        this->current_entry = std::make_shared<Entry>("empty");
+    }
+
+    this->manipulator->ResetSliders();
+    this->update_reference_list();
+    this->update_selection();
+    this->update_metrics();
+    this->update_history_menu();
+    this->set_scene(false, true);
+}
+
+void GuiState::offer_recovery() {
+    auto text = std::make_shared<gui::Label>(
+        "Die letzte Sitzung wurde nicht ordnungsgem\xC3\xA4\xC3\x9F beendet.\n" // ordnungsgemäß
+        "Sollen ihre Punktewolken wiederhergestellt werden?");
+
+    auto ok = std::make_shared<gui::Button>("Wiederherstellen");
+    ok->SetOnClicked([this]() {
+        this->window_ptr->CloseDialog();
+        this->recover_session();
+    });
+
+    auto cancel = std::make_shared<gui::Button>("Verwerfen");
+    cancel->SetOnClicked([this]() {
+        this->window_ptr->CloseDialog();
+        this->journal->discard_recovered();
+    });
+
+    const int em = this->window_ptr->GetTheme().font_size;
+    auto layout = std::make_shared<gui::Vert>(0, gui::Margins(em));
+    layout->AddChild(text);
+    layout->AddFixed(em);
+
+    auto buttons = std::make_shared<gui::Horiz>(0, em);
+    buttons->AddChild(ok);
+    buttons->AddFixed(em);
+    buttons->AddChild(cancel);
+    layout->AddChild(buttons);
+
+    auto dialog = std::make_shared<gui::Dialog>("Wiederherstellen");
+    dialog->AddChild(layout);
+    this->window_ptr->ShowDialog(dialog);
+}
+
+void GuiState::recover_session() {
+    std::string path = this->journal->get_path();
+    uint64_t size = this->journal->get_recovered_size();
+
+    // Only the records of earlier sessions are read, the current session appends behind them.
+    this->jobs->submit("Wiederherstellen", PRIORITY_HIGH, [this, path, size](Job& job) {
+        auto replay = replay_journal(path, size, [&job](double progress) { return job.set_progress(progress); });
+
+        if (!replay) {
+            if (!job.is_cancelled()) {
+                this->jobs->post([this]() {
+                    this->window_ptr->ShowMessageBox("Fehler", "Die letzte Sitzung konnte nicht wiederhergestellt werden.");
+                });
+            }
+            return;
+        }
+
+        this->jobs->post([this, replay]() {
+            HistoryState before = this->capture_state();
+
+            for (const RecoveredEntry& recovered : replay->entries) {
+                this->loaded_entries.push_back(recovered.entry);
+                this->journal->record_alias(*recovered.entry, recovered.session, recovered.id);
+            }
+
+            if (this->entry_index < 0 && !this->loaded_entries.empty()) {
+                this->entry_index = 0;
+                this->current_entry = std::make_shared<Entry>(*this->loaded_entries.at(0));
                 this->colorize_current_entry();
-                this->entry_index = this->loaded_entries.size() - 1;
-                this->manipulator->entries->SetSelectedIndex(this->entry_index);
                 this->manipulator->SetName(this->current_entry->name.c_str());
+            }
 
-                this->set_scene(false, false);
-                window->CloseDialog();
-            });
+            this->update_entry_list();
+            this->update_reference_list();
+            this->update_selection();
+            this->update_metrics();
+            this->commit("Wiederherstellen", before);
+            this->set_scene(false, false);
+
+            for (const RecoveredEntry& recovered : replay->entries) {
+                if (!recovered.entry->is_group()) {
+                    this->preprocess_entry(recovered.entry);
+                }
+            }
+
+            if (!replay->missing.empty()) {
+                std::string msg = "Folgende Punktewolken konnten nicht wiederhergestellt werden, da ihre Dateien fehlen:";
+                for (const auto& name : replay->missing) {
+                    msg += "\n" + name;
+                }
+                this->window_ptr->ShowMessageBox("Wiederherstellen", msg.c_str());
+            }
+
+            open3d::utility::LogInfo("Recovered {} point clouds from {} journal records.", replay->entries.size(), replay->record_count);
+        });
+    });
+}
+
+void GuiState::undo() {
+    if (auto state = this->history->undo()) {
+        this->restore_state(*state);
     }
-    else {
-        gui::Application::GetInstance().PostToMainThread(window, [this, window, path]() {
-                window->CloseDialog();
-                auto msg = std::string("Konnte '") + path + "' nicht laden.";
-                window->ShowMessageBox("Error", msg.c_str());
-            });
+}
+
+void GuiState::redo() {
+    if (auto state = this->history->redo()) {
+        this->restore_state(*state);
     }
 }
 
-void GuiState::set_scene(bool only_update_selected, bool keep_camera) {
-    auto scene3d = scene_wgt->GetScene();
+void GuiState::update_history_menu() {
+    auto menubar = gui::Application::GetInstance().GetMenubar();
+    if (!menubar) {
+        return;
+    }
 
-    // Only update point cloud that got changed
-    if (only_update_selected && entry_index >= 0) {
-        scene3d->ShowAxes(true);
-        scene3d->RemoveGeometry(current_entry->id);
-        const open3d::geometry::PointCloud& cloud = current_entry->get_transformed();
-        scene3d->AddGeometry(current_entry->id, &cloud, standard_material);
+    menubar->SetEnabled(UNDO_TRANSFORMATION, this->history->can_undo());
+    menubar->SetEnabled(REDO_TRANSFORMATION, this->history->can_redo());
+}
+
+void GuiState::replace_entry(int index, std::shared_ptr<Entry> entry) {
+    auto previous = this->loaded_entries.at(index);
+    this->loaded_entries.replace(index, entry);
+
+    if (this->reference_entry == previous) {
+        this->reference_entry = entry;
     }
-    else {
-        scene3d->ClearGeometry();
+}
+
+void GuiState::transform_current_entry(const Eigen::Matrix4d& transformation, const std::string& description) {
+    this->transform_loaded_entries({ this->entry_index }, transformation, description);
+}
+
+void GuiState::transform_selection(const Eigen::Matrix4d& transformation, std::string description) {
+    std::vector<int> indices = this->selected_indices();
+
+    if (indices.size() > 1) {
+        description += " und " + std::to_string(indices.size() - 1) + " weitere";
+    }
+
+    this->transform_loaded_entries(indices, transformation, description);
+}
+
+void GuiState::transform_loaded_entries(const std::vector<int>& indices, const Eigen::Matrix4d& transformation, const std::string& description) {
+    if (indices.empty()) {
+        return;
+    }
+
+    HistoryState before = this->capture_state();
+
+    std::vector<std::shared_ptr<Entry>> originals;
+    for (int index : indices) {
+        originals.push_back(this->loaded_entries.at(index));
+    }
+
+    // The copies only get their own points once they are transformed, which happens for all of them at once.
+    std::vector<std::shared_ptr<Entry>> copies = transform_entries(originals, transformation);
+
+    for (size_t k = 0; k < indices.size(); k++) {
+        this->replace_entry(indices[k], copies[k]);
+        this->journal->record_transform(*copies[k], transformation);
+    }
+
+    this->current_entry = std::make_shared<Entry>(*copies.front());
+    this->colorize_current_entry();
+    this->update_metrics();
+    this->commit(description, before);
+}
+
+std::vector<int> GuiState::selected_indices() const {
+    if (this->entry_index < 0) {
+        return {};
+    }
+
+    std::vector<int> indices = { this->entry_index };
+
+    for (const auto& id : this->selection) {
+        int index = this->loaded_entries.index_of(id);
+        if (index >= 0 && index != this->entry_index) {
+            indices.push_back(index);
+        }
+    }
+
+    // The set has no order, the list does.
+    std::sort(indices.begin() + 1, indices.end());
+    return indices;
+}
+
+void GuiState::show_selection_dialog() {
+    if (this->entry_index < 0) {
+        return;
+    }
+
+    const int em = this->window_ptr->GetTheme().font_size;
+
+    auto checkboxes = std::make_shared<std::vector<std::pair<std::string, std::shared_ptr<gui::Checkbox>>>>();
+    auto list = std::make_shared<gui::ScrollableVert>(int(std::ceil(0.25 * em)));
 
-        for (int i = 0; i < loaded_entries.size(); i++) {
-            std::shared_ptr<Entry> entry = NULL;
+    for (int i = 0; i < this->loaded_entries.size(); i++) {
+        const auto& entry = this->loaded_entries.at(i);
+        auto checkbox = std::make_shared<gui::Checkbox>(entry->name.c_str());
 
-            // Ignore the cloud in loaded_entries,
-            // if it is used for current_entry.
-            if (i != entry_index) {
-                entry = loaded_entries.at(i);
+        // The current point cloud is moved in any case.
+        checkbox->SetChecked(i == this->entry_index || this->selection.count(entry->id) > 0);
+        checkbox->SetEnabled(i != this->entry_index);
+
+        list->AddChild(checkbox);
+        checkboxes->emplace_back(entry->id, checkbox);
+    }
+
+    auto all = std::make_shared<gui::Button>("Alle");
+    all->SetOnClicked([checkboxes]() {
+        for (auto& pair : *checkboxes) {
+            pair.second->SetChecked(true);
+        }
+    });
+
+    auto none = std::make_shared<gui::Button>("Keine");
+    none->SetOnClicked([this, checkboxes]() {
+        for (auto& pair : *checkboxes) {
+            pair.second->SetChecked(pair.first == this->current_entry->id);
+        }
+    });
+
+    auto ok = std::make_shared<gui::Button>("OK");
+    ok->SetOnClicked([this, checkboxes]() {
+        this->selection.clear();
+        for (auto& pair : *checkboxes) {
+            if (pair.second->IsChecked()) {
+                this->selection.insert(pair.first);
             }
-            else {
-                entry = current_entry;
+        }
+
+        this->window_ptr->CloseDialog();
+        this->update_selection();
+    });
+
+    auto cancel = std::make_shared<gui::Button>("Abbrechen");
+    cancel->SetOnClicked([this]() { this->window_ptr->CloseDialog(); });
+
+    auto toggles = std::make_shared<gui::Horiz>(0, em);
+    toggles->AddChild(all);
+    toggles->AddFixed(em);
+    toggles->AddChild(none);
+
+    auto buttons = std::make_shared<gui::Horiz>(0, em);
+    buttons->AddChild(ok);
+    buttons->AddFixed(em);
+    buttons->AddChild(cancel);
+
+    auto layout = std::make_shared<gui::Vert>(0, gui::Margins(em));
+    layout->AddChild(std::make_shared<gui::Label>("Gemeinsam bewegen:"));
+    layout->AddFixed(em);
+    layout->AddChild(list);
+    layout->AddFixed(em);
+    layout->AddChild(gui::Horiz::MakeCentered(toggles));
+    layout->AddFixed(em);
+    layout->AddChild(gui::Horiz::MakeCentered(buttons));
+
+    auto dialog = std::make_shared<gui::Dialog>("Auswahl");
+    dialog->AddChild(layout);
+
+    this->window_ptr->ShowDialog(dialog);
+}
+
+void GuiState::update_selection() {
+    size_t count = this->selected_indices().size();
+    std::string text = count == 1 ? "Auswahl: 1 Punktewolke" : fmt::format("Auswahl: {} Punktewolken", count);
+    this->manipulator->SetSelection(text.c_str());
+    this->update_compression();
+}
+
+void GuiState::preview_selection(const std::optional<Eigen::Matrix4d>& transformation) {
+    if (!transformation) {
+        auto ids = std::move(this->selection_preview_ids);
+        this->selection_preview_ids.clear();
+        this->selection_preview.reset();
+
+        for (const auto& id : ids) {
+            if (this->scene_geometries.count(id) > 0) {
+                this->update_geometry_transform(id);
             }
+        }
+        return;
+    }
+
+    // Only the model matrix of the geometries changes, their points are transformed once the slider is released.
+    this->selection_preview = transformation;
+    std::vector<int> indices = this->selected_indices();
+
+    for (size_t k = 1; k < indices.size(); k++) {
+        for (auto& entry : this->shown_entries(indices[k])) {
+            this->selection_preview_ids.insert(entry->id);
 
-            const open3d::geometry::PointCloud& cloud = entry->get_transformed();
-            scene3d->AddGeometry(entry->id, &cloud, standard_material);
+            if (this->scene_geometries.count(entry->id) > 0) {
+                this->update_geometry_transform(entry->id);
+            }
         }
+    }
+}
 
-        scene3d->ShowAxes(true);
+void GuiState::update_entry_list() {
+    this->manipulator->entries->ClearItems();
+    for (const auto& entry : this->loaded_entries) {
+        this->manipulator->entries->AddItem(entry->name.c_str());
     }
 
-    auto& bounds = scene3d->GetBoundingBox();
+    if (this->entry_index >= 0) {
+        this->manipulator->entries->SetSelectedIndex(this->entry_index);
+    }
+}
 
-    if (!keep_camera) {
-        scene_wgt->SetupCamera(60.0, bounds, bounds.GetCenter().cast<float>());
+void GuiState::preprocess_entry(std::shared_ptr<Entry> original) {
+    if (original->is_compressed()) {
+        return;
     }
 
-    // Make sure scene is redrawn
-    scene_wgt->ForceRedraw();
+    std::string name = "Vorverarbeiten: " + original->name;
+
+    // Only the original data is read, which never changes. The job reads it from a copy,
+    // since the loaded point cloud may be compressed while it runs.
+    std::shared_ptr<const Entry> entry = std::make_shared<const Entry>(*original);
+
+    this->jobs->submit(name, PRIORITY_LOW, [this, entry](Job& job) {
+        // The drawing order comes first, since it decides how fast the point cloud can be drawn.
+        auto lod = entry->build_lod();
+        this->jobs->post([this, id = entry->id, lod]() {
+            this->for_each_copy(id, [&lod](Entry& e) { e.set_lod(lod); });
+        });
+        if (!job.set_progress(0.2)) {
+            return;
+        }
+
+        auto index = entry->build_index();
+        if (!job.set_progress(0.4)) {
+            return;
+        }
+
+        auto bvh = entry->build_bvh();
+        if (!job.set_progress(0.5)) {
+            return;
+        }
+
+        SurfaceEstimate surface = entry->compute_surface();
+        if (!job.set_progress(1.0)) {
+            return;
+        }
+
+        this->jobs->post([this, id = entry->id, index, bvh, surface]() {
+            this->for_each_copy(id, [&index, &bvh, &surface](Entry& e) {
+                e.set_index(index);
+                e.set_bvh(bvh);
+                if (!e.has_normals()) {
+                    e.set_surface(surface);
+                }
+            });
+        });
+    });
 }
 
-void GuiState::colorize_current_entry() {
-    auto& cloud = this->current_entry->get_transformed();
-    cloud.colors_.clear();
+void GuiState::update_compression() {
+    TraceSpan span("update_compression");
+
+    std::unordered_set<std::string> active;
+    for (int index : this->selected_indices()) {
+        active.insert(this->loaded_entries.at(index)->id);
+    }
+    if (this->reference_entry) {
+        active.insert(this->reference_entry->id);
+    }
+
+    std::vector<int> expanded;
+    for (int i = 0; i < this->loaded_entries.size(); i++) {
+        const auto& entry = this->loaded_entries.at(i);
+        if (entry->is_compressed() && (!this->compression_enabled || active.count(entry->id) > 0)) {
+            expanded.push_back(i);
+        }
+    }
+    this->expand_entries(expanded);
+
+    // The current point cloud may have been copied from a compressed entry.
+    if (this->current_entry->is_compressed()) {
+        this->current_entry->expand();
+        this->colorize_current_entry();
+    }
 
-    for (int i = 0; i < cloud.points_.size(); i++) {
-        Eigen::Vector3d c(1.0, 0.55, 0.0);
-        cloud.colors_.push_back(c);
+    if (!this->compression_enabled) {
+        return;
     }
+
+    for (const auto& entry : this->loaded_entries) {
+        if (entry->is_group() || entry->is_compressed() || active.count(entry->id) > 0) {
+            continue;
+        }
+
+        // A compact copy built before the normals were estimated would lose them.
+        if (!entry->get_compressed() || (entry->has_normals() && !entry->get_compressed()->has_normals())) {
+            auto job = this->compressing.find(entry->id);
+            if (job == this->compressing.end() || job->second->is_cancelled()) {
+                this->compress_entry(entry);
+            }
+            continue;
+        }
+
+        const std::string& id = entry->id;
+        entry->compress();
+        this->history->for_each_entry([&id](Entry& e) {
+            if (e.id == id) {
+                e.compress();
+            }
+        });
+    }
+
+    this->history->update_memory_usage();
+}
+
+void GuiState::compress_entry(std::shared_ptr<Entry> original) {
+    std::string name = "Komprimieren: " + original->name;
+
+    // The job reads a copy, the loaded point cloud may be expanded or replaced while it runs.
+    std::shared_ptr<const Entry> entry = std::make_shared<const Entry>(*original);
+
+    this->compressing[entry->id] = this->jobs->submit(name, PRIORITY_LOW, [this, entry](Job& job) {
+        auto compressed = entry->build_compressed();
+        if (!job.set_progress(1.0)) {
+            return;
+        }
+
+        this->jobs->post([this, id = entry->id, compressed]() {
+            this->compressing.erase(id);
+
+            // The compact copy is kept even if the point cloud became active, compressing it later is then free.
+            this->for_each_copy(id, [&compressed](Entry& e) { e.set_compressed(compressed); });
+            this->history->for_each_entry([&id, &compressed](Entry& e) {
+                if (e.id == id) {
+                    e.set_compressed(compressed);
+                }
+            });
+
+            this->update_compression();
+        });
+    });
+}
+
+void GuiState::expand_entries(const std::vector<int>& indices) {
+    std::vector<std::shared_ptr<Entry>> entries;
+    for (int index : indices) {
+        const auto& entry = this->loaded_entries.at(index);
+        if (entry->is_compressed()) {
+            entries.push_back(entry);
+        }
+    }
+
+    if (entries.empty()) {
+        return;
+    }
+
+    // Expanding already runs in parallel over the points, so the entries are expanded one after another.
+    TraceSpan span("expand_entries");
+    for (auto& entry : entries) {
+        entry->expand();
+    }
+
+    // Snapshots sharing the expanded points no longer keep them alive on their own.
+    this->history->update_memory_usage();
+}
+
+void GuiState::for_each_copy(const std::string& id, std::function<void(Entry&)> action) {
+    if (auto entry = this->loaded_entries.find(id)) {
+        action(*entry);
+    }
+
+    if (this->current_entry->id == id) {
+        action(*this->current_entry);
+    }
+}
+
+void GuiState::register_current_entry(int target_index, RegistrationMethod method, bool restrict_to_overlap) {
+    this->expand_entries({ this->entry_index, target_index });
+
+    const auto& live_source = this->loaded_entries.at(this->entry_index);
+    const auto& live_target = this->loaded_entries.at(target_index);
+
+    // The job works on snapshots, the loaded entries may change while it runs.
+    auto source = std::make_shared<Entry>(*live_source);
+    auto target = std::make_shared<Entry>(*live_target);
+    uint64_t revision = live_source->get_revision();
+
+    std::string name = "Ann\xC3\xA4hern: " + live_source->name; // Annähern
+
+    this->jobs->submit(name, PRIORITY_HIGH, [=](Job& job) {
+        // Groups are registered as a single point cloud holding all their points. The merged points, their normals
+        // and their search index stay on the group, so that only the first registration of a group builds them.
+        auto registered_source = source->is_group() ? flattened_view(*source) : source;
+        auto registered_target = target->is_group() ? flattened_view(*target) : target;
+
+        auto output = register_entries(*registered_source, *registered_target, method, restrict_to_overlap,
+            [&job](double progress) { return job.set_progress(progress); });
+
+        if (source->is_group()) {
+            keep_flattened_caches(*source, *registered_source);
+        }
+        if (target->is_group()) {
+            keep_flattened_caches(*target, *registered_target);
+        }
+
+        if (output.cancelled) {
+            return;
+        }
+
+        this->jobs->post([=]() {
+            // Caches only depend on the original data, so they are kept in any case.
+            this->for_each_copy(source->id, [&source](Entry& e) { e.share_caches(*source); });
+            this->for_each_copy(target->id, [&target](Entry& e) { e.share_caches(*target); });
+
+            // Loaded entries are replaced when they change, so the entry is looked up by id.
+            int index = this->loaded_entries.index_of(source->id);
+
+            if (index < 0 || this->loaded_entries.at(index)->get_revision() != revision) {
+                this->window_ptr->ShowMessageBox("Ann\xC3\xA4hern verworfen", // Annähern
+                    "Die Punktewolke wurde w\xC3\xA4hrend des Ann\xC3\xA4herns ver\xC3\xA4ndert oder entfernt.");
+                return;
+            }
+
+            HistoryState before = this->capture_state();
+
+            auto entry = std::make_shared<Entry>(*this->loaded_entries.at(index));
+            entry->do_transform(output.result.transformation_);
+            this->replace_entry(index, entry);
+            this->journal->record_transform(*entry, output.result.transformation_);
+
+            if (this->entry_index == index) {
+                this->current_entry = std::make_shared<Entry>(*entry);
+                this->colorize_current_entry();
+            }
+
+            this->update_metrics();
+            this->commit("Ann\xC3\xA4hern: " + entry->name, before); // Annähern
+            this->set_scene(false, true);
+
+            const auto& parameters = output.parameters;
+            std::string summary = fmt::format(
+                "Punktabstand: {:.4g}\n"
+                "Korrespondenzabstand: {:.4g}\n"
+                "Konvergenzschwellen: {:.2g} (Fitness), {:.2g} (RMSE)\n\n"
+                "Iterationen: {} von {}\n"
+                "Fitness: {:.4f}\n"
+                "RMSE: {:.4g}",
+                parameters.point_spacing,
+                parameters.max_correspondence_distance,
+                parameters.relative_fitness,
+                parameters.rmse_change,
+                output.iterations,
+                parameters.max_iteration,
+                output.result.fitness_,
+                output.result.inlier_rmse_
+            );
+            if (source->is_lossy() || target->is_lossy()) {
+                summary += std::string("\n\n") + LOSSY_NOTE;
+            }
+
+            open3d::utility::LogInfo("ICP finished.\n{}", summary);
+            this->window_ptr->ShowMessageBox("Ann\xC3\xA4hern abgeschlossen", summary.c_str()); // Annähern
+        });
+    });
+}
+
+void GuiState::merge_current_entry(int other_index) {
+    this->expand_entries({ other_index });
+
+    auto e_1 = this->loaded_entries.at(this->entry_index);
+    auto e_2 = this->loaded_entries.at(other_index);
+
+    HistoryState before = this->capture_state();
+
+    // Do not use current_entry, since it is recolored.
+    // The group only references both point clouds, so no points are copied.
+    std::shared_ptr<Entry> entry = group_entries({ e_1, e_2 });
+    this->loaded_entries.push_back(entry);
+    this->journal->record_merge(*entry, { e_1, e_2 });
+    this->manipulator->entries->AddItem(entry->name.c_str());
+    this->update_reference_list();
+    this->update_compression();
+    this->commit("Verschmelzen: " + entry->name, before);
+    this->set_scene(false, true);
+}
+
+void GuiState::flatten_current_entry() {
+    if (this->entry_index < 0 || !this->loaded_entries.at(this->entry_index)->is_group()) {
+        this->window_ptr->ShowMessageBox("", "Die gew\xC3\xA4hlte Punktewolke ist keine Gruppe.");
+        return;
+    }
+
+    auto group = this->loaded_entries.at(this->entry_index);
+    std::string name = "Zusammenfassen: " + group->name;
+
+    // The parts of a group never change, so the job may read them while the group is replaced.
+    this->jobs->submit(name, PRIORITY_NORMAL, [this, group](Job& job) {
+        std::shared_ptr<Entry> entry = flatten_group(*group, [&job](double progress) { return job.set_progress(0.9 * progress); });
+        if (!entry) {
+            return;
+        }
+
+        this->jobs->post([this, group, entry]() {
+            int index = this->loaded_entries.index_of(group->id);
+
+            if (index < 0 || this->loaded_entries.at(index) != group) {
+                this->window_ptr->ShowMessageBox("Zusammenfassen verworfen",
+                    "Die Gruppe wurde w\xC3\xA4hrend des Zusammenfassens ver\xC3\xA4ndert oder entfernt.");
+                return;
+            }
+
+            HistoryState before = this->capture_state();
+            this->replace_entry(index, entry);
+            this->journal->record_flatten(*entry, *group);
+
+            if (this->entry_index == index) {
+                this->current_entry = std::make_shared<Entry>(*entry);
+                this->colorize_current_entry();
+            }
+
+            this->update_reference_list();
+            this->update_compression();
+            this->update_metrics();
+            this->commit("Zusammenfassen: " + entry->name, before);
+            this->set_scene(false, true);
+            this->preprocess_entry(entry);
+        });
+    });
+}
+
+void GuiState::export_current_entry(const std::string& path) {
+    if (this->entry_index < 0) {
+        this->window_ptr->ShowMessageBox("", "Es ist keine Punktewolke geladen.");
+        return;
+    }
+
+    // The job reads a copy, since the loaded point cloud may be compressed while it runs.
+    std::shared_ptr<const Entry> entry = std::make_shared<const Entry>(*this->loaded_entries.at(this->entry_index));
+    Eigen::Matrix4d t = entry->get_transformation();
+
+    std::string name = "Exportieren: " + entry->name;
+
+    if (entry->is_lossy()) {
+        this->window_ptr->ShowMessageBox("Warnung", LOSSY_NOTE);
+    }
+
+    this->jobs->submit(name, PRIORITY_NORMAL, [this, entry, t, path](Job& job) {
+        auto update_progress = [&job](double progress) { return job.set_progress(progress); };
+        bool success = entry->is_group()
+            ? export_group(*entry, path, update_progress)
+            : export_cloud(entry->get_base(), t, path, update_progress);
+
+        if (!success && !job.is_cancelled()) {
+            this->jobs->post([this, path]() {
+                auto msg = std::string("Punktewolke konnte nicht nach ") + path + " geschrieben werden";
+                this->window_ptr->ShowMessageBox("Fehler", msg.c_str());
+            });
+        }
+    });
+}
+
+bool GuiState::update_job_panel() {
+    auto active = this->jobs->get_jobs();
+    this->job_panel->SetJobs(active);
+
+    // The panel only needs a new layout if rows appear or disappear.
+    if (active.size() != this->job_panel_count) {
+        this->job_panel_count = active.size();
+        this->window_ptr->SetNeedsLayout();
+    }
+
+    return !active.empty();
+}
+
+void GuiState::update_difference() {
+    // The difference is drawn as a copy of the source, which a group does not have. Enabling it explains this.
+    bool has_reference = this->difference_enabled && this->reference_entry && this->entry_index >= 0
+        && this->reference_entry != this->loaded_entries.at(this->entry_index)
+        && !this->reference_entry->is_group() && !this->loaded_entries.at(this->entry_index)->is_group();
+
+    std::shared_ptr<Entry> source = has_reference ? this->loaded_entries.at(this->entry_index) : nullptr;
+    std::shared_ptr<Entry> target = this->reference_entry;
+
+    // Results for other point clouds cannot be reused.
+    if (!has_reference || source->id != this->difference_source_id || target->id != this->difference_target_id) {
+        if (this->difference_job) {
+            this->difference_job->cancel();
+            this->difference_job.reset();
+        }
+
+        this->difference.reset();
+        this->difference_entry.reset();
+        this->difference_pose.reset();
+        this->difference_source_id = has_reference ? source->id : "";
+        this->difference_target_id = has_reference ? target->id : "";
+    }
+
+    if (!has_reference) {
+        return;
+    }
+
+    Eigen::Matrix4d source_transformation = source->get_transformation();
+    Eigen::Matrix4d pose = target->get_transformation().inverse() * source_transformation;
+
+    if (this->difference_pose && *this->difference_pose == pose) {
+        return;
+    }
+
+    if (this->difference_job) {
+        this->difference_job->cancel();
+    }
+
+    this->difference_pose = pose;
+
+    std::string name = "Differenz: " + source->name;
+    std::string entry_name = source->name + " (Differenz)";
+    auto index = target->get_cached_index();
+    auto lod = source->get_lod();
+    auto previous = this->difference;
+
+    // Only the original data of both point clouds is read, which never changes. The job reads it
+    // from copies, since the loaded point clouds may be compressed while it runs.
+    std::shared_ptr<const Entry> source_copy = std::make_shared<const Entry>(*source);
+    std::shared_ptr<const Entry> target_copy = std::make_shared<const Entry>(*target);
+
+    this->difference_job = this->jobs->submit(name, PRIORITY_NORMAL,
+        [this, source = source_copy, target = target_copy, source_transformation, pose, entry_name, index, lod, previous](Job& job) {
+        auto target_index = index ? index : target->build_index();
+
+        double max_distance = previous
+            ? previous->max_distance
+            : INLIER_SPACING_FACTOR * estimate_point_spacing(target->get_base(), *target_index);
+
+        auto result = compute_difference(source->get_base(), *target_index, pose, max_distance, previous.get(),
+            [&job](double progress) { return job.set_progress(0.9 * progress); });
+
+        if (!result) {
+            return;
+        }
+
+        auto entry = std::make_shared<Entry>(source->get_base());
+        entry->name = entry_name;
+        entry->do_transform(source_transformation);
+        entry->set_lod(lod);
+        PreviewPipeline::colorize(*entry, &result->distances, result->max_distance);
+
+        if (!job.set_progress(1.0)) {
+            return;
+        }
+
+        this->jobs->post([this, source_id = source->id, target_id = target->id, built = !index, target_index, result, entry]() {
+            if (built) {
+                this->for_each_copy(target_id, [&target_index](Entry& e) { e.set_index(target_index); });
+            }
+
+            // A newer comparison was requested in the meantime.
+            if (source_id != this->difference_source_id || target_id != this->difference_target_id
+                || !this->difference_pose || *this->difference_pose != result->relative_transformation) {
+                return;
+            }
+
+            this->difference = result;
+            this->difference_entry = entry;
+            this->difference_job.reset();
+            this->set_scene(false, true);
+        });
+    });
+}
+
+void GuiState::pick_point(int x, int y) {
+    if (!this->picking_enabled || this->entry_index < 0) {
+        return;
+    }
+
+    if (!this->reference_entry || this->reference_entry->id == this->current_entry->id) {
+        this->window_ptr->ShowMessageBox("", "Zum W\xC3\xA4hlen von Punktpaaren muss eine andere Punktewolke als Referenz ausgew\xC3\xA4hlt sein.");
+        return;
+    }
+
+    if (this->current_entry->is_group() || this->reference_entry->is_group()) {
+        this->window_ptr->ShowMessageBox("", "In Gruppen k\xC3\xB6nnen keine Punktpaare gew\xC3\xA4hlt werden. "
+            "Sie lassen sich unter \"Bearbeiten > Gruppe zusammenfassen\" zu einer Punktewolke zusammenfassen.");
+        return;
+    }
+
+    if (this->current_entry->id != this->picked_source_id || this->reference_entry->id != this->picked_target_id) {
+        this->source_picks.clear();
+        this->target_picks.clear();
+        this->picked_source_id = this->current_entry->id;
+        this->picked_target_id = this->reference_entry->id;
+    }
+
+    const gui::Rect& frame = scene_wgt->GetFrame();
+    if (frame.width <= 0 || frame.height <= 0) {
+        return;
+    }
+
+    // Any depth yields a point on the ray through the pixel.
+    auto* camera = scene_wgt->GetScene()->GetCamera();
+    Eigen::Vector3d origin = camera->GetPosition().cast<double>();
+    Eigen::Vector3d on_ray = camera->Unproject(float(x), float(y), 0.5f, float(frame.width), float(frame.height)).cast<double>();
+    Eigen::Vector3d direction = (on_ray - origin).normalized();
+
+    const double PI = 3.1415926535898;
+    double pixel_size = 2.0 * std::tan(0.5 * camera->GetFieldOfView() * PI / 180.0) / frame.height;
+
+    bool pick_source = this->source_picks.size() <= this->target_picks.size();
+    Entry& entry = pick_source ? *this->current_entry : *this->reference_entry;
+
+    std::optional<size_t> index = entry.pick(origin, direction, PICK_RADIUS * pixel_size);
+    if (!index) {
+        return;
+    }
+
+    Eigen::Vector3d point = entry.get_base().points_[*index];
+    (pick_source ? this->source_picks : this->target_picks).push_back(point);
+
+    this->show_picks();
+    scene_wgt->ForceRedraw();
+}
+
+void GuiState::align_picks() {
+    bool picked_on_selection = this->entry_index >= 0 && this->reference_entry
+        && this->current_entry->id == this->picked_source_id
+        && this->reference_entry->id == this->picked_target_id;
+
+    if (!picked_on_selection || this->target_picks.size() < 3) {
+        this->window_ptr->ShowMessageBox("", "Es m\xC3\xBCssen mindestens drei Punktpaare gew\xC3\xA4hlt sein.");
+        return;
+    }
+
+    const auto& live_entry = this->loaded_entries.at(this->entry_index);
+    Eigen::Matrix4d source_transformation = live_entry->get_transformation();
+    Eigen::Matrix4d target_transformation = this->reference_entry->get_transformation();
+
+    // A source point without its counterpart on the reference is ignored.
+    std::vector<Eigen::Vector3d> source;
+    std::vector<Eigen::Vector3d> target;
+
+    for (size_t i = 0; i < this->target_picks.size(); i++) {
+        source.push_back((source_transformation * this->source_picks[i].homogeneous()).head<3>());
+        target.push_back((target_transformation * this->target_picks[i].homogeneous()).head<3>());
+    }
+
+    std::optional<Eigen::Matrix4d> transformation = estimate_rigid_transform(source, target);
+    if (!transformation) {
+        this->window_ptr->ShowMessageBox("", "Die gew\xC3\xA4hlten Punkte liegen auf einer Linie. Bitte weitere Punktpaare w\xC3\xA4hlen.");
+        return;
+    }
+
+    this->stop_preview();
+    this->transform_current_entry(*transformation, "Punktpaare: " + live_entry->name);
+    this->manipulator->ResetSliders();
+}
+
+void GuiState::show_picks() {
+    bool picked_on_selection = this->reference_entry
+        && this->current_entry->id == this->picked_source_id
+        && this->reference_entry->id == this->picked_target_id;
+
+    if (!picked_on_selection) {
+        this->source_picks.clear();
+        this->target_picks.clear();
+    }
+
+    std::string text = fmt::format("{} Paare", this->target_picks.size());
+    if (this->source_picks.size() > this->target_picks.size()) {
+        text += ", Punkt auf Referenz w\xC3\xA4hlen"; // wählen
+    }
+    this->manipulator->SetPairs(text.c_str());
+
+    // Picks follow their point clouds, including previews of the current one.
+    // There are only a few of them, so comparing the markers is cheap compared to uploading them.
+    open3d::geometry::PointCloud markers;
+
+    if (!this->source_picks.empty()) {
+        Eigen::Matrix4d source_transformation = this->current_entry->get_transformation();
+        Eigen::Matrix4d target_transformation = this->reference_entry->get_transformation();
+
+        for (const Eigen::Vector3d& p : this->source_picks) {
+            markers.points_.push_back((source_transformation * p.homogeneous()).head<3>());
+            markers.colors_.push_back(Eigen::Vector3d(1.0, 0.0, 0.0));
+        }
+
+        for (const Eigen::Vector3d& p : this->target_picks) {
+            markers.points_.push_back((target_transformation * p.homogeneous()).head<3>());
+            markers.colors_.push_back(Eigen::Vector3d(0.0, 0.4, 1.0));
+        }
+    }
+
+    if (markers.points_ == this->shown_picks.points_ && markers.colors_ == this->shown_picks.colors_) {
+        return;
+    }
+
+    auto scene3d = scene_wgt->GetScene();
+
+    if (!this->shown_picks.points_.empty()) {
+        scene3d->RemoveGeometry(PICKS_GEOMETRY);
+    }
+
+    if (!markers.points_.empty()) {
+        rendering::MaterialRecord material = standard_material;
+        material.point_size = PICK_MARKER_SCALE * standard_material.point_size;
+        scene3d->AddGeometry(PICKS_GEOMETRY, &markers, material);
+    }
+
+    this->shown_picks = std::move(markers);
+}
+
+void GuiState::update_performance() {
+    std::string text;
+    text += format_timer("Tick", TIMER_TICK);
+    text += format_timer("Transformieren", TIMER_TRANSFORM);
+    text += format_timer("Einf\xC3\xA4rben", TIMER_COLORIZE); // Einfärben
+    text += format_timer("Hochladen", TIMER_UPLOAD);
+
+    TimerStats icp = get_timer_stats(TIMER_ICP);
+    if (icp.amount > 0) {
+        double per_iteration = std::chrono::duration<double, std::milli>(icp.total).count() / double(icp.amount);
+        text += fmt::format("ICP: {:.2f} ms pro Iteration ({} Iterationen)\n", per_iteration, icp.amount);
+    }
+    else {
+        text += "ICP: -\n";
+    }
+
+    TimerStats load = get_timer_stats(TIMER_LOAD);
+    double load_seconds = std::chrono::duration<double>(load.total).count();
+    if (load.amount > 0 && load_seconds > 0.0) {
+        text += fmt::format("Laden: {:.1f} MB/s\n", double(load.amount) / load_seconds / 1e6);
+    }
+    else {
+        text += "Laden: -\n";
+    }
+
+    text += fmt::format("Verlauf: {:.1f} MB\n", double(this->history->get_memory_usage()) / 1e6);
+
+    for (auto& entry : this->visible_entries()) {
+        auto uploaded = this->scene_geometries.find(entry->id);
+        size_t drawn = uploaded != this->scene_geometries.end() ? uploaded->second.point_count : 0;
+
+        text += fmt::format("\n{}: {} / {} Punkte, {:.1f} MB",
+            entry->name, drawn, entry->get_point_count(), double(entry->get_memory_usage()) / 1e6);
+    }
+
+    this->performance_text->SetText(text.c_str());
+    this->window_ptr->SetNeedsLayout();
+}
+
+std::vector<std::shared_ptr<Entry>> GuiState::visible_entries() {
+    std::vector<std::shared_ptr<Entry>> visible;
+
+    for (int i = 0; i < loaded_entries.size(); i++) {
+        auto shown = this->shown_entries(i);
+        visible.insert(visible.end(), shown.begin(), shown.end());
+    }
+
+    return visible;
+}
+
+std::vector<std::shared_ptr<Entry>> GuiState::shown_entries(int index) {
+    std::shared_ptr<Entry> entry;
+
+    // Ignore the cloud in loaded_entries,
+    // if it is used for current_entry.
+    if (index != entry_index) {
+        entry = loaded_entries.at(index);
+    }
+    else if (this->difference_entry && !this->preview_source
+        && this->difference->relative_transformation == *this->difference_pose) {
+        entry = difference_entry;
+    }
+    else {
+        entry = current_entry;
+    }
+
+    if (entry->is_group()) {
+        return entry->get_part_views();
+    }
+
+    return { entry };
+}
+
+open3d::geometry::AxisAlignedBoundingBox GuiState::scene_bounds() {
+    open3d::geometry::AxisAlignedBoundingBox result;
+    bool first = true;
+
+    for (auto& entry : this->visible_entries()) {
+        if (entry->get_point_count() == 0) {
+            continue;
+        }
+
+        const auto& bounds = entry->get_bounds();
+        if (first) {
+            result = bounds;
+            first = false;
+        }
+        else {
+            result.min_bound_ = result.min_bound_.cwiseMin(bounds.min_bound_);
+            result.max_bound_ = result.max_bound_.cwiseMax(bounds.max_bound_);
+        }
+    }
+
+    return result;
+}
+
+void GuiState::allocate_points(const std::vector<std::shared_ptr<Entry>>& entries) {
+    this->point_allocation.clear();
+
+    if (!this->point_budget_enabled) {
+        for (auto& entry : entries) {
+            this->point_allocation[entry->id] = entry->get_point_count();
+        }
+        return;
+    }
+
+    auto* camera = this->scene_wgt->GetScene()->GetCamera();
+
+    BudgetView view;
+    view.camera_position = camera->GetPosition().cast<double>();
+    view.camera_forward = camera->GetForwardVector().cast<double>();
+    view.camera_up = camera->GetUpVector().cast<double>();
+    view.field_of_view = camera->GetFieldOfView();
+    view.viewport_width = std::max(1, this->scene_wgt->GetFrame().width);
+    view.viewport_height = std::max(1, this->scene_wgt->GetFrame().height);
+
+    std::vector<BudgetRequest> requests;
+    for (auto& entry : entries) {
+        const auto& bounds = entry->get_bounds();
+
+        BudgetRequest request;
+        request.point_count = entry->get_point_count();
+        request.min_bound = bounds.min_bound_;
+        request.max_bound = bounds.max_bound_;
+        requests.push_back(request);
+    }
+
+    auto counts = allocate_point_budget(requests, view, POINT_BUDGET);
+    for (size_t i = 0; i < entries.size(); i++) {
+        this->point_allocation[entries.at(i)->id] = counts.at(i);
+    }
+}
+
+void GuiState::upload_entry(Entry& entry, size_t point_count) {
+    ScopedTimer timer(TIMER_UPLOAD);
+    TraceSpan span("upload_entry");
+    auto scene3d = scene_wgt->GetScene();
+
+    if (scene_geometries.count(entry.id) > 0) {
+        scene3d->RemoveGeometry(entry.id);
+    }
+
+    const open3d::geometry::PointCloud& cloud = entry.get_transformed();
+
+    if (entry.is_compressed()) {
+        // Only the points that are drawn are restored.
+        point_count = std::min(point_count, entry.get_point_count());
+        // Part views are restored in the pose of their part, like the points they share.
+        Eigen::Matrix4d pose = entry.get_model_transformation().inverse() * entry.get_transformation();
+        auto subset = entry.get_compressed()->expand_points(pose, entry.get_lod().get(), point_count);
+        scene3d->AddGeometry(entry.id, subset.get(), standard_material);
+    }
+    else if (point_count >= cloud.points_.size() && !entry.get_display_colors()) {
+        scene3d->AddGeometry(entry.id, &cloud, standard_material);
+        point_count = cloud.points_.size();
+    }
+    else {
+        // Display colors are kept apart from the points, so they are combined in a temporary cloud.
+        point_count = std::min(point_count, cloud.points_.size());
+        auto lod = entry.get_lod();
+        auto colors = entry.get_display_colors();
+        auto subset = select_points(cloud, lod.get(), point_count, colors.get());
+        scene3d->AddGeometry(entry.id, subset.get(), standard_material);
+    }
+
+    scene_geometries[entry.id] = SceneGeometry{ entry.get_revision(), point_count, entry.get_model_transformation() };
+    this->update_geometry_transform(entry.id);
+}
+
+void GuiState::update_geometry_transform(const std::string& id) {
+    Eigen::Matrix4d model = this->scene_geometries.at(id).model;
+
+    // Geometries replaced while a slider is dragged keep following the preview.
+    if (this->selection_preview && this->selection_preview_ids.count(id) > 0) {
+        model = *this->selection_preview * model;
+    }
+
+    this->scene_wgt->GetScene()->SetGeometryTransform(id, model);
+}
+
+bool GuiState::refine_points() {
+    auto* camera = this->scene_wgt->GetScene()->GetCamera();
+    Eigen::Vector3f position = camera->GetPosition();
+    Eigen::Vector3f forward = camera->GetForwardVector();
+    double field_of_view = camera->GetFieldOfView();
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (position != this->last_camera_position || forward != this->last_camera_forward || field_of_view != this->last_field_of_view) {
+        this->last_camera_position = position;
+        this->last_camera_forward = forward;
+        this->last_field_of_view = field_of_view;
+        this->camera_changed = now;
+        return false;
+    }
+
+    if (now - this->camera_changed < CAMERA_REST_TIME) {
+        return false;
+    }
+
+    auto visible = this->visible_entries();
+    this->allocate_points(visible);
+
+    // Reduce first, so that the budget is not exceeded in between.
+    std::shared_ptr<Entry> next;
+    bool next_reduces = false;
+    size_t next_difference = 0;
+
+    for (auto& entry : visible) {
+        auto uploaded = this->scene_geometries.find(entry->id);
+        if (uploaded == this->scene_geometries.end()) {
+            continue;
+        }
+
+        size_t target = this->point_allocation.at(entry->id);
+        size_t current = uploaded->second.point_count;
+
+        if (target == current) {
+            continue;
+        }
+
+        bool reduces = target < current;
+        size_t difference = reduces ? current - target : target - current;
+
+        if ((reduces && !next_reduces) || (reduces == next_reduces && difference > next_difference)) {
+            next = entry;
+            next_reduces = reduces;
+            next_difference = difference;
+        }
+    }
+
+    if (!next) {
+        return false;
+    }
+
+    this->upload_entry(*next, this->point_allocation.at(next->id));
+    this->scene_wgt->ForceRedraw();
+    return true;
+}
+
+void GuiState::set_scene(bool only_update_selected, bool keep_camera) {
+    TraceSpan span("set_scene");
+    auto scene3d = scene_wgt->GetScene();
+
+    this->update_difference();
+
+    std::vector<std::shared_ptr<Entry>> visible = this->visible_entries();
+    this->allocate_points(visible);
+
+    // Remove point clouds that are no longer loaded. The current point cloud may
+    // have been swapped for its difference or back, even if only it is updated.
+    std::unordered_set<std::string> visible_ids;
+    for (auto& entry : visible) {
+        visible_ids.insert(entry->id);
+    }
+
+    for (auto it = scene_geometries.begin(); it != scene_geometries.end();) {
+        if (visible_ids.count(it->first) == 0) {
+            scene3d->RemoveGeometry(it->first);
+            it = scene_geometries.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+
+    // Transformations apply to the whole selection, so all of it is brought up to date in the same pass.
+    if (only_update_selected && entry_index >= 0) {
+        visible.clear();
+        for (int index : this->selected_indices()) {
+            auto shown = this->shown_entries(index);
+            visible.insert(visible.end(), shown.begin(), shown.end());
+        }
+    }
+
+    // Upload point clouds that are new or changed since their last upload.
+    for (auto& entry : visible) {
+        size_t target = this->point_allocation.at(entry->id);
+        auto uploaded = scene_geometries.find(entry->id);
+
+        if (uploaded != scene_geometries.end()
+            && uploaded->second.revision == entry->get_revision()
+            && uploaded->second.point_count <= target) {
+            // Moving a group only changes the model matrix of its views.
+            Eigen::Matrix4d model = entry->get_model_transformation();
+            if (uploaded->second.model != model) {
+                uploaded->second.model = model;
+                this->update_geometry_transform(entry->id);
+            }
+            continue;
+        }
+
+        this->upload_entry(*entry, target);
+    }
+
+    scene3d->ShowAxes(true);
+
+    auto bounds = this->scene_bounds();
+
+    if (!keep_camera) {
+        scene_wgt->SetupCamera(60.0, bounds, bounds.GetCenter().cast<float>());
+    }
+
+    this->show_picks();
+
+    // Make sure scene is redrawn
+    scene_wgt->ForceRedraw();
+}
+
+void GuiState::update_reference_list() {
+    auto& reference = this->manipulator->reference;
+    reference->ClearItems();
+    reference->AddItem("(keine)");
+
+    int selected = 0;
+
+    for (int i = 0; i < this->loaded_entries.size(); i++) {
+        reference->AddItem(this->loaded_entries.at(i)->name.c_str());
+
+        if (this->loaded_entries.at(i) == this->reference_entry) {
+            selected = i + 1;
+        }
+    }
+
+    // The reference was removed.
+    if (selected == 0) {
+        this->reference_entry.reset();
+    }
+
+    reference->SetSelectedIndex(selected);
+}
+
+void GuiState::update_metrics() {
+    this->residuals.clear();
+    this->metrics_text.clear();
+
+    if (this->metrics_job) {
+        this->metrics_job->cancel();
+        this->metrics_job.reset();
+    }
+
+    bool has_reference = this->reference_entry && this->entry_index >= 0
+        && this->reference_entry != this->loaded_entries.at(this->entry_index);
+
+    if (!has_reference) {
+        this->manipulator->SetMetrics("-");
+        return;
+    }
+
+    const auto& live = this->loaded_entries.at(this->entry_index);
+
+    // The job works on snapshots, the loaded entries may change while it runs.
+    auto source = std::make_shared<Entry>(*this->current_entry);
+    auto target = std::make_shared<Entry>(*this->reference_entry);
+    uint64_t source_revision = live->get_revision();
+    uint64_t target_revision = this->reference_entry->get_revision();
+    bool with_residuals = this->show_residuals;
+
+    this->manipulator->SetMetrics("Wird berechnet...");
+
+    this->metrics_job = this->jobs->submit("Metriken: " + live->name, PRIORITY_HIGH, [=](Job& job) {
+        // Groups are measured as a single point cloud holding all their points, see `flattened_view`.
+        auto measured_source = source->is_group() ? flattened_view(*source) : source;
+        auto measured_target = target->is_group() ? flattened_view(*target) : target;
+
+        auto index = measured_target->get_cached_index();
+        auto target_index = index ? index : measured_target->build_index();
+        if (!index) {
+            measured_target->set_index(target_index);
+        }
+        if (target->is_group()) {
+            keep_flattened_caches(*target, *measured_target);
+        }
+
+        if (!job.set_progress(0.3)) {
+            return;
+        }
+
+        // Coloring requires the distance of every point, the summary does not.
+        // Groups are always colored uniformly, see `PreviewPipeline::colorize`.
+        bool colored = with_residuals && !source->is_group();
+        size_t count = measured_source->get_transformed().points_.size();
+        size_t stride = colored ? 1 : std::max<size_t>(1, count / METRICS_SAMPLES);
+
+        double max_distance = INLIER_SPACING_FACTOR * estimate_point_spacing(measured_target->get_base(), *target_index);
+        auto distances = std::make_shared<std::vector<double>>(
+            compute_distances(*measured_source, *measured_target, *target_index, stride));
+        RegistrationMetrics metrics = compute_metrics(*distances, max_distance);
+
+        std::string text = fmt::format(
+            "Fitness: {:.4f}\n"
+            "RMSE: {:.4g}\n"
+            "Abstand 50 %: {:.4g}\n"
+            "Abstand 90 %: {:.4g}\n"
+            "Abstand 95 %: {:.4g}\n"
+            "Abstand 99 %: {:.4g}",
+            metrics.fitness,
+            metrics.rmse,
+            metrics.p50,
+            metrics.p90,
+            metrics.p95,
+            metrics.p99
+        );
+
+        if (!job.set_progress(1.0)) {
+            return;
+        }
+
+        this->jobs->post([=]() {
+            this->for_each_copy(source->id, [&source](Entry& e) { e.share_caches(*source); });
+            this->for_each_copy(target->id, [&target](Entry& e) { e.share_caches(*target); });
+
+            // The result is outdated if either point cloud changed or another one was chosen in the meantime.
+            auto live_source = this->loaded_entries.find(source->id);
+            if (!live_source || this->loaded_entries.index_of(source->id) != this->entry_index
+                || live_source->get_revision() != source_revision
+                || !this->reference_entry || this->reference_entry->id != target->id
+                || this->reference_entry->get_revision() != target_revision
+                || this->show_residuals != with_residuals) {
+                return;
+            }
+
+            this->metrics_job.reset();
+            this->metrics_text = text;
+            this->manipulator->SetMetrics(this->metrics_text.c_str());
+
+            if (colored) {
+                this->residuals = std::move(*distances);
+                this->residual_max_distance = max_distance;
+                this->colorize_current_entry();
+                this->set_scene(true, true);
+            }
+        });
+    });
+}
+
+void GuiState::preview_slider(const ManipulatorEvent& event_) {
+    if (this->entry_index < 0) {
+        return;
+    }
+
+    // Dragging again continues from the slider values, the refinement of the previous release is outdated.
+    this->cancel_snap_refinement();
+
+    Eigen::Matrix4d t = make_matrix(event_.x_rotation, event_.y_rotation, event_.z_rotation, event_.x_translation, event_.y_translation, event_.z_translation);
+    this->request_preview(t);
+
+    if (this->snap_enabled) {
+        if (!this->snap_dragging) {
+            this->start_snapping();
+        }
+        if (this->snap_dragging) {
+            // Any earlier result belongs to outdated slider values.
+            this->snapped_pose.reset();
+            this->snap_worker->request(t);
+        }
+    }
+}
+
+void GuiState::request_preview(const Eigen::Matrix4d& transformation) {
+    const auto& live = this->loaded_entries.at(this->entry_index);
+
+    // The snapshot is taken once per drag, it is only replaced if the original changed.
+    if (!this->preview_source || this->preview_source->id != live->id
+        || this->preview_source->get_revision() != live->get_revision()) {
+        auto source = std::make_shared<Entry>(*live);
+
+        // The views of a group are colored once per drag, the previews only move them.
+        for (auto& view : source->modify_part_views()) {
+            PreviewPipeline::colorize(*view, nullptr, this->residual_max_distance);
+        }
+
+        this->preview_source = source;
+
+        std::shared_ptr<const std::vector<double>> residuals;
+        if (this->show_residuals) {
+            residuals = std::make_shared<const std::vector<double>>(this->residuals);
+        }
+
+        this->preview_pipeline->set_source(this->preview_source, residuals, this->residual_max_distance);
+    }
+
+    this->preview_pipeline->request(transformation);
+    this->preview_selection(transformation);
+}
+
+void GuiState::stop_preview() {
+    // The sliders still hold the pose that was being refined.
+    if (this->cancel_snap_refinement()) {
+        this->manipulator->ResetSliders();
+    }
+    this->pending_slider_event.reset();
+    this->preview_pipeline->cancel();
+    this->preview_source.reset();
+    this->preview_selection(std::nullopt);
+}
+
+bool GuiState::on_tick() {
+    ScopedTimer timer(TIMER_TICK);
+    TraceSpan span("on_tick");
+    bool redraw = this->jobs->dispatch() > 0;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - this->job_panel_updated >= JOB_PANEL_INTERVAL) {
+        this->job_panel_updated = now;
+        // Hiding the panel after the last job finished needs a redraw as well.
+        bool was_visible = this->job_panel_count > 0;
+        redraw = this->update_job_panel() || was_visible || redraw;
+    }
+
+    if (this->help_performance->IsVisible() && now - this->performance_updated >= PERFORMANCE_INTERVAL) {
+        this->performance_updated = now;
+        this->update_performance();
+        redraw = true;
+    }
+
+    redraw = this->refine_points() || redraw;
+    this->journal->sync();
+
+    // Upload the preview finished since the last tick, while the next one is computed.
+    if (auto preview = this->preview_pipeline->take()) {
+        this->current_entry = preview;
+        this->set_scene(true, true);
+        redraw = true;
+    }
+
+    if (!this->pending_slider_event) {
+        return redraw;
+    }
+
+    ManipulatorEvent event_ = *this->pending_slider_event;
+    this->pending_slider_event.reset();
+    this->preview_slider(event_);
+    return true;
+}
+
+void GuiState::start_snapping() {
+    // Snapping needs a proxy of both point clouds on every drag, groups are left out. Enabling it explains this.
+    bool has_reference = this->reference_entry && this->entry_index >= 0
+        && this->reference_entry != this->loaded_entries.at(this->entry_index)
+        && !this->reference_entry->is_group() && !this->loaded_entries.at(this->entry_index)->is_group();
+
+    // The search index of the reference is built in the background after loading.
+    // Until it is there, estimating the parameters would have to build it, so the drag does not snap yet.
+    if (!has_reference || !this->reference_entry->get_cached_index()) {
+        return;
+    }
+
+    auto source = std::make_shared<Entry>(*this->loaded_entries.at(this->entry_index));
+    auto target = std::make_shared<Entry>(*this->reference_entry);
+
+    this->snap_worker->set_clouds([source, target]() {
+        SnapClouds clouds;
+        clouds.source = SnapWorker::make_proxy(source->get_transformed());
+        clouds.target = SnapWorker::make_proxy(target->get_transformed());
+
+        // The correspondence distance decides how far the cloud gets pulled,
+        // so it is chosen once for the whole drag.
+        RegistrationParameters parameters = estimate_registration_parameters(*source, *target);
+        clouds.max_correspondence_distance = std::max(
+            parameters.max_correspondence_distance,
+            4.0 * SnapWorker::proxy_spacing(target->get_transformed(), parameters.point_spacing)
+        );
+        return clouds;
+    });
+    this->snapped_pose.reset();
+    this->snap_dragging = true;
+}
+
+void GuiState::finish_snapping(const Eigen::Matrix4d& slider_transform) {
+    this->snap_worker->cancel();
+    this->snap_dragging = false;
+
+    Eigen::Matrix4d start = this->snapped_pose.value_or(slider_transform);
+    this->snapped_pose.reset();
+    this->request_preview(start);
+
+    const auto& live = this->loaded_entries.at(this->entry_index);
+
+    // The job works on snapshots, the loaded entries may change while it runs.
+    auto source = std::make_shared<Entry>(*live);
+    auto target = std::make_shared<Entry>(*this->reference_entry);
+
+    std::vector<std::pair<std::string, uint64_t>> revisions;
+    for (int index : this->selected_indices()) {
+        const auto& entry = this->loaded_entries.at(index);
+        revisions.emplace_back(entry->id, entry->get_revision());
+    }
+
+    uint64_t refinement = ++this->snap_refinement;
+    std::string name = "Einrasten: " + live->name;
+
+    this->snap_job = this->jobs->submit(name, PRIORITY_HIGH, [=](Job& job) {
+        // Refine on a copy, so that the result enters the history as a single step.
+        auto candidate = std::make_shared<Entry>(*source);
+        candidate->do_transform(start);
+
+        auto output = register_entries(*candidate, *target, POINT_TO_PLANE, true,
+            [&job](double progress) { return job.set_progress(progress); });
+
+        if (output.cancelled) {
+            return;
+        }
+
+        Eigen::Matrix4d t = output.result.transformation_ * start;
+
+        this->jobs->post([=]() {
+            // Caches only depend on the original data, so they are kept in any case.
+            this->for_each_copy(candidate->id, [&candidate](Entry& e) { e.share_caches(*candidate); });
+            this->for_each_copy(target->id, [&target](Entry& e) { e.share_caches(*target); });
+
+            // The preview was dropped or the user started dragging again.
+            if (!this->snap_job || refinement != this->snap_refinement) {
+                return;
+            }
+
+            this->snap_job.reset();
+            this->stop_preview();
+            this->manipulator->ResetSliders();
+
+            std::vector<int> indices = this->selected_indices();
+            bool unchanged = indices.size() == revisions.size();
+            for (size_t k = 0; unchanged && k < indices.size(); k++) {
+                const auto& entry = this->loaded_entries.at(indices[k]);
+                unchanged = entry->id == revisions[k].first && entry->get_revision() == revisions[k].second;
+            }
+
+            if (!unchanged) {
+                this->window_ptr->ShowMessageBox("Einrasten verworfen",
+                    "Die Punktewolke wurde w\xC3\xA4hrend des Einrastens ver\xC3\xA4ndert oder entfernt.");
+                this->set_scene(true, true);
+                return;
+            }
+
+            this->transform_selection(t, "Verschieben: " + this->current_entry->name);
+            this->set_scene(true, true);
+        });
+    });
+}
+
+bool GuiState::cancel_snap_refinement() {
+    if (!this->snap_job) {
+        return false;
+    }
+
+    this->snap_job->cancel();
+    this->snap_job.reset();
+    return true;
+}
+
+void GuiState::on_snap_result(uint64_t id, const Eigen::Matrix4d& pose) {
+    if (!this->snap_dragging || !this->snap_worker->is_current(id)) {
+        return;
+    }
+
+    this->snapped_pose = pose;
+    this->request_preview(pose);
+}
+
+void GuiState::colorize_current_entry() {
+    TraceSpan span("colorize_current_entry");
+    PreviewPipeline::colorize(*this->current_entry, this->show_residuals ? &this->residuals : nullptr, this->residual_max_distance);
 }
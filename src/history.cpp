@@ -0,0 +1,140 @@
+#include <history.h>
+
+#include <algorithm>
+
+/// <summary>
+/// Adds up the memory of the entries in `side` that do not appear in `other`.
+/// </summary>
+static size_t one_sided_memory(const HistoryState& side, const HistoryState& other) {
+    size_t bytes = 0;
+
+    for (const auto& entry : side.entries) {
+        if (std::find(other.entries.begin(), other.entries.end(), entry) != other.entries.end()) {
+            continue;
+        }
+
+        auto copy = std::find_if(other.entries.begin(), other.entries.end(),
+            [&entry](const std::shared_ptr<Entry>& e) { return e->id == entry->id; });
+
+        if (copy == other.entries.end()) {
+            // Removed or added entirely, including the original data.
+            bytes += entry->get_memory_usage();
+        }
+        else if (!entry->shares_transformed(**copy)) {
+            bytes += entry->get_transformed_memory_usage();
+        }
+    }
+
+    return bytes;
+}
+
+CommandHistory::CommandHistory(size_t memory_limit) : memory_limit(memory_limit), memory_usage(0) {}
+
+size_t CommandHistory::retained_memory(const HistoryState& before, const HistoryState& after) {
+    // Entries only present afterwards are part of the live state. Counting them as well would count
+    // every intermediate state twice, once for the change creating it and once for the change replacing it.
+    return one_sided_memory(before, after);
+}
+
+void CommandHistory::push(const std::string& description, HistoryState before, HistoryState after) {
+    for (const HistoryCommand& command : this->redo_stack) {
+        this->memory_usage -= command.memory;
+    }
+    this->redo_stack.clear();
+
+    HistoryCommand command;
+    command.description = description;
+    command.memory = retained_memory(before, after);
+    command.before = std::move(before);
+    command.after = std::move(after);
+
+    this->memory_usage += command.memory;
+    this->undo_stack.push_back(std::move(command));
+    this->enforce_limit();
+}
+
+std::optional<HistoryState> CommandHistory::undo() {
+    if (this->undo_stack.empty()) {
+        return std::nullopt;
+    }
+
+    this->redo_stack.push_back(std::move(this->undo_stack.back()));
+    this->undo_stack.pop_back();
+    return this->redo_stack.back().before;
+}
+
+std::optional<HistoryState> CommandHistory::redo() {
+    if (this->redo_stack.empty()) {
+        return std::nullopt;
+    }
+
+    this->undo_stack.push_back(std::move(this->redo_stack.back()));
+    this->redo_stack.pop_back();
+    return this->undo_stack.back().after;
+}
+
+bool CommandHistory::can_undo() const {
+    return !this->undo_stack.empty();
+}
+
+bool CommandHistory::can_redo() const {
+    return !this->redo_stack.empty();
+}
+
+std::string CommandHistory::get_undo_description() const {
+    return this->undo_stack.empty() ? std::string() : this->undo_stack.back().description;
+}
+
+std::string CommandHistory::get_redo_description() const {
+    return this->redo_stack.empty() ? std::string() : this->redo_stack.back().description;
+}
+
+size_t CommandHistory::get_memory_usage() const {
+    return this->memory_usage;
+}
+
+void CommandHistory::clear() {
+    this->undo_stack.clear();
+    this->redo_stack.clear();
+    this->memory_usage = 0;
+}
+
+void CommandHistory::for_each_entry(const std::function<void(Entry&)>& action) {
+    auto visit = [&action](HistoryCommand& command) {
+        for (auto& entry : command.before.entries) {
+            action(*entry);
+        }
+        for (auto& entry : command.after.entries) {
+            action(*entry);
+        }
+    };
+
+    for (HistoryCommand& command : this->undo_stack) {
+        visit(command);
+    }
+    for (HistoryCommand& command : this->redo_stack) {
+        visit(command);
+    }
+}
+
+void CommandHistory::update_memory_usage() {
+    this->memory_usage = 0;
+
+    for (HistoryCommand& command : this->undo_stack) {
+        command.memory = retained_memory(command.before, command.after);
+        this->memory_usage += command.memory;
+    }
+    for (HistoryCommand& command : this->redo_stack) {
+        command.memory = retained_memory(command.before, command.after);
+        this->memory_usage += command.memory;
+    }
+
+    this->enforce_limit();
+}
+
+void CommandHistory::enforce_limit() {
+    while (this->memory_usage > this->memory_limit && this->undo_stack.size() > 1) {
+        this->memory_usage -= this->undo_stack.front().memory;
+        this->undo_stack.pop_front();
+    }
+}
@@ -0,0 +1,88 @@
+#include <job_panel.h>
+
+/// Number of jobs listed individually.
+static const size_t JOB_PANEL_ROWS = 5;
+
+JobPanel::JobPanel(int spacing, const gui::Margins& margins) : gui::Vert(spacing, margins) {
+    auto& theme = gui::Application::GetInstance().GetTheme();
+    const int em = theme.font_size;
+    const int grid_spacing = int(std::ceil(0.25 * em));
+
+    SetBackgroundColor(gui::Color(0, 0, 0, 0.5));
+
+    for (size_t i = 0; i < JOB_PANEL_ROWS; i++) {
+        auto row = std::make_shared<Row>();
+        row->name = std::make_shared<gui::Label>("");
+        row->name->SetTextColor(gui::Color(1, 1, 1));
+        row->progress = std::make_shared<gui::ProgressBar>();
+        row->cancel = std::make_shared<gui::Button>("Abbrechen");
+
+        // Capturing the row itself keeps the button working after the row shows another job.
+        std::weak_ptr<Row> weak_row = row;
+        row->cancel->SetOnClicked([weak_row]() {
+            if (auto row = weak_row.lock()) {
+                if (auto job = row->job.lock()) {
+                    job->cancel();
+                }
+            }
+        });
+
+        auto text = std::make_shared<gui::Vert>(grid_spacing);
+        text->AddChild(row->name);
+        text->AddChild(row->progress);
+
+        row->layout = std::make_shared<gui::Horiz>(em);
+        row->layout->AddChild(text);
+        row->layout->AddChild(row->cancel);
+        row->layout->SetVisible(false);
+
+        AddChild(row->layout);
+        rows.push_back(row);
+    }
+
+    overflow = std::make_shared<gui::Label>("");
+    overflow->SetTextColor(gui::Color(1, 1, 1));
+    overflow->SetVisible(false);
+    AddChild(overflow);
+
+    SetVisible(false);
+}
+
+void JobPanel::SetJobs(const std::vector<std::shared_ptr<Job>>& jobs) {
+    SetVisible(!jobs.empty());
+
+    for (size_t i = 0; i < rows.size(); i++) {
+        auto& row = *rows.at(i);
+
+        if (i >= jobs.size()) {
+            row.job.reset();
+            row.layout->SetVisible(false);
+            continue;
+        }
+
+        const auto& job = jobs.at(i);
+        std::string text = job->get_name();
+
+        if (job->is_cancelled()) {
+            text += " (wird abgebrochen)";
+        }
+        else if (job->get_state() == JOB_QUEUED) {
+            text += " (wartet)";
+        }
+
+        row.job = job;
+        row.name->SetText(text.c_str());
+        row.progress->SetValue(float(job->get_progress()));
+        row.cancel->SetEnabled(!job->is_cancelled());
+        row.layout->SetVisible(true);
+    }
+
+    if (jobs.size() > rows.size()) {
+        std::string text = fmt::format("{} weitere", jobs.size() - rows.size());
+        overflow->SetText(text.c_str());
+        overflow->SetVisible(true);
+    }
+    else {
+        overflow->SetVisible(false);
+    }
+}
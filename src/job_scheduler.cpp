@@ -0,0 +1,179 @@
+#include <job_scheduler.h>
+#include <tracing.h>
+
+#include <open3d/Open3D.h>
+
+#include <algorithm>
+
+/// Upper limit for the number of workers. Jobs parallelize internally,
+/// so more concurrent jobs only compete for the same cores.
+static const size_t MAX_WORKERS = 4;
+
+Job::Job(uint64_t id, const std::string& name, JobPriority priority) :
+    id(id),
+    name(name),
+    priority(priority),
+    state(JOB_QUEUED),
+    cancelled(false),
+    progress(0.0) {}
+
+uint64_t Job::get_id() const {
+    return id;
+}
+
+const std::string& Job::get_name() const {
+    return name;
+}
+
+JobPriority Job::get_priority() const {
+    return priority;
+}
+
+JobState Job::get_state() const {
+    return state;
+}
+
+void Job::cancel() {
+    cancelled = true;
+}
+
+bool Job::is_cancelled() const {
+    return cancelled;
+}
+
+bool Job::set_progress(double progress) {
+    this->progress = std::clamp(progress, 0.0, 1.0);
+    return !cancelled;
+}
+
+double Job::get_progress() const {
+    return progress;
+}
+
+bool JobScheduler::QueueOrder::operator()(const QueuedJob& a, const QueuedJob& b) const {
+    // The queue pops its greatest element, so lower priorities and later ids compare less.
+    if (a.job->priority != b.job->priority) {
+        return a.job->priority < b.job->priority;
+    }
+    return a.job->id > b.job->id;
+}
+
+JobScheduler::JobScheduler(size_t worker_count) :
+    stopping(false),
+    next_id(0) {
+    if (worker_count == 0) {
+        worker_count = std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, MAX_WORKERS);
+    }
+
+    for (size_t i = 0; i < worker_count; i++) {
+        workers.emplace_back([this]() { this->run(); });
+    }
+}
+
+JobScheduler::~JobScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        for (auto& job : jobs) {
+            job->cancel();
+        }
+    }
+    condition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+std::shared_ptr<Job> JobScheduler::submit(const std::string& name, JobPriority priority, std::function<void(Job&)> work) {
+    std::shared_ptr<Job> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = std::make_shared<Job>(next_id++, name, priority);
+        jobs.push_back(job);
+        queue.push(QueuedJob{ job, std::move(work) });
+    }
+    condition.notify_one();
+    return job;
+}
+
+void JobScheduler::post(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(posted_mutex);
+    posted.push_back(std::move(callback));
+}
+
+size_t JobScheduler::dispatch() {
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex);
+        callbacks.swap(posted);
+    }
+
+    // Callbacks may post again, those run with the next dispatch.
+    for (auto& callback : callbacks) {
+        callback();
+    }
+
+    return callbacks.size();
+}
+
+std::vector<std::shared_ptr<Job>> JobScheduler::get_jobs() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs;
+}
+
+void JobScheduler::cancel_all() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& job : jobs) {
+        job->cancel();
+    }
+}
+
+void JobScheduler::retire(const std::shared_ptr<Job>& job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.erase(std::remove(jobs.begin(), jobs.end(), job), jobs.end());
+}
+
+void JobScheduler::run() {
+    set_trace_thread_name("job worker");
+
+    while (true) {
+        QueuedJob next;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !queue.empty(); });
+
+            if (stopping) {
+                return;
+            }
+
+            next = queue.top();
+            queue.pop();
+        }
+
+        Job& job = *next.job;
+
+        if (job.is_cancelled()) {
+            job.state = JOB_CANCELLED;
+            retire(next.job);
+            continue;
+        }
+
+        job.state = JOB_RUNNING;
+
+        try {
+            next.work(job);
+            job.state = job.is_cancelled() ? JOB_CANCELLED : JOB_FINISHED;
+        }
+        catch (const std::exception& e) {
+            open3d::utility::LogWarning("Job '{}' failed: {}", job.get_name(), e.what());
+            job.state = JOB_FAILED;
+        }
+        catch (...) {
+            open3d::utility::LogWarning("Job '{}' failed.", job.get_name());
+            job.state = JOB_FAILED;
+        }
+
+        retire(next.job);
+    }
+}
@@ -0,0 +1,867 @@
+#include <journal.h>
+#include <operations.h>
+#include <tracing.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#if defined(WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+/// Identifies a journal file. Followed by the version of the format.
+static const char JOURNAL_MAGIC[4] = { 'C', 'L', 'B', 'J' };
+
+/// Version of the file format, increased whenever records change.
+static const uint32_t JOURNAL_VERSION = 1;
+
+/// Size of the magic and the version at the start of the file.
+static const size_t JOURNAL_HEADER_SIZE = 8;
+
+/// Start of the file name of every journal, followed by the process id of its instance.
+static const char* JOURNAL_PREFIX = "calibrator_journal";
+
+/// Shortest time between two syncs, see `Journal::sync`.
+static const std::chrono::milliseconds JOURNAL_SYNC_INTERVAL(1000);
+
+/// Upper bound for the payload of a record, so that a corrupted size is not taken for a huge record.
+static const uint32_t MAX_RECORD_SIZE = 1 << 24;
+
+static void put_u32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+static void put_string(std::vector<uint8_t>& out, const std::string& value) {
+    put_u32(out, uint32_t(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+static void put_matrix(std::vector<uint8_t>& out, const Eigen::Matrix4d& matrix) {
+    for (int i = 0; i < 16; i++) {
+        uint64_t bits;
+        double value = matrix(i % 4, i / 4);
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        for (int k = 0; k < 8; k++) {
+            out.push_back(uint8_t(bits >> (8 * k)));
+        }
+    }
+}
+
+/// <summary>
+/// Reads the values written by the `put_` functions. Reading past the end sets `failed` instead of throwing.
+/// </summary>
+struct RecordReader {
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+    bool failed = false;
+
+    bool has(size_t count) {
+        failed = failed || size - offset < count;
+        return !failed;
+    }
+
+    uint32_t u32() {
+        if (!has(4)) {
+            return 0;
+        }
+
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= uint32_t(data[offset++]) << (8 * i);
+        }
+        return value;
+    }
+
+    std::string string() {
+        uint32_t length = u32();
+        if (!has(length)) {
+            return std::string();
+        }
+
+        std::string value(reinterpret_cast<const char*>(data + offset), length);
+        offset += length;
+        return value;
+    }
+
+    Eigen::Matrix4d matrix() {
+        Eigen::Matrix4d matrix = Eigen::Matrix4d::Identity();
+        if (!has(16 * 8)) {
+            return matrix;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            uint64_t bits = 0;
+            for (int k = 0; k < 8; k++) {
+                bits |= uint64_t(data[offset++]) << (8 * k);
+            }
+
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            matrix(i % 4, i / 4) = value;
+        }
+        return matrix;
+    }
+};
+
+/// <summary>
+/// FNV-1a hash, enough to detect a record that was only partially written.
+/// </summary>
+static uint32_t checksum(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static std::vector<uint8_t> read_file(const std::string& path, uint64_t size) {
+    std::vector<uint8_t> data;
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return data;
+    }
+
+    std::error_code error;
+    uint64_t file_size = std::filesystem::file_size(path, error);
+    data.resize(size_t(error ? 0 : std::min(size, file_size)));
+    stream.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size()));
+    data.resize(size_t(stream.gcount()));
+    return data;
+}
+
+static bool has_header(const std::vector<uint8_t>& data) {
+    if (data.size() < JOURNAL_HEADER_SIZE || std::memcmp(data.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+        return false;
+    }
+
+    RecordReader reader{ data.data() + sizeof(JOURNAL_MAGIC), sizeof(uint32_t) };
+    return reader.u32() == JOURNAL_VERSION;
+}
+
+/// <summary>
+/// Visits the complete records of a journal with a valid header.
+/// </summary>
+/// <returns>The offset after the last complete record.</returns>
+static size_t scan_records(const std::vector<uint8_t>& data, const std::function<void(JournalRecordType, RecordReader&)>& visit) {
+    size_t offset = JOURNAL_HEADER_SIZE;
+
+    while (data.size() - offset >= 9) {
+        RecordReader header{ data.data() + offset + 1, 4 };
+        uint32_t size = header.u32();
+
+        if (size > MAX_RECORD_SIZE || data.size() - offset - 9 < size) {
+            break;
+        }
+
+        RecordReader tail{ data.data() + offset + 5 + size, 4 };
+        if (tail.u32() != checksum(data.data() + offset, 5 + size)) {
+            break;
+        }
+
+        if (visit) {
+            RecordReader payload{ data.data() + offset + 5, size };
+            visit(JournalRecordType(data[offset]), payload);
+        }
+
+        offset += 9 + size;
+    }
+
+    return offset;
+}
+
+static void sync_file(FILE* file) {
+#if defined(WIN32)
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
+
+/// <summary>
+/// Tries to take an exclusive lock on a journal, held until the file is closed. Never waits.
+/// On Windows, a single byte far behind the data is locked, so that reading the journal is not blocked.
+/// </summary>
+/// <returns>Whether the lock was taken, false if another instance holds it.</returns>
+static bool lock_file(FILE* file) {
+#if defined(WIN32)
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = 0xFFFFFFFF;
+    overlapped.OffsetHigh = 0x7FFFFFFF;
+    HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)));
+    return LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped) != 0;
+#else
+    return flock(fileno(file), LOCK_EX | LOCK_NB) == 0;
+#endif
+}
+
+/// <summary>
+/// Empties a journal through the handle holding its lock, so that nobody takes it over once the lock is released.
+/// </summary>
+static void truncate_file(FILE* file) {
+#if defined(WIN32)
+    _chsize_s(_fileno(file), 0);
+#else
+    if (ftruncate(fileno(file), 0) != 0) {
+        open3d::utility::LogWarning("Could not empty the journal before closing it.");
+    }
+#endif
+}
+
+static int process_id() {
+#if defined(WIN32)
+    return _getpid();
+#else
+    return int(getpid());
+#endif
+}
+
+/// <summary>
+/// Checks whether the records of a journal contain anything to recover.
+/// </summary>
+/// <param name="data">The contents of the journal.</param>
+/// <param name="valid">Set to the offset after the last complete record.</param>
+static bool find_recoverable(const std::vector<uint8_t>& data, size_t& valid) {
+    bool recoverable = false;
+    valid = 0;
+
+    if (has_header(data)) {
+        valid = scan_records(data, [&recoverable](JournalRecordType type, RecordReader&) {
+            // Sessions that never loaded anything have nothing to recover.
+            recoverable = recoverable || type == JOURNAL_LOAD || type == JOURNAL_ALIAS;
+        });
+    }
+
+    return recoverable;
+}
+
+/// <summary>
+/// Checks whether a journal was left behind by an instance that crashed: nobody holds its lock and it has something to recover.
+/// Journals that were just created and are not locked yet hold nothing to recover, so they are left alone as well.
+/// </summary>
+static bool is_abandoned(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    size_t valid;
+    bool abandoned = lock_file(file) && find_recoverable(read_file(path, UINT64_MAX), valid);
+    std::fclose(file);
+    return abandoned;
+}
+
+std::string claim_journal(const std::string& directory) {
+    std::filesystem::path own = std::filesystem::path(directory) / (JOURNAL_PREFIX + ("_" + std::to_string(process_id())) + ".bin");
+
+    // A journal under the own name was left by a crashed instance that had the same process id.
+    std::error_code error;
+    if (std::filesystem::exists(own, error)) {
+        return own.string();
+    }
+
+    std::filesystem::directory_iterator it(directory, error);
+    for (; !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+        const std::filesystem::path& candidate = it->path();
+        std::string name = candidate.filename().string();
+
+        if (name.rfind(JOURNAL_PREFIX, 0) != 0 || candidate.extension() != ".bin" || !is_abandoned(candidate.string())) {
+            continue;
+        }
+
+        // Renaming is atomic, if another instance takes over the same journal only one of them succeeds.
+        std::error_code rename_error;
+        std::filesystem::rename(candidate, own, rename_error);
+        if (!rename_error) {
+            break;
+        }
+    }
+
+    return own.string();
+}
+
+Journal::Journal(const std::string& path) :
+    path(path), file(nullptr), recovered_size(0), unsynced(false), sync_requested(false), stopping(false)
+{
+    this->open(true);
+    this->sync_thread = std::thread([this]() { this->run_sync(); });
+}
+
+Journal::~Journal() {
+    {
+        std::lock_guard<std::mutex> lock(this->sync_mutex);
+        this->stopping = true;
+    }
+    this->sync_condition.notify_one();
+    this->sync_thread.join();
+
+    if (this->file) {
+        this->close(true);
+        std::error_code error;
+        std::filesystem::remove(this->path, error);
+    }
+}
+
+void Journal::close(bool discard) {
+    std::lock_guard<std::mutex> lock(this->sync_mutex);
+
+    if (discard) {
+        truncate_file(this->file);
+    }
+
+    std::fclose(this->file);
+    this->file = nullptr;
+}
+
+void Journal::run_sync() {
+    set_trace_thread_name("journal");
+    std::unique_lock<std::mutex> lock(this->sync_mutex);
+
+    while (true) {
+        this->sync_condition.wait(lock, [this]() { return this->stopping || this->sync_requested; });
+
+        if (this->stopping) {
+            return;
+        }
+
+        this->sync_requested = false;
+        if (this->file) {
+            TraceSpan span("journal_sync");
+            sync_file(this->file);
+        }
+    }
+}
+
+void Journal::sync() {
+    auto now = std::chrono::steady_clock::now();
+    if (!this->file || !this->unsynced || now - this->last_sync < JOURNAL_SYNC_INTERVAL) {
+        return;
+    }
+
+    // The previous sync is still running, the records are picked up by the next call.
+    std::unique_lock<std::mutex> lock(this->sync_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+
+    this->sync_requested = true;
+    this->unsynced = false;
+    this->last_sync = now;
+    lock.unlock();
+    this->sync_condition.notify_one();
+}
+
+void Journal::open(bool keep_records) {
+    size_t valid = 0;
+    bool recoverable = keep_records && find_recoverable(read_file(this->path, UINT64_MAX), valid);
+
+    std::error_code error;
+    if (recoverable) {
+        // A record torn by a crash would hide every record appended after it.
+        std::filesystem::resize_file(this->path, valid, error);
+    }
+
+    bool append = recoverable && !error;
+    FILE* opened = std::fopen(this->path.c_str(), append ? "ab" : "wb");
+
+    if (!opened) {
+        open3d::utility::LogWarning("Could not open journal {}, changes are not recorded.", this->path);
+        return;
+    }
+
+    if (!lock_file(opened)) {
+        open3d::utility::LogWarning("Journal {} is used by another instance, changes are not recorded.", this->path);
+        std::fclose(opened);
+        return;
+    }
+
+    {
+        // The sync thread may still be running after `discard_recovered` closed the previous file.
+        std::lock_guard<std::mutex> lock(this->sync_mutex);
+        this->file = opened;
+    }
+
+    this->recovered_size = append ? valid : 0;
+
+    if (!append) {
+        std::vector<uint8_t> header(JOURNAL_MAGIC, JOURNAL_MAGIC + sizeof(JOURNAL_MAGIC));
+        put_u32(header, JOURNAL_VERSION);
+        std::fwrite(header.data(), 1, header.size(), this->file);
+    }
+
+    this->last_sync = std::chrono::steady_clock::time_point();
+    this->unsynced = false;
+    this->append(JOURNAL_SESSION, {});
+}
+
+bool Journal::is_open() const {
+    return this->file != nullptr;
+}
+
+const std::string& Journal::get_path() const {
+    return this->path;
+}
+
+uint64_t Journal::get_recovered_size() const {
+    return this->recovered_size;
+}
+
+void Journal::discard_recovered() {
+    if (this->file) {
+        this->close(true);
+    }
+
+    this->recovered_size = 0;
+    this->open(false);
+}
+
+void Journal::append(JournalRecordType type, const std::vector<uint8_t>& payload) {
+    if (!this->file) {
+        return;
+    }
+
+    std::vector<uint8_t> record;
+    record.reserve(payload.size() + 9);
+    record.push_back(uint8_t(type));
+    put_u32(record, uint32_t(payload.size()));
+    record.insert(record.end(), payload.begin(), payload.end());
+    put_u32(record, checksum(record.data(), record.size()));
+
+    // Written at once, so that a crash tears at most the last record.
+    if (std::fwrite(record.data(), 1, record.size(), this->file) != record.size() || std::fflush(this->file) != 0) {
+        open3d::utility::LogWarning("Could not write journal {}, changes are no longer recorded.", this->path);
+        this->close(false);
+        return;
+    }
+
+    this->unsynced = true;
+}
+
+void Journal::record_load(const Entry& entry, const std::string& path) {
+    std::vector<uint8_t> payload;
+    put_string(payload, entry.id);
+    put_string(payload, std::filesystem::absolute(path).string());
+    put_string(payload, entry.name);
+    this->append(JOURNAL_LOAD, payload);
+}
+
+void Journal::record_transform(const Entry& entry, const Eigen::Matrix4d& transformation) {
+    std::vector<uint8_t> payload;
+    put_string(payload, entry.id);
+    put_matrix(payload, transformation);
+    this->append(JOURNAL_TRANSFORM, payload);
+}
+
+void Journal::record_rename(const Entry& entry) {
+    std::vector<uint8_t> payload;
+    put_string(payload, entry.id);
+    put_string(payload, entry.name);
+    this->append(JOURNAL_RENAME, payload);
+}
+
+void Journal::record_remove(const Entry& entry) {
+    std::vector<uint8_t> payload;
+    put_string(payload, entry.id);
+    this->append(JOURNAL_REMOVE, payload);
+}
+
+void Journal::record_merge(const Entry& group, const std::vector<std::shared_ptr<Entry>>& inputs) {
+    std::vector<uint8_t> payload;
+    put_string(payload, group.id);
+    put_string(payload, group.name);
+    put_u32(payload, uint32_t(inputs.size()));
+    for (const auto& input : inputs) {
+        put_string(payload, input->id);
+    }
+    this->append(JOURNAL_MERGE, payload);
+}
+
+void Journal::record_flatten(const Entry& entry, const Entry& group) {
+    std::vector<uint8_t> payload;
+    put_string(payload, entry.id);
+    put_string(payload, group.id);
+    this->append(JOURNAL_FLATTEN, payload);
+}
+
+void Journal::record_state(const std::vector<std::shared_ptr<Entry>>& entries) {
+    std::vector<uint8_t> payload;
+    put_u32(payload, uint32_t(entries.size()));
+    for (const auto& entry : entries) {
+        put_string(payload, entry->id);
+        put_string(payload, entry->name);
+        put_matrix(payload, entry->get_transformation());
+    }
+    this->append(JOURNAL_STATE, payload);
+}
+
+void Journal::record_alias(const Entry& entry, uint32_t session, const std::string& id) {
+    std::vector<uint8_t> payload;
+    put_string(payload, entry.id);
+    put_u32(payload, session);
+    put_string(payload, id);
+    this->append(JOURNAL_ALIAS, payload);
+}
+
+/// <summary>
+/// State of a point cloud while a journal is read. Never modified once stored: changes create a new instance,
+/// so that merges and flattens keep the state their inputs had at that time.
+/// </summary>
+struct ReplayEntry {
+    /// <summary>
+    /// How the point cloud was created: `JOURNAL_LOAD`, `JOURNAL_MERGE` or `JOURNAL_FLATTEN`.
+    /// </summary>
+    JournalRecordType source;
+
+    /// <summary>
+    /// The file a loaded point cloud was read from.
+    /// </summary>
+    std::string path;
+
+    /// <summary>
+    /// The merged point clouds of a merge, or the group of a flatten.
+    /// </summary>
+    std::vector<std::shared_ptr<const ReplayEntry>> inputs;
+
+    Eigen::Matrix4d transformation = Eigen::Matrix4d::Identity();
+    std::string name;
+};
+
+/// <summary>
+/// Point clouds are identified by their session and their id within the session.
+/// </summary>
+static std::string replay_key(uint32_t session, const std::string& id) {
+    return std::to_string(session) + ":" + id;
+}
+
+static void collect_paths(const ReplayEntry& entry, std::unordered_set<std::string>& paths) {
+    if (entry.source == JOURNAL_LOAD) {
+        paths.insert(entry.path);
+    }
+
+    for (const auto& input : entry.inputs) {
+        collect_paths(*input, paths);
+    }
+}
+
+/// <summary>
+/// Applies the transformation that moves an entry from its current pose into the given one.
+/// </summary>
+static void move_to(Entry& entry, const Eigen::Matrix4d& transformation) {
+    if (entry.get_transformation() != transformation) {
+        entry.do_transform(transformation * entry.get_transformation().inverse());
+    }
+}
+
+/// <summary>
+/// Rebuilds a point cloud from the loaded files.
+/// </summary>
+/// <returns>The point cloud, or nullptr if a file it depends on could not be loaded.</returns>
+static std::shared_ptr<Entry> build_entry(
+    const ReplayEntry& model,
+    const std::unordered_map<std::string, std::shared_ptr<const Entry>>& loaded
+) {
+    std::shared_ptr<Entry> entry;
+
+    if (model.source == JOURNAL_LOAD) {
+        auto file = loaded.find(model.path);
+        if (file == loaded.end() || !file->second) {
+            return nullptr;
+        }
+
+        // A copy shares the points with every other point cloud read from the same file.
+        entry = std::make_shared<Entry>(*file->second);
+    }
+    else if (model.source == JOURNAL_MERGE) {
+        std::vector<std::shared_ptr<Entry>> inputs;
+        for (const auto& input : model.inputs) {
+            auto built = build_entry(*input, loaded);
+            if (!built) {
+                return nullptr;
+            }
+            inputs.push_back(built);
+        }
+
+        entry = group_entries(inputs);
+    }
+    else if (model.source == JOURNAL_FLATTEN && model.inputs.size() == 1) {
+        auto group = build_entry(*model.inputs[0], loaded);
+        if (!group) {
+            return nullptr;
+        }
+
+        entry = group->is_group() ? flatten_group(*group) : group;
+    }
+    else {
+        return nullptr;
+    }
+
+    entry->name = model.name;
+    move_to(*entry, model.transformation);
+    return entry;
+}
+
+std::optional<JournalReplay> replay_journal(const std::string& path, uint64_t size, std::function<bool(double)> update_progress) {
+    TraceSpan span("replay_journal");
+
+    std::vector<uint8_t> data = read_file(path, size);
+    if (!has_header(data)) {
+        return std::nullopt;
+    }
+
+    JournalReplay replay;
+
+    // Only the final state of every point cloud matters, so the records are reduced to it first.
+    std::unordered_map<std::string, std::shared_ptr<const ReplayEntry>> current;
+    std::vector<std::pair<uint32_t, std::string>> live;
+    uint32_t session = 0;
+    size_t session_count = 0;
+
+    auto find = [&current, &session](const std::string& id) -> std::shared_ptr<const ReplayEntry> {
+        auto it = current.find(replay_key(session, id));
+        return it != current.end() ? it->second : nullptr;
+    };
+
+    auto modify = [&current, &session](const std::string& id) -> ReplayEntry* {
+        auto it = current.find(replay_key(session, id));
+        if (it == current.end()) {
+            return nullptr;
+        }
+
+        auto copy = std::make_shared<ReplayEntry>(*it->second);
+        it->second = copy;
+        return copy.get();
+    };
+
+    scan_records(data, [&](JournalRecordType type, RecordReader& reader) {
+        replay.record_count++;
+
+        switch (type) {
+        case JOURNAL_SESSION: {
+            // Every session starts without any point clouds loaded.
+            if (session_count++ > 0) {
+                session++;
+            }
+            live.clear();
+            break;
+        }
+        case JOURNAL_LOAD: {
+            std::string id = reader.string();
+            auto entry = std::make_shared<ReplayEntry>();
+            entry->source = JOURNAL_LOAD;
+            entry->path = reader.string();
+            entry->name = reader.string();
+
+            if (!reader.failed) {
+                current[replay_key(session, id)] = entry;
+                live.emplace_back(session, id);
+            }
+            break;
+        }
+        case JOURNAL_TRANSFORM: {
+            std::string id = reader.string();
+            Eigen::Matrix4d transformation = reader.matrix();
+
+            ReplayEntry* entry = reader.failed ? nullptr : modify(id);
+            if (entry) {
+                entry->transformation = transformation * entry->transformation;
+            }
+            break;
+        }
+        case JOURNAL_RENAME: {
+            std::string id = reader.string();
+            std::string name = reader.string();
+
+            ReplayEntry* entry = reader.failed ? nullptr : modify(id);
+            if (entry) {
+                entry->name = name;
+            }
+            break;
+        }
+        case JOURNAL_REMOVE: {
+            std::string id = reader.string();
+            live.erase(std::remove(live.begin(), live.end(), std::make_pair(session, id)), live.end());
+            break;
+        }
+        case JOURNAL_MERGE: {
+            std::string id = reader.string();
+            auto entry = std::make_shared<ReplayEntry>();
+            entry->source = JOURNAL_MERGE;
+            entry->name = reader.string();
+
+            uint32_t count = reader.u32();
+            for (uint32_t i = 0; i < count && !reader.failed; i++) {
+                auto input = find(reader.string());
+                if (input) {
+                    entry->inputs.push_back(input);
+                }
+            }
+
+            if (!reader.failed && entry->inputs.size() == count) {
+                current[replay_key(session, id)] = entry;
+                live.emplace_back(session, id);
+            }
+            break;
+        }
+        case JOURNAL_FLATTEN: {
+            std::string id = reader.string();
+            std::string group_id = reader.string();
+            auto group = reader.failed ? nullptr : find(group_id);
+            if (!group) {
+                break;
+            }
+
+            // The flattened point cloud keeps the pose and name of the group, see `flatten_group`.
+            auto entry = std::make_shared<ReplayEntry>();
+            entry->source = JOURNAL_FLATTEN;
+            entry->inputs.push_back(group);
+            entry->transformation = group->transformation;
+            entry->name = group->name;
+            current[replay_key(session, id)] = entry;
+            std::replace(live.begin(), live.end(), std::make_pair(session, group_id), std::make_pair(session, id));
+            break;
+        }
+        case JOURNAL_STATE: {
+            std::vector<std::pair<uint32_t, std::string>> state;
+            uint32_t count = reader.u32();
+
+            for (uint32_t i = 0; i < count && !reader.failed; i++) {
+                std::string id = reader.string();
+                std::string name = reader.string();
+                Eigen::Matrix4d transformation = reader.matrix();
+
+                ReplayEntry* entry = reader.failed ? nullptr : modify(id);
+                if (entry) {
+                    entry->name = name;
+                    entry->transformation = transformation;
+                    state.emplace_back(session, id);
+                }
+            }
+
+            if (!reader.failed) {
+                live = state;
+            }
+            break;
+        }
+        case JOURNAL_ALIAS: {
+            std::string id = reader.string();
+            uint32_t old_session = reader.u32();
+            std::string old_id = reader.string();
+
+            auto it = current.find(replay_key(old_session, old_id));
+            if (!reader.failed && it != current.end()) {
+                current[replay_key(session, id)] = it->second;
+                live.emplace_back(session, id);
+            }
+            break;
+        }
+        default:
+            // Unknown records come from a newer version and are skipped.
+            break;
+        }
+    });
+
+    std::mutex progress_mutex;
+    auto report = [&update_progress, &progress_mutex](double progress) {
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        return !update_progress || update_progress(progress);
+    };
+
+    if (!report(0.05)) {
+        return std::nullopt;
+    }
+
+    // Every file is loaded once, even if several point clouds were read from it.
+    std::unordered_set<std::string> path_set;
+    for (const auto& key : live) {
+        collect_paths(*current.at(replay_key(key.first, key.second)), path_set);
+    }
+    std::vector<std::string> paths(path_set.begin(), path_set.end());
+
+    std::vector<std::shared_ptr<const Entry>> files(paths.size());
+    std::atomic<size_t> files_done(0);
+    std::atomic<bool> cancelled(false);
+
+    for_each_parallel(paths.size(), [&](size_t i) {
+        if (cancelled) {
+            return;
+        }
+
+        try {
+            files[i] = std::make_shared<const Entry>(paths[i], [&cancelled](double) { return !cancelled; });
+        }
+        catch (...) {
+            open3d::utility::LogWarning("Could not load {} while replaying the journal.", paths[i]);
+        }
+
+        if (!report(0.05 + 0.75 * double(++files_done) / double(paths.size()))) {
+            cancelled = true;
+        }
+    });
+
+    if (cancelled) {
+        return std::nullopt;
+    }
+
+    std::unordered_map<std::string, std::shared_ptr<const Entry>> loaded;
+    for (size_t i = 0; i < paths.size(); i++) {
+        loaded[paths[i]] = files[i];
+    }
+
+    // Point clouds only share their files, so each one is rebuilt and transformed independently.
+    std::vector<std::shared_ptr<Entry>> built(live.size());
+    std::atomic<size_t> built_done(0);
+
+    for_each_parallel(live.size(), [&](size_t i) {
+        if (!cancelled) {
+            built[i] = build_entry(*current.at(replay_key(live[i].first, live[i].second)), loaded);
+        }
+
+        if (!report(0.8 + 0.2 * double(++built_done) / double(live.size()))) {
+            cancelled = true;
+        }
+    });
+
+    if (cancelled) {
+        return std::nullopt;
+    }
+
+    std::unordered_set<std::string> ids;
+
+    for (size_t i = 0; i < live.size(); i++) {
+        const ReplayEntry& model = *current.at(replay_key(live[i].first, live[i].second));
+        std::shared_ptr<Entry> entry = built[i];
+
+        if (!entry) {
+            replay.missing.push_back(model.name);
+            continue;
+        }
+
+        // Point clouds read from the same file share their id, but have to be drawn separately.
+        if (!ids.insert(entry->id).second) {
+            entry = std::make_shared<Entry>(entry->get_base());
+            entry->name = model.name;
+            move_to(*entry, model.transformation);
+            ids.insert(entry->id);
+        }
+
+        replay.entries.push_back(RecoveredEntry{ entry, live[i].first, live[i].second });
+    }
+
+    return replay;
+}
@@ -3,8 +3,22 @@
 
 #include "open3d/Open3D.h"
 #include "main_window.h"
+#include "tracing.h"
 
 int main(int argc, const char** argv) {
+    // "--trace <file>" records a trace of the whole session and writes it on exit.
+    std::string trace_path;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--trace") {
+            trace_path = argv[i + 1];
+        }
+    }
+
+    set_trace_thread_name("main");
+    if (!trace_path.empty()) {
+        set_tracing_enabled(true);
+    }
+
     auto& app = open3d::visualization::gui::Application::GetInstance();
     app.Initialize(argc, argv);
 
@@ -14,5 +28,9 @@ int main(int argc, const char** argv) {
     gui.reset();
     app.Run();
 
+    if (!trace_path.empty() && !write_trace(trace_path)) {
+        open3d::utility::LogWarning("Could not write trace to {}", trace_path);
+    }
+
     return 0;
 }
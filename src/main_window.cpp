@@ -95,13 +95,35 @@ std::shared_ptr<gui::Dialog> CreateInstructionManualDialog(gui::Window* window)
         "Lade eine Punktewolke entweder durch das \"Datei\"-Men\xC3\xBC oder durch Drag and Drop der Datei in das Fenster.\n\n"
         "Das Textfeld ändert den Namen der Wolke. Dieser Name wird auch bei der Ausgabe der Matrizen verwendet\n\n"
         "Die Slider ändern Position und Ausrichtung der Wolke. Die Wolke wird dabei entweder um die gegebene Achse rotiert oder entlang der Achse bewegt.\n\n"
+        "Unter \"Auswahl...\" lassen sich weitere Wolken ausw\xC3\xA4hlen, etwa mehrere bereits zueinander ausgerichtete Aufnahmen. "
+        "Slider und \"Matrix Einlesen\" bewegen dann alle ausgew\xC3\xA4hlten Wolken gemeinsam mit der gew\xC3\xA4hlten Wolke.\n\n"
         "\"Algorithmisches Ann\xC3\xA4hern\" verwendet den Iterative Closest Point-Algorithmus, um die gew\xC3\xA4""hlte Wolke gegenüber der einer anderen auszurichten.\n"
-        "Das Ergebnis ist im Idealfall eine perfekte \xC3\x9C""berschneidung. Dieser Algorithmus is rechenintensiv und wird einige Sekunden in Anspruch nehmen.\n\n"
+        "Das Ergebnis ist im Idealfall eine perfekte \xC3\x9C""berschneidung. Dieser Algorithmus is rechenintensiv und wird einige Sekunden in Anspruch nehmen.\n"
+        "Bei Aufnahmen mit vielen ebenen Fl\xC3\xA4""chen ben\xC3\xB6tigen \"Punkt-zu-Ebene\" und \"Generalisiertes ICP\" deutlich weniger Iterationen.\n\n"
         "\"Verschmelzen\" nimmt die Ausgew\xC3\xA4hlte Punktewolke und eine andere und erzeugt eine dritte, große Puntkewolke.\n"
-        "Die verwendeten Namen und die angewandten Transformationen der alten Wolken werden in der neuen Wolke gespeichert.\n\n"
+        "Die verwendeten Namen und die angewandten Transformationen der alten Wolken werden in der neuen Wolke gespeichert.\n"
+        "Die neue Wolke ist eine Gruppe, die die Punkte der alten Wolken nicht kopiert. Metriken werden f\xC3\xBCr alle Punkte der Gruppe berechnet. Eingef\xC3\xA4rbte Abweichung, Differenz, Einrasten und Punktpaare stehen f\xC3\xBCr Gruppen erst zur Verf\xC3\xBCgung, "
+        "nachdem sie unter \"Bearbeiten > Gruppe zusammenfassen\" zu einer Punktewolke zusammengefasst wurden.\n\n"
+        "Unter \"Qualit\xC3\xA4t\" wird die gew\xC3\xA4hlte Wolke mit einer Referenzwolke verglichen. "
+        "Ist \"Beim Verschieben einrasten\" aktiv, wird die Wolke w\xC3\xA4hrend des Verschiebens an der Referenz ausgerichtet.\n\n"
+        "Unter \"Punktpaare\" k\xC3\xB6nnen bei aktivem \"Punkte w\xC3\xA4hlen\" abwechselnd Punkte auf der gew\xC3\xA4hlten Wolke und der Referenz angeklickt werden. "
+        "Ab drei Paaren richtet \"Ausrichten\" die Wolke so aus, dass die Paare m\xC3\xB6glichst gut \xC3\xBC""bereinanderliegen.\n\n"
         "\"Matrix Eingeben\" erlaubt die manuelle Definition einer Transformation. Wie die Punktewolke durch die Transformation beeinflusst wird, wird nicht \xC3\xBC""berpr\xC3\xBC""ft.\n"
         "Zur Hilfestellung wird die Determinante der Transformationsmatrix ausgegeben.\n\n"
-        "\"Matrix Ausgeben\" gibt die aktuallen Transformationsmatrizen aus und erlaubt es, diese in einer Datei zu Speichern.\n");
+        "\"Matrix Ausgeben\" gibt die aktuallen Transformationsmatrizen aus und erlaubt es, diese in einer Datei zu Speichern.\n\n"
+        "\"Ansicht > Differenz zur Referenz\" f\xC3\xA4rbt die gew\xC3\xA4hlte Wolke nach dem Abstand jedes Punktes zur Referenz ein. "
+        "Die Einf\xC3\xA4rbung wird nach jeder Bewegung einer der beiden Wolken im Hintergrund aktualisiert.\n\n"
+        "Ist \"Ansicht > Punktbudget\" aktiv, werden bei sehr vielen Punkten nur so viele gezeichnet, wie fl\xC3\xBCssig dargestellt werden k\xC3\xB6nnen. "
+        "Sobald die Kamera ruht, werden die Wolken schrittweise verfeinert.\n\n"
+        "Ist \"Ansicht > Inaktive Wolken komprimieren\" aktiv, werden Wolken, die weder ausgew\xC3\xA4hlt noch Referenz sind, im Hintergrund platzsparend gespeichert. "
+        "Sie werden weiterhin gezeichnet und beim Ausw\xC3\xA4hlen oder Ann\xC3\xA4hern wieder entpackt. Ihre Punkte weichen dabei geringf\xC3\xBCgig vom Original ab.\n\n"
+        "\"Bearbeiten > R\xC3\xBC""ckg\xC3\xA4ngig\" und \"Bearbeiten > Wiederholen\" gelten f\xC3\xBCr alle Wolken gemeinsam: "
+        "Laden, Verschieben, Ann\xC3\xA4hern, Verschmelzen, Zusammenfassen, Entfernen und Umbenennen werden in der Reihenfolge ihrer Ausf\xC3\xBChrung zur\xC3\xBC""ckgenommen.\n"
+        "Alle \xC3\x84nderungen werden laufend mitgeschrieben. Nach einem Absturz bietet der n\xC3\xA4""chste Start an, die Wolken samt ihrer Lage wiederherzustellen.\n\n"
+        "Laden, Ann\xC3\xA4hern, Zusammenfassen und Exportieren laufen im Hintergrund. Ihr Fortschritt wird unten rechts angezeigt, wo sie auch abgebrochen werden k\xC3\xB6nnen.\n\n"
+        "\"Hilfe > Leistung anzeigen\" zeigt die Dauer h\xC3\xA4ufiger Arbeitsschritte sowie Punktanzahl und Speicherbedarf jeder Wolke an. "
+        "\"Hilfe > Ablauf aufzeichnen\" zeichnet alle Arbeitsschritte auf, \"Hilfe > Ablauf speichern...\" schreibt sie in eine Datei, die sich mit Perfetto \xC3\xB6""ffnen l\xC3\xA4sst. "
+        "Alternativ zeichnet der Programmstart mit \"--trace <Datei>\" von Beginn an auf und schreibt die Datei beim Beenden.\n");
     auto ok = std::make_shared<gui::Button>("OK");
     ok->SetOnClicked([window]() { window->CloseDialog(); });
 
@@ -146,6 +168,7 @@ MainWindow::MainWindow(const std::string& title, int width, int height)
     : gui::Window(title, width, height)
 {
     gui_state = std::make_unique<GuiState>((MainWindow*)this);
+    SetOnTickEvent([this]() { return this->gui_state->on_tick(); });
 }
 
 MainWindow::~MainWindow() {}
@@ -165,6 +188,13 @@ void MainWindow::Layout(const gui::LayoutContext& context) {
     gui_state->help_keys->SetFrame(gui::Rect(r.width - pref.width, r.y, pref.width, pref.height));
     gui_state->help_keys->Layout(context);
 
+    // Draw performance HUD in upper right, below the help keys
+    const auto prefperf = gui_state->help_performance->CalcPreferredSize(
+        context, gui::Widget::Constraints());
+    const int perf_y = gui_state->help_keys->IsVisible() ? r.y + pref.height : r.y;
+    gui_state->help_performance->SetFrame(gui::Rect(r.width - prefperf.width, perf_y, prefperf.width, prefperf.height));
+    gui_state->help_performance->Layout(context);
+
     // Draw camera HUD in lower left
     const auto prefcam = gui_state->help_camera->CalcPreferredSize(
         context, gui::Widget::Constraints());
@@ -180,34 +210,18 @@ void MainWindow::Layout(const gui::LayoutContext& context) {
     gui_state->manipulator->SetFrame(gui::Rect(0, r.y, MIN_WIDTH, prefpi.height));
     gui_state->manipulator->Layout(context);
 
+    // Draw background jobs in the lower right
+    const auto prefjobs = gui_state->job_panel->CalcPreferredSize(
+        context, gui::Widget::Constraints());
+    gui_state->job_panel->SetFrame(gui::Rect(r.width - prefjobs.width, r.height + r.y - prefjobs.height,
+        prefjobs.width, prefjobs.height));
+    gui_state->job_panel->Layout(context);
+
     Super::Layout(context);
 }
 
 void MainWindow::LoadCloud(const std::string& path) {
-    auto progressbar = std::make_shared<gui::ProgressBar>();
-    gui::Application::GetInstance().PostToMainThread(this, [this, path,
-        progressbar]() {
-            const char* laoding = "L\xC3\xA4""dt"; // Lädt
-            auto& theme = GetTheme();
-            auto loading_dlg = std::make_shared<gui::Dialog>(laoding);
-            auto vert =
-                std::make_shared<gui::Vert>(0, gui::Margins(theme.font_size));
-            auto loading_text = std::string(laoding) + " " + path;
-            vert->AddChild(std::make_shared<gui::Label>(loading_text.c_str()));
-            vert->AddFixed(theme.font_size);
-            vert->AddChild(progressbar);
-            loading_dlg->AddChild(vert);
-            ShowDialog(loading_dlg);
-        });
-
-    gui::Application::GetInstance().RunInThread([this, path, progressbar]() {
-        auto UpdateProgress = [this, progressbar](float value) {
-            gui::Application::GetInstance().PostToMainThread(
-                this,
-                [progressbar, value]() { progressbar->SetValue(value); });
-        };
-        this->gui_state->add_entry(path, UpdateProgress, this);
-    });
+    this->gui_state->load_entry(path);
 }
 
 void MainWindow::ExportCurrentImage(const std::string& path) {
@@ -255,6 +269,19 @@ void MainWindow::OnMenuItemSelected(gui::Menu::ItemId item_id) {
         ShowDialog(dlg);
         break;
     }
+    case FILE_EXPORT_CLOUD: {
+        auto dlg = std::make_shared<gui::FileDialog>(
+            gui::FileDialog::Mode::SAVE, "Punktewolke exportieren", GetTheme());
+        dlg->AddFilter(".ply", "Punktewolke-Dateien (.ply)");
+        dlg->AddFilter("", "Alle Dateien");
+        dlg->SetOnCancel([this]() { this->CloseDialog(); });
+        dlg->SetOnDone([this](const char* path) {
+            this->CloseDialog();
+            this->gui_state->export_current_entry(path);
+            });
+        ShowDialog(dlg);
+        break;
+    }
     case FILE_QUIT:
         gui::Application::GetInstance().Quit();
         break;
@@ -295,6 +322,41 @@ void MainWindow::OnMenuItemSelected(gui::Menu::ItemId item_id) {
         }
         break;
     }
+    case HELP_PERFORMANCE: {
+        bool is_visible = !gui_state->help_performance->IsVisible();
+        gui_state->help_performance->SetVisible(is_visible);
+        set_profiling_enabled(is_visible);
+        auto menubar = gui::Application::GetInstance().GetMenubar();
+        menubar->SetChecked(HELP_PERFORMANCE, is_visible);
+        if (is_visible) {
+            gui_state->update_performance();
+        }
+        this->SetNeedsLayout();
+        break;
+    }
+    case HELP_TRACE_RECORD: {
+        bool enabled = !is_tracing_enabled();
+        set_tracing_enabled(enabled);
+        auto menubar = gui::Application::GetInstance().GetMenubar();
+        menubar->SetChecked(HELP_TRACE_RECORD, enabled);
+        break;
+    }
+    case HELP_TRACE_SAVE: {
+        auto dlg = std::make_shared<gui::FileDialog>(
+            gui::FileDialog::Mode::SAVE, "Ablauf speichern", GetTheme());
+        dlg->AddFilter(".json", "Chrome-Trace-Dateien (.json)");
+        dlg->AddFilter("", "Alle Dateien");
+        dlg->SetOnCancel([this]() { this->CloseDialog(); });
+        dlg->SetOnDone([this](const char* path) {
+            this->CloseDialog();
+            if (!write_trace(path)) {
+                auto msg = std::string("Ablauf konnte nicht nach ") + path + " geschrieben werden";
+                this->ShowMessageBox("Fehler", msg.c_str());
+            }
+            });
+        ShowDialog(dlg);
+        break;
+    }
     case HELP_ABOUT: {
         auto dlg = CreateAboutDialog(this);
         ShowDialog(dlg);
@@ -310,14 +372,51 @@ void MainWindow::OnMenuItemSelected(gui::Menu::ItemId item_id) {
         ShowDialog(dlg);
         break;
     }
-    case UNDO_TRANSFORMATION: {
-        if (this->gui_state->loaded_entries.size() > 0) {
-            this->gui_state->loaded_entries.at(this->gui_state->entry_index)->undo_transform();
-            this->gui_state->current_entry->undo_transform();
-            this->gui_state->set_scene(true, true);
+    case VIEW_POINT_BUDGET: {
+        bool enabled = !gui_state->point_budget_enabled;
+        gui_state->point_budget_enabled = enabled;
+        auto menubar = gui::Application::GetInstance().GetMenubar();
+        menubar->SetChecked(VIEW_POINT_BUDGET, enabled);
+        gui_state->set_scene(false, true);
+        break;
+    }
+    case VIEW_COMPRESSION: {
+        bool enabled = !gui_state->compression_enabled;
+        gui_state->compression_enabled = enabled;
+        auto menubar = gui::Application::GetInstance().GetMenubar();
+        menubar->SetChecked(VIEW_COMPRESSION, enabled);
+        gui_state->update_compression();
+        gui_state->set_scene(false, true);
+        break;
+    }
+    case VIEW_DIFFERENCE: {
+        bool enabled = !gui_state->difference_enabled;
+        gui_state->difference_enabled = enabled;
+        auto menubar = gui::Application::GetInstance().GetMenubar();
+        menubar->SetChecked(VIEW_DIFFERENCE, enabled);
+        gui_state->set_scene(false, true);
+
+        if (enabled && !gui_state->reference_entry) {
+            this->ShowMessageBox("", "Die Differenz wird angezeigt, sobald unter \"Qualit\xC3\xA4t\" eine Referenz gew\xC3\xA4hlt ist.");
+        }
+        else if (enabled && (gui_state->reference_entry->is_group() || gui_state->current_entry->is_group())) {
+            this->ShowMessageBox("", "F\xC3\xBCr Gruppen wird keine Differenz angezeigt. "
+                "Sie lassen sich unter \"Bearbeiten > Gruppe zusammenfassen\" zu einer Punktewolke zusammenfassen.");
         }
         break;
     }
+    case UNDO_TRANSFORMATION: {
+        this->gui_state->undo();
+        break;
+    }
+    case REDO_TRANSFORMATION: {
+        this->gui_state->redo();
+        break;
+    }
+    case FLATTEN_GROUP: {
+        this->gui_state->flatten_current_entry();
+        break;
+    }
     }
 }
 
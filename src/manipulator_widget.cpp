@@ -26,6 +26,11 @@ ManipulatorEvent::ManipulatorEvent(Manipulator* manipulator) {
     z_rotation = manipulator->z_rotation->GetDoubleValue();
 
     name = std::string(manipulator->name_edit->GetText());
+
+    reference_index = manipulator->reference->GetSelectedIndex();
+    show_residuals = manipulator->show_residuals->IsChecked();
+    snap = manipulator->snap->IsChecked();
+    picking = manipulator->picking->IsChecked();
 }
 
 
@@ -53,6 +58,14 @@ Manipulator::Manipulator(int spacing, const gui::Margins& margins) : gui::Vert(s
 
     // Remove Button
 
+    // Selection
+
+    select = std::make_shared<gui::Button>("Auswahl...");
+    selection = std::make_shared<gui::Label>("Auswahl: 1 Punktewolke");
+
+    auto entry_buttons = std::make_shared<gui::Horiz>(grid_spacing);
+    entry_buttons->AddChild(remove);
+    entry_buttons->AddChild(select);
 
     // Sliders
 
@@ -139,6 +152,46 @@ Manipulator::Manipulator(int spacing, const gui::Margins& margins) : gui::Vert(s
     matrix_buttons->AddChild(read_matrix);
     matrix_buttons->AddChild(show_matrix);
 
+    // Registration Quality
+
+    reference = std::make_shared<gui::Combobox>();
+    show_residuals = std::make_shared<gui::Checkbox>("Abweichung einf\xC3\xA4rben"); // "Abweichung einfärben"
+    snap = std::make_shared<gui::Checkbox>("Beim Verschieben einrasten");
+    metrics = std::make_shared<gui::Label>("-");
+
+    auto reference_row = std::make_shared<gui::Horiz>(grid_spacing);
+    reference_row->AddChild(std::make_shared<gui::Label>("Referenz"));
+    reference_row->AddChild(reference);
+
+    auto quality_vert = std::make_shared<gui::CollapsableVert>("Qualit\xC3\xA4t", 0, indent); // "Qualität"
+    quality_vert->SetIsOpen(true);
+    quality_vert->AddChild(reference_row);
+    quality_vert->AddFixed(grid_spacing);
+    quality_vert->AddChild(show_residuals);
+    quality_vert->AddFixed(grid_spacing);
+    quality_vert->AddChild(snap);
+    quality_vert->AddFixed(grid_spacing);
+    quality_vert->AddChild(metrics);
+
+    // Point Pairs
+
+    picking = std::make_shared<gui::Checkbox>("Punkte w\xC3\xA4hlen"); // "Punkte wählen"
+    pairs = std::make_shared<gui::Label>("0 Paare");
+    align_pairs = std::make_shared<gui::Button>("Ausrichten");
+    clear_pairs = std::make_shared<gui::Button>("Zur\xC3\xBC" "cksetzen"); // "Zurücksetzen"
+
+    auto pair_buttons = std::make_shared<gui::Horiz>(grid_spacing);
+    pair_buttons->AddChild(align_pairs);
+    pair_buttons->AddChild(clear_pairs);
+
+    auto pairs_vert = std::make_shared<gui::CollapsableVert>("Punktpaare", 0, indent);
+    pairs_vert->SetIsOpen(false);
+    pairs_vert->AddChild(picking);
+    pairs_vert->AddFixed(grid_spacing);
+    pairs_vert->AddChild(pairs);
+    pairs_vert->AddFixed(grid_spacing);
+    pairs_vert->AddChild(pair_buttons);
+
     // Construct Widget
 
     AddFixed(separation_height);
@@ -146,7 +199,9 @@ Manipulator::Manipulator(int spacing, const gui::Margins& margins) : gui::Vert(s
     AddFixed(separation_height);
     AddChild(name);
     AddFixed(separation_height);
-    AddChild(remove);
+    AddChild(entry_buttons);
+    AddFixed(grid_spacing);
+    AddChild(selection);
     AddFixed(separation_height);
     AddChild(translation_vert);
     AddChild(rotation_vert);
@@ -154,10 +209,15 @@ Manipulator::Manipulator(int spacing, const gui::Margins& margins) : gui::Vert(s
     AddChild(misc_buttons);
     AddFixed(separation_height);
     AddChild(matrix_buttons);
+    AddFixed(separation_height);
+    AddChild(quality_vert);
+    AddFixed(separation_height);
+    AddChild(pairs_vert);
 
     // Handle Events
 
     remove->SetOnClicked(make_button_handler(ManipulatorEventType::REMOVE_CLICKED));
+    select->SetOnClicked(make_button_handler(ManipulatorEventType::SELECTION_CLICKED));
 
     name_edit->SetOnValueChanged([this](const char* text) {
         if (this->entries->GetNumberOfItems() == 0) return;
@@ -180,6 +240,41 @@ Manipulator::Manipulator(int spacing, const gui::Margins& margins) : gui::Vert(s
         this->handler(event_);
         });
 
+    reference->SetOnValueChanged([this](const char* str, int i) {
+        if (this->entries->GetNumberOfItems() == 0) return;
+        ManipulatorEvent event_(this);
+        event_.reference_index = i;
+        event_.type = ManipulatorEventType::REFERENCE_CHANGED;
+        this->handler(event_);
+        });
+
+    show_residuals->SetOnChecked([this](bool checked) {
+        if (this->entries->GetNumberOfItems() == 0) return;
+        ManipulatorEvent event_(this);
+        event_.show_residuals = checked;
+        event_.type = ManipulatorEventType::RESIDUALS_TOGGLED;
+        this->handler(event_);
+        });
+
+    snap->SetOnChecked([this](bool checked) {
+        if (this->entries->GetNumberOfItems() == 0) return;
+        ManipulatorEvent event_(this);
+        event_.snap = checked;
+        event_.type = ManipulatorEventType::SNAP_TOGGLED;
+        this->handler(event_);
+        });
+
+    picking->SetOnChecked([this](bool checked) {
+        if (this->entries->GetNumberOfItems() == 0) return;
+        ManipulatorEvent event_(this);
+        event_.picking = checked;
+        event_.type = ManipulatorEventType::PICKING_TOGGLED;
+        this->handler(event_);
+        });
+
+    align_pairs->SetOnClicked(make_button_handler(ManipulatorEventType::ALIGN_PAIRS_CLICKED));
+    clear_pairs->SetOnClicked(make_button_handler(ManipulatorEventType::CLEAR_PAIRS_CLICKED));
+
     auto value_change_handler = ([this](double _d) {
         if (this->entries->GetNumberOfItems() == 0) return;
         ManipulatorEvent event_(this);
@@ -228,6 +323,22 @@ void Manipulator::ResetSliders() {
     z_rotation->SetValue(0.0);
 }
 
+void Manipulator::SetMetrics(const char* text) {
+    this->metrics->SetText(text);
+}
+
+void Manipulator::SetPairs(const char* text) {
+    this->pairs->SetText(text);
+}
+
+void Manipulator::SetPicking(bool picking) {
+    this->picking->SetChecked(picking);
+}
+
+void Manipulator::SetSelection(const char* text) {
+    this->selection->SetText(text);
+}
+
 std::function<void(void)> Manipulator::make_button_handler(ManipulatorEventType type) {
     auto button_handler = ([this, type]() {
         if (this->entries->GetNumberOfItems() == 0) return;
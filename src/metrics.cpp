@@ -0,0 +1,172 @@
+#include <metrics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/// Points are searched for target points up to this multiple of the maximum distance.
+static const double DIFFERENCE_SEARCH_FACTOR = 2.0;
+
+/// Progress is reported after every block of this many points.
+static const size_t DIFFERENCE_BLOCK_SIZE = 1 << 20;
+
+std::vector<double> compute_distances(Entry& source, Entry& target, size_t stride) {
+    return compute_distances(source, target, target.get_index(), stride);
+}
+
+std::vector<double> compute_distances(const Entry& source, const Entry& target, const open3d::geometry::KDTreeFlann& index, size_t stride) {
+    const auto& points = source.get_transformed().points_;
+
+    // Distances are invariant under rigid transformations, so queries can
+    // happen in the coordinate system of the target's original data.
+    Eigen::Matrix4d to_target_base = target.get_transformation().inverse();
+
+    stride = std::max<size_t>(1, stride);
+    size_t count = points.empty() ? 0 : (points.size() - 1) / stride + 1;
+
+    std::vector<double> distances(count, 0.0);
+
+    parallel_for(count, [&](size_t start, size_t end) {
+        std::vector<int> indices;
+        std::vector<double> distance2;
+
+        for (size_t i = start; i < end; i++) {
+            Eigen::Vector4d p;
+            p << points[i * stride], 1;
+            Eigen::Vector3d q = (to_target_base * p).head<3>();
+
+            if (index.SearchKNN(q, 1, indices, distance2) == 1) {
+                distances[i] = std::sqrt(distance2[0]);
+            }
+            else {
+                distances[i] = std::numeric_limits<double>::infinity();
+            }
+        }
+    }, 256);
+
+    return distances;
+}
+
+RegistrationMetrics compute_metrics(const std::vector<double>& distances, double max_distance) {
+    RegistrationMetrics metrics = {};
+    metrics.point_count = distances.size();
+    metrics.max_distance = max_distance;
+
+    if (distances.empty()) {
+        return metrics;
+    }
+
+    size_t inliers = 0;
+    double squared_sum = 0.0;
+
+    for (double d : distances) {
+        if (d <= max_distance) {
+            inliers++;
+            squared_sum += d * d;
+        }
+    }
+
+    metrics.fitness = double(inliers) / double(distances.size());
+    metrics.rmse = inliers > 0 ? std::sqrt(squared_sum / double(inliers)) : 0.0;
+
+    // Each selection only has to look at the values above the previous percentile.
+    std::vector<double> sorted(distances);
+    auto begin = sorted.begin();
+    auto percentile = [&sorted, &begin](double q) {
+        auto position = sorted.begin() + size_t(q * double(sorted.size() - 1));
+        std::nth_element(begin, position, sorted.end());
+        begin = position;
+        return *position;
+    };
+
+    metrics.p50 = percentile(0.50);
+    metrics.p90 = percentile(0.90);
+    metrics.p95 = percentile(0.95);
+    metrics.p99 = percentile(0.99);
+
+    return metrics;
+}
+
+Eigen::Vector3d residual_color(double distance, double max_distance) {
+    if (!(distance <= max_distance) || max_distance <= 0.0) {
+        return Eigen::Vector3d(0.4, 0.4, 0.4);
+    }
+
+    static const Eigen::Vector3d RAMP[] = {
+        Eigen::Vector3d(0.0, 0.0, 1.0),
+        Eigen::Vector3d(0.0, 1.0, 1.0),
+        Eigen::Vector3d(0.0, 1.0, 0.0),
+        Eigen::Vector3d(1.0, 1.0, 0.0),
+        Eigen::Vector3d(1.0, 0.0, 0.0)
+    };
+    const int segments = 4;
+
+    double t = distance / max_distance * segments;
+    int i = std::min(int(t), segments - 1);
+    double f = t - i;
+
+    return (1.0 - f) * RAMP[i] + f * RAMP[i + 1];
+}
+
+std::shared_ptr<const CloudDifference> compute_difference(
+    const open3d::geometry::PointCloud& source,
+    const open3d::geometry::KDTreeFlann& target_index,
+    const Eigen::Matrix4d& relative_transformation,
+    double max_distance,
+    const CloudDifference* previous,
+    std::function<bool(double)> update_progress
+) {
+    const auto& points = source.points_;
+
+    auto difference = std::make_shared<CloudDifference>();
+    difference->relative_transformation = relative_transformation;
+    difference->max_distance = max_distance;
+    difference->distances.resize(points.size());
+
+    double search_radius = DIFFERENCE_SEARCH_FACTOR * max_distance;
+
+    // No point gets closer to the target than it was before, minus the distance it moved.
+    bool incremental = previous != nullptr
+        && previous->distances.size() == points.size()
+        && previous->max_distance == max_distance;
+
+    Eigen::Matrix4d previous_transformation = incremental ? previous->relative_transformation : relative_transformation;
+    const double* previous_distances = incremental ? previous->distances.data() : nullptr;
+    double* distances = difference->distances.data();
+
+    for (size_t block = 0; block < points.size(); block += DIFFERENCE_BLOCK_SIZE) {
+        size_t block_end = std::min(points.size(), block + DIFFERENCE_BLOCK_SIZE);
+
+        parallel_for(block_end - block, [&](size_t start, size_t end) {
+            std::vector<int> indices;
+            std::vector<double> distance2;
+
+            for (size_t i = block + start; i < block + end; i++) {
+                Eigen::Vector3d p = (relative_transformation * points[i].homogeneous()).head<3>();
+
+                if (previous_distances) {
+                    Eigen::Vector3d before = (previous_transformation * points[i].homogeneous()).head<3>();
+                    double lower_bound = previous_distances[i] - (p - before).norm();
+
+                    if (lower_bound >= search_radius) {
+                        distances[i] = lower_bound;
+                        continue;
+                    }
+                }
+
+                if (target_index.SearchHybrid(p, search_radius, 1, indices, distance2) > 0) {
+                    distances[i] = std::sqrt(distance2[0]);
+                }
+                else {
+                    distances[i] = search_radius;
+                }
+            }
+        }, 256);
+
+        if (update_progress && !update_progress(double(block_end) / double(points.size()))) {
+            return nullptr;
+        }
+    }
+
+    return difference;
+}
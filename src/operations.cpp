@@ -0,0 +1,304 @@
+#include <operations.h>
+#include <tracing.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+
+open3d::geometry::PointCloud transform_cloud(const open3d::geometry::PointCloud& cloud, const Eigen::Matrix4d& transformation) {
+    open3d::geometry::PointCloud result;
+    result.points_.resize(cloud.points_.size());
+    result.colors_ = cloud.colors_;
+
+    if (cloud.HasNormals()) {
+        result.normals_.resize(cloud.normals_.size());
+    }
+
+    Eigen::Matrix3d r = transformation.block<3, 3>(0, 0);
+    Eigen::Vector3d translation = transformation.block<3, 1>(0, 3);
+
+    parallel_for(cloud.points_.size(), [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            result.points_[i] = r * cloud.points_[i] + translation;
+        }
+        for (size_t i = start; i < std::min(end, result.normals_.size()); i++) {
+            result.normals_[i] = r * cloud.normals_[i];
+        }
+    });
+
+    return result;
+}
+
+std::vector<std::shared_ptr<Entry>> transform_entries(const std::vector<std::shared_ptr<Entry>>& entries, const Eigen::Matrix4d& transformation) {
+    TraceSpan span("transform_entries");
+    std::vector<std::shared_ptr<Entry>> copies(entries.size());
+
+    // Transforming a copy already runs in parallel over its points, so the copies are transformed one after another.
+    for (size_t i = 0; i < entries.size(); i++) {
+        copies[i] = std::make_shared<Entry>(*entries[i]);
+        copies[i]->do_transform(transformation);
+    }
+
+    return copies;
+}
+
+MergePart capture_merge_part(const std::shared_ptr<Entry>& entry) {
+    MergePart part;
+    part.entry = entry;
+    part.transformation = entry->get_transformation();
+
+    auto& origins = entry->get_origins();
+
+    if (origins.size() == 0) {
+        part.origins.push_back(std::make_pair(std::string(entry->name), part.transformation));
+    }
+    else {
+        for (auto& pair : origins) {
+            part.origins.push_back(std::make_pair(std::string(pair.first), part.transformation * pair.second));
+        }
+    }
+
+    return part;
+}
+
+std::shared_ptr<Entry> merge_parts(const std::vector<MergePart>& parts, std::function<bool(double)> update_progress) {
+    TraceSpan span("merge_parts");
+
+    open3d::geometry::PointCloud cloud;
+    std::vector<std::pair<std::string, Eigen::Matrix4d>> origins;
+
+    for (size_t i = 0; i < parts.size(); i++) {
+        cloud += transform_cloud(parts[i].entry->get_base(), parts[i].transformation);
+        origins.insert(origins.end(), parts[i].origins.begin(), parts[i].origins.end());
+
+        if (update_progress && !update_progress(double(i + 1) / double(parts.size()))) {
+            return nullptr;
+        }
+    }
+
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>(cloud);
+    entry->get_origins() = origins;
+    return entry;
+}
+
+std::shared_ptr<Entry> group_entries(const std::vector<std::shared_ptr<Entry>>& entries) {
+    std::vector<EntryPart> parts;
+    std::vector<std::pair<std::string, Eigen::Matrix4d>> origins;
+
+    for (const auto& entry : entries) {
+        MergePart captured = capture_merge_part(entry);
+        origins.insert(origins.end(), captured.origins.begin(), captured.origins.end());
+
+        if (entry->is_group()) {
+            for (const EntryPart& part : entry->get_parts()) {
+                parts.push_back(EntryPart{ part.entry, captured.transformation * part.transformation });
+            }
+        }
+        else {
+            // Loaded entries are replaced when they change, but their caches are still filled in.
+            // A copy of its own keeps the part unchanged and safe to read from other threads.
+            parts.push_back(EntryPart{ std::make_shared<const Entry>(*entry), captured.transformation });
+        }
+    }
+
+    std::shared_ptr<Entry> group = std::make_shared<Entry>(std::move(parts));
+    group->get_origins() = origins;
+    return group;
+}
+
+std::shared_ptr<Entry> flatten_group(const Entry& group, std::function<bool(double)> update_progress) {
+    TraceSpan span("flatten_group");
+
+    std::vector<MergePart> parts;
+    for (const EntryPart& part : group.get_parts()) {
+        parts.push_back(MergePart{ part.entry, part.transformation, {} });
+    }
+
+    std::shared_ptr<Entry> entry = merge_parts(parts, update_progress);
+    if (!entry) {
+        return nullptr;
+    }
+
+    entry->name = group.name;
+    entry->get_origins() = group.get_origins();
+
+    if (group.get_transformation() != Eigen::Matrix4d::Identity()) {
+        entry->do_transform(group.get_transformation());
+    }
+
+    return entry;
+}
+
+std::shared_ptr<Entry> flattened_view(Entry& group) {
+    TraceSpan span("flattened_view");
+
+    if (!group.get_flattened()) {
+        std::vector<MergePart> parts;
+        for (const EntryPart& part : group.get_parts()) {
+            parts.push_back(MergePart{ part.entry, part.transformation, {} });
+        }
+
+        group.set_flattened(merge_parts(parts));
+    }
+
+    // The copy keeps the id of the cached points, so that caches built on it can be shared back.
+    std::shared_ptr<Entry> view = std::make_shared<Entry>(*group.get_flattened());
+    view->name = group.name;
+
+    if (group.get_transformation() != Eigen::Matrix4d::Identity()) {
+        view->do_transform(group.get_transformation());
+    }
+
+    return view;
+}
+
+void keep_flattened_caches(Entry& group, const Entry& view) {
+    if (!group.get_flattened()) {
+        return;
+    }
+
+    // The cached points are shared with other copies of the group, so the caches go to a copy of them.
+    auto flattened = std::make_shared<Entry>(*group.get_flattened());
+    flattened->share_caches(view);
+    group.set_flattened(flattened);
+}
+
+/// <summary>
+/// Writes a cloud that is already transformed. Progress starts at 10 %.
+/// </summary>
+static bool write_cloud(
+    const open3d::geometry::PointCloud& cloud,
+    const std::string& path,
+    const std::function<bool(double)>& update_progress
+) {
+    open3d::io::WritePointCloudOption opt;
+    opt.update_progress = [&update_progress](double percent) -> bool {
+        return !update_progress || update_progress(0.1 + 0.9 * percent / 100.0);
+    };
+
+    return open3d::io::WritePointCloud(path, cloud, opt);
+}
+
+bool export_cloud(
+    const open3d::geometry::PointCloud& cloud,
+    const Eigen::Matrix4d& transformation,
+    const std::string& path,
+    std::function<bool(double)> update_progress
+) {
+    TraceSpan span("export");
+
+    open3d::geometry::PointCloud transformed = transform_cloud(cloud, transformation);
+    if (update_progress && !update_progress(0.1)) {
+        return false;
+    }
+
+    return write_cloud(transformed, path, update_progress);
+}
+
+/// <summary>
+/// Number of points `export_group` transforms and writes at once.
+/// </summary>
+static const size_t EXPORT_BLOCK_SIZE = 65536;
+
+/// <summary>
+/// Appends the bytes of a value to a buffer, in the byte order of the machine.
+/// </summary>
+template<typename T>
+static void append_bytes(std::vector<char>& buffer, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+bool export_group(const Entry& group, const std::string& path, std::function<bool(double)> update_progress) {
+    TraceSpan span("export");
+
+    const auto& parts = group.get_parts();
+    size_t count = 0;
+    bool normals = true;
+    bool colors = true;
+
+    // Properties are only written if every part has them, like Open3D does for a single cloud.
+    for (const EntryPart& part : parts) {
+        const auto& base = part.entry->get_base();
+        if (base.points_.empty()) {
+            continue;
+        }
+
+        count += base.points_.size();
+        normals = normals && base.HasNormals();
+        colors = colors && base.HasColors();
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    // The same binary layout Open3D writes, so that exported groups load like exported clouds.
+    file << "ply\n"
+        << "format binary_little_endian 1.0\n"
+        << "element vertex " << count << "\n"
+        << "property double x\n"
+        << "property double y\n"
+        << "property double z\n";
+    if (normals) {
+        file << "property double nx\n"
+            << "property double ny\n"
+            << "property double nz\n";
+    }
+    if (colors) {
+        file << "property uchar red\n"
+            << "property uchar green\n"
+            << "property uchar blue\n";
+    }
+    file << "end_header\n";
+
+    // Every part is transformed block by block straight into the file, the group is never held as one cloud.
+    std::vector<char> buffer;
+    size_t written = 0;
+
+    for (const EntryPart& part : parts) {
+        const auto& base = part.entry->get_base();
+        Eigen::Matrix4d t = group.get_transformation() * part.transformation;
+        Eigen::Matrix3d r = t.block<3, 3>(0, 0);
+        Eigen::Vector3d translation = t.block<3, 1>(0, 3);
+
+        for (size_t start = 0; start < base.points_.size(); start += EXPORT_BLOCK_SIZE) {
+            size_t end = std::min(start + EXPORT_BLOCK_SIZE, base.points_.size());
+            buffer.clear();
+
+            for (size_t i = start; i < end; i++) {
+                Eigen::Vector3d point = r * base.points_[i] + translation;
+                append_bytes(buffer, point.x());
+                append_bytes(buffer, point.y());
+                append_bytes(buffer, point.z());
+
+                if (normals) {
+                    Eigen::Vector3d normal = r * base.normals_[i];
+                    append_bytes(buffer, normal.x());
+                    append_bytes(buffer, normal.y());
+                    append_bytes(buffer, normal.z());
+                }
+
+                if (colors) {
+                    for (int k = 0; k < 3; k++) {
+                        append_bytes(buffer, uint8_t(std::round(std::clamp(base.colors_[i](k), 0.0, 1.0) * 255.0)));
+                    }
+                }
+            }
+
+            file.write(buffer.data(), std::streamsize(buffer.size()));
+            if (!file) {
+                return false;
+            }
+
+            written += end - start;
+            if (update_progress && !update_progress(double(written) / double(count))) {
+                return false;
+            }
+        }
+    }
+
+    return bool(file.flush());
+}
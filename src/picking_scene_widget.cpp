@@ -0,0 +1,31 @@
+#include <picking_scene_widget.h>
+
+#include <cstdlib>
+
+/// Presses that are released further away than this many pixels move the camera instead of clicking.
+static const int CLICK_TOLERANCE = 3;
+
+PickingSceneWidget::PickingSceneWidget() : gui::SceneWidget(), button_down(false), down_x(0), down_y(0) {
+    handler = [](int _x, int _y) {};
+}
+
+gui::Widget::EventResult PickingSceneWidget::Mouse(const gui::MouseEvent& e) {
+    if (e.type == gui::MouseEvent::Type::BUTTON_DOWN) {
+        button_down = e.button.button == gui::MouseButton::LEFT;
+        down_x = e.x;
+        down_y = e.y;
+    } else if (e.type == gui::MouseEvent::Type::BUTTON_UP && button_down) {
+        button_down = false;
+
+        if (std::abs(e.x - down_x) <= CLICK_TOLERANCE && std::abs(e.y - down_y) <= CLICK_TOLERANCE) {
+            const auto& frame = GetFrame();
+            this->handler(e.x - frame.x, e.y - frame.y);
+        }
+    }
+
+    return SceneWidget::Mouse(e);
+}
+
+void PickingSceneWidget::SetOnClicked(std::function<void(int, int)> handler) {
+    this->handler = handler;
+}
@@ -0,0 +1,253 @@
+#include <point_budget.h>
+#include <utils.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+/// Depth of the octree the drawing order is derived from. Points sharing a leaf beyond this depth are drawn last.
+static const int LOD_MAX_DEPTH = 16;
+
+static const double PI = 3.14159265358979323846;
+
+/// Every cloud gets up to this many points before the rest of the budget is distributed,
+/// so that clouds outside the view are not missing while the camera turns towards them.
+static const size_t MIN_CLOUD_POINTS = 2000;
+
+/// Spreads the lower 21 bits of a value, so that two zero bits follow every bit.
+static uint64_t spread_bits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x1f00000000ffff;
+    v = (v | (v << 16)) & 0x1f0000ff0000ff;
+    v = (v | (v << 8)) & 0x100f00f00f00f00f;
+    v = (v | (v << 4)) & 0x10c30c30c30c30c3;
+    v = (v | (v << 2)) & 0x1249249249249249;
+    return v;
+}
+
+std::shared_ptr<const LodOrder> build_lod_order(const open3d::geometry::PointCloud& cloud) {
+    size_t count = cloud.points_.size();
+
+    if (count == 0 || count > std::numeric_limits<uint32_t>::max()) {
+        return nullptr;
+    }
+
+    auto lod = std::make_shared<LodOrder>();
+    Eigen::Vector3d min_bound = cloud.GetMinBound();
+    Eigen::Vector3d max_bound = cloud.GetMaxBound();
+
+    const double cells = double(1 << LOD_MAX_DEPTH);
+    double extent = std::max((max_bound - min_bound).maxCoeff(), std::numeric_limits<double>::epsilon());
+    double scale = cells / extent;
+
+    // Sorting by Morton code puts the points of every octree node next to each other.
+    std::vector<std::pair<uint64_t, uint32_t>> codes(count);
+
+    parallel_for(count, [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            Eigen::Vector3d cell = ((cloud.points_[i] - min_bound) * scale).array().floor().min(cells - 1.0);
+            codes[i].first = (spread_bits(uint64_t(cell.x())) << 2)
+                | (spread_bits(uint64_t(cell.y())) << 1)
+                | spread_bits(uint64_t(cell.z()));
+            codes[i].second = uint32_t(i);
+        }
+    });
+
+    std::sort(codes.begin(), codes.end());
+
+    // A point represents the nodes in which it is the first point.
+    // The shallowest such node is where its code first differs from its predecessor.
+    std::vector<uint8_t> depths(count);
+    depths[0] = 0;
+
+    for (size_t i = 1; i < count; i++) {
+        uint64_t difference = codes[i].first ^ codes[i - 1].first;
+
+        if (difference == 0) {
+            depths[i] = LOD_MAX_DEPTH + 1;
+            continue;
+        }
+
+        int highest_bit = 63;
+        while (!(difference >> highest_bit)) {
+            highest_bit--;
+        }
+        depths[i] = uint8_t(LOD_MAX_DEPTH - highest_bit / 3);
+    }
+
+    lod->depth_ends.assign(LOD_MAX_DEPTH + 2, 0);
+    for (uint8_t depth : depths) {
+        lod->depth_ends[depth]++;
+    }
+    for (size_t d = 1; d < lod->depth_ends.size(); d++) {
+        lod->depth_ends[d] += lod->depth_ends[d - 1];
+    }
+
+    lod->order.resize(count);
+    std::vector<size_t> positions(lod->depth_ends.size(), 0);
+    for (size_t d = 1; d < positions.size(); d++) {
+        positions[d] = lod->depth_ends[d - 1];
+    }
+    for (size_t i = 0; i < count; i++) {
+        lod->order[positions[depths[i]]++] = codes[i].second;
+    }
+
+    // Within a depth, points would otherwise be in Morton order, so a partially
+    // drawn depth would only cover part of the cloud.
+    std::mt19937 random(0);
+    size_t begin = 0;
+    for (size_t end : lod->depth_ends) {
+        std::shuffle(lod->order.begin() + begin, lod->order.begin() + end, random);
+        begin = end;
+    }
+
+    return lod;
+}
+
+std::vector<size_t> allocate_point_budget(const std::vector<BudgetRequest>& requests, const BudgetView& view, size_t budget) {
+    std::vector<size_t> result(requests.size(), 0);
+
+    size_t total = 0;
+    for (const auto& request : requests) {
+        total += request.point_count;
+    }
+
+    if (total <= budget) {
+        for (size_t i = 0; i < requests.size(); i++) {
+            result[i] = requests[i].point_count;
+        }
+        return result;
+    }
+
+    // Weigh every cloud by the number of pixels its bounding sphere covers, and clouds outside the view frustum by zero.
+    double half_height = 0.5 * view.field_of_view * PI / 180.0;
+    double aspect = double(std::max(1, view.viewport_width)) / double(std::max(1, view.viewport_height));
+    double half_width = std::atan(std::tan(half_height) * aspect);
+    double focal = 0.5 * view.viewport_height / std::tan(half_height);
+    double viewport_area = double(view.viewport_width) * double(view.viewport_height);
+
+    Eigen::Vector3d forward = view.camera_forward.normalized();
+    Eigen::Vector3d up = view.camera_up.normalized();
+    Eigen::Vector3d right = forward.cross(up).normalized();
+
+    // Outward normals of the four side planes of the frustum, which all pass through the camera.
+    const Eigen::Vector3d planes[] = {
+        up * std::cos(half_height) - forward * std::sin(half_height),
+        -up * std::cos(half_height) - forward * std::sin(half_height),
+        right * std::cos(half_width) - forward * std::sin(half_width),
+        -right * std::cos(half_width) - forward * std::sin(half_width),
+    };
+
+    std::vector<double> weights(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        const auto& request = requests[i];
+        Eigen::Vector3d center = 0.5 * (request.min_bound + request.max_bound);
+        double radius = 0.5 * (request.max_bound - request.min_bound).norm();
+        Eigen::Vector3d offset = center - view.camera_position;
+        double distance = offset.norm();
+
+        bool outside = offset.dot(forward) < -radius;
+        for (const auto& normal : planes) {
+            outside = outside || offset.dot(normal) > radius;
+        }
+
+        if (outside) {
+            weights[i] = 0.0;
+            continue;
+        }
+
+        double area = viewport_area;
+        if (distance > radius) {
+            double pixel_radius = focal * radius / distance;
+            area = std::min(PI * pixel_radius * pixel_radius, viewport_area);
+        }
+
+        weights[i] = std::max(area, 1.0);
+    }
+
+    double remaining = double(budget);
+
+    size_t minimum = std::min(MIN_CLOUD_POINTS, budget / std::max<size_t>(1, requests.size()));
+    for (size_t i = 0; i < requests.size(); i++) {
+        result[i] = std::min(minimum, requests[i].point_count);
+        remaining -= double(result[i]);
+    }
+
+    // Clouds that need fewer points than their share pass the remainder on to the others.
+    std::vector<bool> saturated(requests.size(), false);
+
+    while (remaining >= 1.0) {
+        double weight_sum = 0.0;
+        for (size_t i = 0; i < requests.size(); i++) {
+            if (!saturated[i]) {
+                weight_sum += weights[i];
+            }
+        }
+
+        if (weight_sum <= 0.0) {
+            break;
+        }
+
+        bool any_saturated = false;
+        for (size_t i = 0; i < requests.size(); i++) {
+            if (!saturated[i] && remaining * weights[i] / weight_sum >= double(requests[i].point_count - result[i])) {
+                remaining -= double(requests[i].point_count - result[i]);
+                result[i] = requests[i].point_count;
+                saturated[i] = true;
+                any_saturated = true;
+            }
+        }
+
+        if (any_saturated) {
+            continue;
+        }
+
+        for (size_t i = 0; i < requests.size(); i++) {
+            if (!saturated[i]) {
+                result[i] += size_t(remaining * weights[i] / weight_sum);
+            }
+        }
+        break;
+    }
+
+    return result;
+}
+
+std::shared_ptr<open3d::geometry::PointCloud> select_points(
+    const open3d::geometry::PointCloud& cloud,
+    const LodOrder* lod,
+    size_t count,
+    const std::vector<Eigen::Vector3d>* colors
+) {
+    auto result = std::make_shared<open3d::geometry::PointCloud>();
+    size_t total = cloud.points_.size();
+    count = std::min(count, total);
+
+    if (count == 0) {
+        return result;
+    }
+
+    bool has_order = lod && lod->order.size() == total;
+    size_t stride = std::max<size_t>(1, total / count);
+    count = has_order ? count : std::min(count, (total - 1) / stride + 1);
+
+    const std::vector<Eigen::Vector3d>& source_colors = colors && colors->size() == total ? *colors : cloud.colors_;
+    bool has_colors = source_colors.size() == total;
+    result->points_.resize(count);
+    if (has_colors) {
+        result->colors_.resize(count);
+    }
+
+    parallel_for(count, [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            size_t source = has_order ? lod->order[i] : i * stride;
+            result->points_[i] = cloud.points_[source];
+            if (has_colors) {
+                result->colors_[i] = source_colors[source];
+            }
+        }
+    });
+
+    return result;
+}
@@ -0,0 +1,132 @@
+#include <point_bvh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/// Leaves hold at most this many points.
+static const uint32_t BVH_LEAF_SIZE = 16;
+
+PointBvh::PointBvh(const std::vector<Eigen::Vector3d>& points) {
+    if (points.empty() || points.size() > std::numeric_limits<uint32_t>::max()) {
+        return;
+    }
+
+    indices.resize(points.size());
+    for (uint32_t i = 0; i < indices.size(); i++) {
+        indices[i] = i;
+    }
+
+    nodes.reserve(2 * (points.size() / BVH_LEAF_SIZE + 1));
+    build(points, 0, uint32_t(points.size()));
+}
+
+uint32_t PointBvh::build(const std::vector<Eigen::Vector3d>& points, uint32_t start, uint32_t end) {
+    Eigen::Vector3d min_bound = points[indices[start]];
+    Eigen::Vector3d max_bound = min_bound;
+
+    for (uint32_t i = start; i < end; i++) {
+        min_bound = min_bound.cwiseMin(points[indices[i]]);
+        max_bound = max_bound.cwiseMax(points[indices[i]]);
+    }
+
+    uint32_t index = uint32_t(nodes.size());
+    Node node;
+    node.center = 0.5 * (min_bound + max_bound);
+    node.radius = 0.5 * (max_bound - min_bound).norm();
+    node.start = start;
+    node.count = end - start;
+    node.second_child = 0;
+    nodes.push_back(node);
+
+    if (end - start <= BVH_LEAF_SIZE) {
+        return index;
+    }
+
+    int axis;
+    (max_bound - min_bound).maxCoeff(&axis);
+
+    uint32_t middle = start + (end - start) / 2;
+    std::nth_element(indices.begin() + start, indices.begin() + middle, indices.begin() + end,
+        [&points, axis](uint32_t a, uint32_t b) { return points[a][axis] < points[b][axis]; });
+
+    build(points, start, middle);
+    uint32_t second = build(points, middle, end);
+
+    // The vector may have grown in the meantime, so the node is looked up again.
+    nodes[index].second_child = second;
+    return index;
+}
+
+size_t PointBvh::get_memory_usage() const {
+    return nodes.capacity() * sizeof(Node) + indices.capacity() * sizeof(uint32_t);
+}
+
+std::optional<size_t> PointBvh::pick(
+    const std::vector<Eigen::Vector3d>& points,
+    const Eigen::Vector3d& origin,
+    const Eigen::Vector3d& direction,
+    double tolerance
+) const {
+    if (nodes.empty() || points.size() != indices.size()) {
+        return std::nullopt;
+    }
+
+    std::optional<size_t> best;
+    double best_t = std::numeric_limits<double>::infinity();
+
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        uint32_t node_index = stack.back();
+        stack.pop_back();
+
+        // Reject spheres that lie behind the ray, behind the best hit or outside the cone.
+        Eigen::Vector3d offset = node.center - origin;
+        double t = offset.dot(direction);
+
+        if (t + node.radius < 0.0 || t - node.radius > best_t) {
+            continue;
+        }
+
+        double distance = (offset - t * direction).norm();
+        if (distance > node.radius + tolerance * std::max(0.0, t + node.radius)) {
+            continue;
+        }
+
+        if (node.second_child == 0) {
+            for (uint32_t i = node.start; i < node.start + node.count; i++) {
+                Eigen::Vector3d p = points[indices[i]] - origin;
+                double t_point = p.dot(direction);
+
+                if (t_point <= 0.0 || t_point >= best_t) {
+                    continue;
+                }
+
+                double allowed = tolerance * t_point;
+                if ((p - t_point * direction).squaredNorm() <= allowed * allowed) {
+                    best_t = t_point;
+                    best = indices[i];
+                }
+            }
+            continue;
+        }
+
+        // Visit the closer child first, so that later nodes are rejected early.
+        uint32_t first = node_index + 1;
+        uint32_t second = node.second_child;
+        double t_first = (nodes[first].center - origin).dot(direction);
+        double t_second = (nodes[second].center - origin).dot(direction);
+
+        if (t_first < t_second) {
+            std::swap(first, second);
+        }
+
+        stack.push_back(first);
+        stack.push_back(second);
+    }
+
+    return best;
+}
@@ -0,0 +1,174 @@
+#include <point_compression.h>
+#include <tracing.h>
+#include <utils.h>
+
+#include <algorithm>
+#include <cmath>
+
+/// Largest quantized coordinate.
+static const double POINT_LEVELS = 65535.0;
+
+/// Largest quantized color channel.
+static const double COLOR_LEVELS = 255.0;
+
+/// Largest quantized component of a normal.
+static const double NORMAL_LEVELS = 127.0;
+
+CompressedCloud::CompressedCloud(
+    const open3d::geometry::PointCloud& cloud,
+    const open3d::geometry::AxisAlignedBoundingBox& bounds,
+    const std::vector<Eigen::Vector3d>* normals_
+) {
+    TraceSpan span("compress_cloud");
+    size_t count = cloud.points_.size();
+
+    origin = bounds.min_bound_;
+    step = (bounds.max_bound_ - bounds.min_bound_).cwiseMax(0.0) / POINT_LEVELS;
+
+    // A flat box has no extent to divide along that axis.
+    Eigen::Vector3d scale;
+    for (int axis = 0; axis < 3; axis++) {
+        scale(axis) = step(axis) > 0.0 ? 1.0 / step(axis) : 0.0;
+    }
+
+    bool has_colors = cloud.HasColors();
+    bool keep_normals = normals_ && normals_->size() == count;
+    points.resize(3 * count);
+    if (has_colors) {
+        colors.resize(3 * count);
+    }
+    if (keep_normals) {
+        normals.resize(3 * count);
+    }
+
+    parallel_for(count, [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            Eigen::Vector3d q = ((cloud.points_[i] - origin).cwiseProduct(scale)).cwiseMax(0.0).cwiseMin(POINT_LEVELS);
+            for (int axis = 0; axis < 3; axis++) {
+                points[3 * i + axis] = uint16_t(std::lround(q(axis)));
+            }
+
+            if (has_colors) {
+                Eigen::Vector3d c = cloud.colors_[i].cwiseMax(0.0).cwiseMin(1.0) * COLOR_LEVELS;
+                for (int channel = 0; channel < 3; channel++) {
+                    colors[3 * i + channel] = uint8_t(std::lround(c(channel)));
+                }
+            }
+
+            if (keep_normals) {
+                Eigen::Vector3d n = (*normals_)[i].cwiseMax(-1.0).cwiseMin(1.0) * NORMAL_LEVELS;
+                for (int axis = 0; axis < 3; axis++) {
+                    normals[3 * i + axis] = int8_t(std::lround(n(axis)));
+                }
+            }
+        }
+    });
+}
+
+size_t CompressedCloud::size() const {
+    return points.size() / 3;
+}
+
+size_t CompressedCloud::get_memory_usage() const {
+    return points.capacity() * sizeof(uint16_t) + colors.capacity() * sizeof(uint8_t) + normals.capacity() * sizeof(int8_t);
+}
+
+Eigen::Vector3d CompressedCloud::restore_point(size_t index) const {
+    const uint16_t* q = &points[3 * index];
+    return origin + step.cwiseProduct(Eigen::Vector3d(q[0], q[1], q[2]));
+}
+
+Eigen::Vector3d CompressedCloud::restore_color(size_t index) const {
+    const uint8_t* q = &colors[3 * index];
+    return Eigen::Vector3d(q[0], q[1], q[2]) / COLOR_LEVELS;
+}
+
+std::shared_ptr<const open3d::geometry::PointCloud> CompressedCloud::expand() const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (auto cloud = expanded.lock()) {
+        return cloud;
+    }
+
+    TraceSpan span("expand_cloud");
+    size_t count = size();
+    bool has_colors = !colors.empty();
+
+    auto cloud = std::make_shared<open3d::geometry::PointCloud>();
+    cloud->points_.resize(count);
+    if (has_colors) {
+        cloud->colors_.resize(count);
+    }
+
+    parallel_for(count, [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            cloud->points_[i] = restore_point(i);
+            if (has_colors) {
+                cloud->colors_[i] = restore_color(i);
+            }
+        }
+    });
+
+    expanded = cloud;
+    return cloud;
+}
+
+bool CompressedCloud::has_normals() const {
+    return !normals.empty();
+}
+
+std::shared_ptr<const std::vector<Eigen::Vector3d>> CompressedCloud::expand_normals() const {
+    if (normals.empty()) {
+        return nullptr;
+    }
+
+    TraceSpan span("expand_normals");
+    auto result = std::make_shared<std::vector<Eigen::Vector3d>>(size());
+    Eigen::Vector3d* result_ptr = result->data();
+    const int8_t* normals_ptr = normals.data();
+
+    parallel_for(result->size(), [result_ptr, normals_ptr](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            const int8_t* q = normals_ptr + 3 * i;
+            result_ptr[i] = Eigen::Vector3d(q[0], q[1], q[2]).normalized();
+        }
+    });
+
+    return result;
+}
+
+std::shared_ptr<open3d::geometry::PointCloud> CompressedCloud::expand_points(const Eigen::Matrix4d& transformation, const LodOrder* lod, size_t count) const {
+    auto result = std::make_shared<open3d::geometry::PointCloud>();
+    size_t total = size();
+    count = std::min(count, total);
+
+    if (count == 0) {
+        return result;
+    }
+
+    // Points are chosen exactly like `select_points` does on the restored cloud.
+    bool has_order = lod && lod->order.size() == total;
+    size_t stride = std::max<size_t>(1, total / count);
+    count = has_order ? count : std::min(count, (total - 1) / stride + 1);
+
+    bool has_colors = !colors.empty();
+    result->points_.resize(count);
+    if (has_colors) {
+        result->colors_.resize(count);
+    }
+
+    Eigen::Matrix3d r = transformation.block<3, 3>(0, 0);
+    Eigen::Vector3d translation = transformation.block<3, 1>(0, 3);
+
+    parallel_for(count, [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            size_t source = has_order ? lod->order[i] : i * stride;
+            result->points_[i] = r * restore_point(source) + translation;
+            if (has_colors) {
+                result->colors_[i] = restore_color(source);
+            }
+        }
+    });
+
+    return result;
+}
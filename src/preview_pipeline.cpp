@@ -0,0 +1,138 @@
+#include <preview_pipeline.h>
+#include <metrics.h>
+#include <profiler.h>
+#include <tracing.h>
+
+PreviewPipeline::PreviewPipeline() :
+    stopping(false),
+    generation(0),
+    pending(),
+    source(),
+    residuals(),
+    max_distance(0.0),
+    ready() {
+    thread = std::thread([this]() { this->run(); });
+}
+
+PreviewPipeline::~PreviewPipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_one();
+    thread.join();
+}
+
+void PreviewPipeline::set_source(
+    std::shared_ptr<const Entry> source,
+    std::shared_ptr<const std::vector<double>> residuals,
+    double max_distance
+) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->source = source;
+    this->residuals = residuals;
+    this->max_distance = max_distance;
+    this->pending.reset();
+    this->ready.reset();
+    this->generation++;
+}
+
+void PreviewPipeline::request(const Eigen::Matrix4d& transformation) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = transformation;
+    }
+    condition.notify_one();
+}
+
+void PreviewPipeline::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.reset();
+    ready.reset();
+    generation++;
+}
+
+std::shared_ptr<Entry> PreviewPipeline::take() {
+    std::shared_ptr<Entry> result;
+    std::lock_guard<std::mutex> lock(mutex);
+    result.swap(ready);
+    return result;
+}
+
+void PreviewPipeline::colorize(Entry& entry, const std::vector<double>* residuals, double max_distance) {
+    if (entry.is_group()) {
+        // Residuals are never computed for groups, so the parts are colored uniformly.
+        // Views that are colored already keep their colors, and with them their upload.
+        for (auto& view : entry.modify_part_views()) {
+            if (!view->get_display_colors()) {
+                colorize(*view, nullptr, max_distance);
+            }
+        }
+
+        entry.mark_modified();
+        return;
+    }
+
+    ScopedTimer timer(TIMER_COLORIZE);
+    size_t count = entry.get_transformed().points_.size();
+
+    // Only the colors are written, the points stay shared with the copies of the entry.
+    std::vector<Eigen::Vector3d> colors(count, Eigen::Vector3d(1.0, 0.55, 0.0));
+
+    if (residuals && residuals->size() == count) {
+        const double* residuals_ptr = residuals->data();
+        Eigen::Vector3d* colors_ptr = colors.data();
+
+        parallel_for(count, [residuals_ptr, colors_ptr, max_distance](size_t start, size_t end) {
+            for (size_t i = start; i < end; i++) {
+                colors_ptr[i] = residual_color(residuals_ptr[i], max_distance);
+            }
+        });
+    }
+
+    entry.set_display_colors(std::make_shared<const std::vector<Eigen::Vector3d>>(std::move(colors)));
+    entry.mark_modified();
+}
+
+void PreviewPipeline::run() {
+    set_trace_thread_name("preview");
+
+    while (true) {
+        Eigen::Matrix4d transformation;
+        uint64_t id;
+        std::shared_ptr<const Entry> source;
+        std::shared_ptr<const std::vector<double>> residuals;
+        double max_distance;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || pending.has_value(); });
+
+            if (stopping) {
+                return;
+            }
+
+            transformation = *pending;
+            pending.reset();
+            id = generation;
+            source = this->source;
+            residuals = this->residuals;
+            max_distance = this->max_distance;
+        }
+
+        if (!source) {
+            continue;
+        }
+
+        // The source is never modified, so it can be copied without holding the lock.
+        auto preview = std::make_shared<Entry>(*source);
+        preview->do_transform(transformation);
+        colorize(*preview, residuals.get(), max_distance);
+
+        // Publishing replaces a preview the main thread did not take yet, which is outdated by now.
+        std::lock_guard<std::mutex> lock(mutex);
+        if (id == generation) {
+            ready = preview;
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#include <profiler.h>
+
+#include <atomic>
+
+/// <summary>
+/// Measurements of one operation. Fields are updated independently, so a reader may see
+/// a measurement partially applied, which is acceptable for display purposes.
+/// </summary>
+struct TimerSlot {
+    std::atomic<uint64_t> count;
+    std::atomic<int64_t> total;
+    std::atomic<int64_t> last;
+    std::atomic<uint64_t> amount;
+};
+
+static std::atomic<bool> profiling_enabled(false);
+static TimerSlot timer_slots[TIMER_COUNT];
+
+void set_profiling_enabled(bool enabled) {
+    if (enabled) {
+        for (TimerSlot& slot : timer_slots) {
+            slot.count = 0;
+            slot.total = 0;
+            slot.last = 0;
+            slot.amount = 0;
+        }
+    }
+
+    profiling_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool is_profiling_enabled() {
+    return profiling_enabled.load(std::memory_order_relaxed);
+}
+
+void record_timer(TimerId id, std::chrono::nanoseconds duration, uint64_t amount) {
+    TimerSlot& slot = timer_slots[id];
+    slot.count.fetch_add(1, std::memory_order_relaxed);
+    slot.total.fetch_add(duration.count(), std::memory_order_relaxed);
+    slot.last.store(duration.count(), std::memory_order_relaxed);
+    slot.amount.fetch_add(amount, std::memory_order_relaxed);
+}
+
+TimerStats get_timer_stats(TimerId id) {
+    const TimerSlot& slot = timer_slots[id];
+
+    TimerStats stats;
+    stats.count = slot.count.load(std::memory_order_relaxed);
+    stats.total = std::chrono::nanoseconds(slot.total.load(std::memory_order_relaxed));
+    stats.last = std::chrono::nanoseconds(slot.last.load(std::memory_order_relaxed));
+    stats.amount = slot.amount.load(std::memory_order_relaxed);
+    return stats;
+}
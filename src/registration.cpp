@@ -0,0 +1,521 @@
+#include <registration.h>
+#include <metrics.h>
+#include <profiler.h>
+#include <tracing.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <unordered_set>
+
+using namespace open3d::pipelines::registration;
+
+/// Number of voxels along the longest side of the overlap region.
+static const double OVERLAP_RESOLUTION = 64.0;
+
+/// Registration uses the full clouds if the overlap contains fewer points than this.
+static const size_t MIN_OVERLAP_POINTS = 100;
+
+/// Voxel coordinates are stored in 21 bits per axis.
+static const int VOXEL_KEY_BITS = 21;
+
+/// Number of points sampled from each cloud by the parameter estimation.
+static const size_t PARAMETER_SAMPLES = 2000;
+
+/// The correspondence distance never falls below this multiple of the point spacing.
+static const double SPACING_DISTANCE_FACTOR = 4.0;
+
+/// The correspondence distance covers this multiple of the median residual.
+static const double RESIDUAL_DISTANCE_FACTOR = 2.0;
+
+/// Convergence is reached once the RMSE changes by less than this fraction of the point spacing.
+static const double SPACING_RMSE_FACTOR = 0.01;
+
+static const int MIN_ITERATIONS = 20;
+static const int MAX_ITERATIONS = 200;
+
+/// Picked points are considered to lie on a line if their second principal extent is below this fraction of the first.
+static const double COLLINEAR_RATIO = 1e-3;
+
+static bool in_box(const Eigen::Vector3d& p, const Eigen::Vector3d& min_bound, const Eigen::Vector3d& max_bound) {
+    return (p.array() >= min_bound.array()).all() && (p.array() <= max_bound.array()).all();
+}
+
+static uint64_t voxel_key(const Eigen::Vector3i& cell) {
+    // Cells are offset by one, so that neighbours of the first cell are representable as well.
+    return (uint64_t(cell.x() + 1) << (2 * VOXEL_KEY_BITS))
+        | (uint64_t(cell.y() + 1) << VOXEL_KEY_BITS)
+        | uint64_t(cell.z() + 1);
+}
+
+static Eigen::Vector3i voxel_cell(const Eigen::Vector3d& p, const Eigen::Vector3d& origin, double voxel_size) {
+    return ((p - origin) / voxel_size).array().floor().cast<int>();
+}
+
+/// Returns the voxels occupied by the points within the given box, grown by one voxel in every direction.
+static std::unordered_set<uint64_t> dilated_occupancy(
+    const open3d::geometry::PointCloud& cloud,
+    const Eigen::Vector3d& min_bound,
+    const Eigen::Vector3d& max_bound,
+    double voxel_size
+) {
+    std::unordered_set<uint64_t> occupied;
+    std::mutex mutex;
+
+    parallel_for(cloud.points_.size(), [&](size_t start, size_t end) {
+        std::unordered_set<uint64_t> local;
+
+        for (size_t i = start; i < end; i++) {
+            const Eigen::Vector3d& p = cloud.points_[i];
+            if (in_box(p, min_bound, max_bound)) {
+                local.insert(voxel_key(voxel_cell(p, min_bound, voxel_size)));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        occupied.insert(local.begin(), local.end());
+    });
+
+    const uint64_t mask = (uint64_t(1) << VOXEL_KEY_BITS) - 1;
+    std::unordered_set<uint64_t> dilated;
+    dilated.reserve(occupied.size() * 8);
+
+    for (uint64_t key : occupied) {
+        Eigen::Vector3i cell(
+            int((key >> (2 * VOXEL_KEY_BITS)) & mask) - 1,
+            int((key >> VOXEL_KEY_BITS) & mask) - 1,
+            int(key & mask) - 1
+        );
+
+        for (int x = -1; x <= 1; x++) {
+            for (int y = -1; y <= 1; y++) {
+                for (int z = -1; z <= 1; z++) {
+                    dilated.insert(voxel_key(cell + Eigen::Vector3i(x, y, z)));
+                }
+            }
+        }
+    }
+
+    return dilated;
+}
+
+/// Returns the indices of all points within the given box whose voxel is contained in `occupied`.
+static std::vector<size_t> select_occupied(
+    const open3d::geometry::PointCloud& cloud,
+    const Eigen::Vector3d& min_bound,
+    const Eigen::Vector3d& max_bound,
+    double voxel_size,
+    const std::unordered_set<uint64_t>& occupied
+) {
+    std::vector<std::pair<size_t, std::vector<size_t>>> chunks;
+    std::mutex mutex;
+
+    parallel_for(cloud.points_.size(), [&](size_t start, size_t end) {
+        std::vector<size_t> local;
+
+        for (size_t i = start; i < end; i++) {
+            const Eigen::Vector3d& p = cloud.points_[i];
+            if (in_box(p, min_bound, max_bound) && occupied.count(voxel_key(voxel_cell(p, min_bound, voxel_size))) > 0) {
+                local.push_back(i);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks.emplace_back(start, std::move(local));
+    });
+
+    // Keep the original point order, independent of thread scheduling.
+    std::sort(chunks.begin(), chunks.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<size_t> result;
+    for (auto& chunk : chunks) {
+        result.insert(result.end(), chunk.second.begin(), chunk.second.end());
+    }
+
+    return result;
+}
+
+Overlap estimate_overlap(
+    const open3d::geometry::PointCloud& source,
+    const open3d::geometry::PointCloud& target,
+    double margin
+) {
+    Overlap overlap;
+
+    if (source.points_.empty() || target.points_.empty()) {
+        return overlap;
+    }
+
+    auto source_box = source.GetAxisAlignedBoundingBox();
+    auto target_box = target.GetAxisAlignedBoundingBox();
+
+    Eigen::Vector3d margin_vector = Eigen::Vector3d::Constant(margin);
+    Eigen::Vector3d min_bound = source_box.min_bound_.cwiseMax(target_box.min_bound_) - margin_vector;
+    Eigen::Vector3d max_bound = source_box.max_bound_.cwiseMin(target_box.max_bound_) + margin_vector;
+
+    if ((min_bound.array() > max_bound.array()).any()) {
+        return overlap;
+    }
+
+    // A single voxel of dilation has to cover the margin.
+    double longest_side = (max_bound - min_bound).maxCoeff();
+    double voxel_size = std::max({ margin, longest_side / OVERLAP_RESOLUTION, longest_side / double(1 << (VOXEL_KEY_BITS - 2)) });
+
+    if (voxel_size <= 0.0) {
+        return overlap;
+    }
+
+    auto source_occupancy = dilated_occupancy(source, min_bound, max_bound, voxel_size);
+    auto target_occupancy = dilated_occupancy(target, min_bound, max_bound, voxel_size);
+
+    overlap.source_indices = select_occupied(source, min_bound, max_bound, voxel_size, target_occupancy);
+    overlap.target_indices = select_occupied(target, min_bound, max_bound, voxel_size, source_occupancy);
+
+    return overlap;
+}
+
+/// Returns the median of all positive values, or zero if there are none.
+static double positive_median(std::vector<double>& values) {
+    auto end = std::remove_if(values.begin(), values.end(), [](double v) { return !(v > 0.0); });
+    size_t count = end - values.begin();
+
+    if (count == 0) {
+        return 0.0;
+    }
+
+    auto middle = values.begin() + count / 2;
+    std::nth_element(values.begin(), middle, end);
+    return *middle;
+}
+
+double estimate_point_spacing(Entry& entry) {
+    return estimate_point_spacing(entry.get_base(), entry.get_index());
+}
+
+double estimate_point_spacing(const open3d::geometry::PointCloud& cloud, const open3d::geometry::KDTreeFlann& index) {
+    const auto& points = cloud.points_;
+
+    size_t stride = std::max<size_t>(1, points.size() / PARAMETER_SAMPLES);
+    size_t samples = points.empty() ? 0 : (points.size() - 1) / stride + 1;
+
+    std::vector<double> spacings(samples, 0.0);
+
+    parallel_for(samples, [&](size_t start, size_t end) {
+        std::vector<int> indices;
+        std::vector<double> distance2;
+
+        for (size_t i = start; i < end; i++) {
+            // The closest point is the query itself.
+            if (index.SearchKNN(points[i * stride], 2, indices, distance2) == 2) {
+                spacings[i] = std::sqrt(distance2[1]);
+            }
+        }
+    }, 256);
+
+    return positive_median(spacings);
+}
+
+RegistrationParameters estimate_registration_parameters(Entry& source, Entry& target) {
+    size_t source_count = source.get_transformed().points_.size();
+    size_t source_stride = std::max<size_t>(1, source_count / PARAMETER_SAMPLES);
+    std::vector<double> residuals = compute_distances(source, target, source_stride);
+
+    RegistrationParameters parameters;
+    parameters.point_spacing = estimate_point_spacing(target);
+    parameters.median_residual = positive_median(residuals);
+
+    double spacing = parameters.point_spacing > 0.0 ? parameters.point_spacing : std::numeric_limits<double>::epsilon();
+
+    parameters.max_correspondence_distance = std::max(
+        SPACING_DISTANCE_FACTOR * spacing,
+        RESIDUAL_DISTANCE_FACTOR * parameters.median_residual
+    );
+
+    // Clouds that are far apart relative to their density need more iterations to converge.
+    double misalignment = parameters.median_residual / spacing;
+    parameters.max_iteration = std::clamp(
+        int(std::ceil(MIN_ITERATIONS + 10.0 * std::log2(1.0 + misalignment))),
+        MIN_ITERATIONS,
+        MAX_ITERATIONS
+    );
+
+    parameters.rmse_change = SPACING_RMSE_FACTOR * spacing;
+    parameters.relative_fitness = std::clamp(1.0 / double(std::max<size_t>(1, source_count)), 1e-6, 1e-3);
+
+    return parameters;
+}
+
+/// <summary>
+/// Finds the closest target point of every source point within the correspondence distance,
+/// like Open3D does between two ICP iterations, but with a search index that is reused across runs.
+/// </summary>
+static RegistrationResult find_correspondences(
+    const open3d::geometry::PointCloud& source,
+    const open3d::geometry::KDTreeFlann& target_index,
+    double max_correspondence_distance,
+    const Eigen::Matrix4d& transformation
+) {
+    std::vector<std::pair<size_t, CorrespondenceSet>> chunks;
+    double error = 0.0;
+    std::mutex mutex;
+
+    parallel_for(source.points_.size(), [&](size_t start, size_t end) {
+        CorrespondenceSet local;
+        double local_error = 0.0;
+        std::vector<int> indices;
+        std::vector<double> distance2;
+
+        for (size_t i = start; i < end; i++) {
+            if (target_index.SearchHybrid(source.points_[i], max_correspondence_distance, 1, indices, distance2) > 0) {
+                local.emplace_back(int(i), indices[0]);
+                local_error += distance2[0];
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks.emplace_back(start, std::move(local));
+        error += local_error;
+    });
+
+    // Keep the order of the source points, independent of thread scheduling.
+    std::sort(chunks.begin(), chunks.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    RegistrationResult result(transformation);
+    for (auto& chunk : chunks) {
+        result.correspondence_set_.insert(result.correspondence_set_.end(), chunk.second.begin(), chunk.second.end());
+    }
+
+    size_t count = result.correspondence_set_.size();
+    if (count > 0 && !source.points_.empty()) {
+        result.fitness_ = double(count) / double(source.points_.size());
+        result.inlier_rmse_ = std::sqrt(error / double(count));
+    }
+
+    return result;
+}
+
+/// <summary>
+/// Copies the points of a cloud into the coordinate system given by a rigid transformation.
+/// Covariances are rotated along if given, for generalized ICP.
+/// </summary>
+static open3d::geometry::PointCloud transformed_points(
+    const open3d::geometry::PointCloud& cloud,
+    const Eigen::Matrix4d& transformation,
+    const std::vector<Eigen::Matrix3d>* covariances
+) {
+    open3d::geometry::PointCloud result;
+    result.points_.resize(cloud.points_.size());
+
+    Eigen::Matrix3d r = transformation.block<3, 3>(0, 0);
+    Eigen::Vector3d translation = transformation.block<3, 1>(0, 3);
+    bool has_covariances = covariances && covariances->size() == cloud.points_.size();
+
+    if (has_covariances) {
+        result.covariances_.resize(cloud.points_.size());
+    }
+
+    parallel_for(cloud.points_.size(), [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            result.points_[i] = r * cloud.points_[i] + translation;
+            if (has_covariances) {
+                result.covariances_[i] = r * (*covariances)[i] * r.transpose();
+            }
+        }
+    });
+
+    return result;
+}
+
+/// <summary>
+/// Copies the target points used by ICP, together with the part of the surface model the method needs.
+/// </summary>
+/// <param name="indices">Indices of the points to copy, or empty for all points.</param>
+static std::shared_ptr<open3d::geometry::PointCloud> copy_target(
+    const open3d::geometry::PointCloud& cloud,
+    const SurfaceEstimate& surface,
+    RegistrationMethod method,
+    const std::vector<size_t>& indices
+) {
+    size_t count = indices.empty() ? cloud.points_.size() : indices.size();
+    bool has_normals = method == POINT_TO_PLANE && surface.normals && surface.normals->size() == cloud.points_.size();
+    bool has_covariances = method == GENERALIZED_ICP && surface.covariances && surface.covariances->size() == cloud.points_.size();
+
+    auto result = std::make_shared<open3d::geometry::PointCloud>();
+    result->points_.resize(count);
+    if (has_normals) {
+        result->normals_.resize(count);
+    }
+    if (has_covariances) {
+        result->covariances_.resize(count);
+    }
+
+    parallel_for(count, [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            size_t source = indices.empty() ? i : indices[i];
+            result->points_[i] = cloud.points_[source];
+            if (has_normals) {
+                result->normals_[i] = (*surface.normals)[source];
+            }
+            if (has_covariances) {
+                result->covariances_[i] = (*surface.covariances)[source];
+            }
+        }
+    });
+
+    return result;
+}
+
+RegistrationOutput register_entries(
+    Entry& source,
+    Entry& target,
+    RegistrationMethod method,
+    bool restrict_to_overlap,
+    std::function<bool(double)> update_progress
+) {
+    TraceSpan span("register_entries");
+
+    switch (method) {
+    case POINT_TO_PLANE:
+        // Only the target's tangent planes are used.
+        target.estimate_normals();
+        break;
+    case GENERALIZED_ICP:
+        source.estimate_normals();
+        target.estimate_normals();
+        break;
+    default:
+        break;
+    }
+
+    RegistrationOutput output;
+    output.parameters = estimate_registration_parameters(source, target);
+    output.cancelled = false;
+    output.iterations = 0;
+
+    double max_correspondence_distance = output.parameters.max_correspondence_distance;
+
+    // ICP runs in the coordinate system of the original data of the target, so that its cached search index,
+    // normals and covariances can be used as they are. Only the source is moved there.
+    Eigen::Matrix4d to_target = target.get_transformation().inverse();
+    SurfaceEstimate source_surface = source.get_surface();
+    SurfaceEstimate target_surface = target.get_surface();
+
+    open3d::geometry::PointCloud source_cloud = transformed_points(
+        source.get_base(),
+        to_target * source.get_transformation(),
+        method == GENERALIZED_ICP ? source_surface.covariances.get() : nullptr
+    );
+
+    const open3d::geometry::PointCloud& target_base = target.get_base();
+    std::vector<size_t> target_indices;
+
+    if (restrict_to_overlap) {
+        Overlap overlap = estimate_overlap(source_cloud, target_base, max_correspondence_distance);
+
+        if (overlap.source_indices.size() >= MIN_OVERLAP_POINTS && overlap.target_indices.size() >= MIN_OVERLAP_POINTS) {
+            source_cloud = *source_cloud.SelectByIndex(overlap.source_indices);
+            target_indices = std::move(overlap.target_indices);
+        }
+    }
+
+    // Point-to-point only reads the points of the target, the other methods need a cloud that carries their surface model.
+    // The search index over all target points is reused unless the target is cropped, then one index is built per run.
+    const open3d::geometry::PointCloud* target_cloud = &target_base;
+    std::shared_ptr<open3d::geometry::PointCloud> target_copy;
+    std::unique_ptr<open3d::geometry::KDTreeFlann> crop_index;
+
+    if (method != POINT_TO_POINT || !target_indices.empty()) {
+        target_copy = copy_target(target_base, target_surface, method, target_indices);
+        target_cloud = target_copy.get();
+    }
+
+    if (!target_indices.empty()) {
+        crop_index = std::make_unique<open3d::geometry::KDTreeFlann>(*target_cloud);
+    }
+    const open3d::geometry::KDTreeFlann& target_index = crop_index ? *crop_index : target.get_index();
+
+    std::unique_ptr<TransformationEstimation> estimation;
+    switch (method) {
+    case POINT_TO_PLANE:
+        estimation = std::make_unique<TransformationEstimationPointToPlane>();
+        break;
+    case GENERALIZED_ICP:
+        estimation = std::make_unique<TransformationEstimationForGeneralizedICP>();
+        break;
+    case POINT_TO_POINT:
+    default:
+        estimation = std::make_unique<TransformationEstimationPointToPoint>();
+        break;
+    }
+
+    int max_iteration = output.parameters.max_iteration;
+    Eigen::Matrix4d transformation = Eigen::Matrix4d::Identity();
+    RegistrationResult result = find_correspondences(source_cloud, target_index, max_correspondence_distance, transformation);
+
+    {
+        ScopedTimer timer(TIMER_ICP);
+        TraceSpan icp_span("icp");
+        int iteration = 0;
+
+        for (; iteration < max_iteration; iteration++) {
+            if (update_progress && !update_progress(double(iteration) / double(max_iteration))) {
+                output.cancelled = true;
+                break;
+            }
+
+            Eigen::Matrix4d update = estimation->ComputeTransformation(source_cloud, *target_cloud, result.correspondence_set_);
+            transformation = update * transformation;
+            source_cloud.Transform(update);
+
+            RegistrationResult previous = result;
+            result = find_correspondences(source_cloud, target_index, max_correspondence_distance, transformation);
+
+            if (std::abs(previous.fitness_ - result.fitness_) < output.parameters.relative_fitness
+                && std::abs(previous.inlier_rmse_ - result.inlier_rmse_) < output.parameters.rmse_change) {
+                iteration++;
+                break;
+            }
+        }
+
+        output.iterations = iteration;
+        timer.add_amount(iteration);
+    }
+
+    // The transformation moves the source within the original data of the target, the caller applies it to the transformed data.
+    output.result = result;
+    output.result.transformation_ = target.get_transformation() * transformation * to_target;
+    return output;
+}
+
+static bool is_collinear(const Eigen::Matrix3Xd& points) {
+    Eigen::Matrix3Xd centered = points.colwise() - points.rowwise().mean();
+    Eigen::JacobiSVD<Eigen::Matrix3Xd> svd(centered);
+    Eigen::Vector3d singular_values = svd.singularValues();
+
+    return singular_values(1) <= COLLINEAR_RATIO * singular_values(0);
+}
+
+std::optional<Eigen::Matrix4d> estimate_rigid_transform(
+    const std::vector<Eigen::Vector3d>& source,
+    const std::vector<Eigen::Vector3d>& target
+) {
+    if (source.size() != target.size() || source.size() < 3) {
+        return std::nullopt;
+    }
+
+    Eigen::Matrix3Xd source_points(3, source.size());
+    Eigen::Matrix3Xd target_points(3, target.size());
+
+    for (size_t i = 0; i < source.size(); i++) {
+        source_points.col(i) = source[i];
+        target_points.col(i) = target[i];
+    }
+
+    // A rotation around the line through collinear points is not determined by them.
+    if (is_collinear(source_points) || is_collinear(target_points)) {
+        return std::nullopt;
+    }
+
+    return Eigen::Matrix4d(Eigen::umeyama(source_points, target_points, false));
+}
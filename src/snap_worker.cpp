@@ -0,0 +1,135 @@
+#include <snap_worker.h>
+#include <tracing.h>
+
+#include <cmath>
+
+using namespace open3d::pipelines::registration;
+
+/// Number of points a proxy consists of, at most.
+static const size_t SNAP_PROXY_POINTS = 5000;
+
+/// Number of ICP iterations per request. Kept low, so that the worker keeps up with the user.
+static const int SNAP_ITERATIONS = 5;
+
+SnapWorker::SnapWorker(std::function<void(uint64_t, const Eigen::Matrix4d&)> on_result) :
+    on_result(on_result),
+    stopping(false),
+    generation(0),
+    pending(),
+    prepare(),
+    clouds_version(0),
+    clouds() {
+    thread = std::thread([this]() { this->run(); });
+}
+
+SnapWorker::~SnapWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_one();
+    thread.join();
+}
+
+void SnapWorker::set_clouds(std::function<SnapClouds()> prepare) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->prepare = prepare;
+    this->clouds_version++;
+    this->clouds = SnapClouds();
+    this->pending.reset();
+    this->generation++;
+}
+
+uint64_t SnapWorker::request(const Eigen::Matrix4d& pose) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = pose;
+        id = ++generation;
+    }
+    condition.notify_one();
+    return id;
+}
+
+void SnapWorker::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.reset();
+    generation++;
+}
+
+bool SnapWorker::is_current(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return id == generation;
+}
+
+std::shared_ptr<open3d::geometry::PointCloud> SnapWorker::make_proxy(const open3d::geometry::PointCloud& cloud) {
+    size_t every_k = std::max<size_t>(1, cloud.points_.size() / SNAP_PROXY_POINTS);
+    return cloud.UniformDownSample(every_k);
+}
+
+double SnapWorker::proxy_spacing(const open3d::geometry::PointCloud& cloud, double point_spacing) {
+    // Clouds sample surfaces, so spacing grows with the square root of the reduction.
+    double every_k = double(std::max<size_t>(1, cloud.points_.size() / SNAP_PROXY_POINTS));
+    return point_spacing * std::sqrt(every_k);
+}
+
+void SnapWorker::run() {
+    set_trace_thread_name("snap worker");
+
+    while (true) {
+        Eigen::Matrix4d pose;
+        uint64_t id;
+        std::function<SnapClouds()> prepare;
+        uint64_t version;
+        SnapClouds clouds;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || pending.has_value(); });
+
+            if (stopping) {
+                return;
+            }
+
+            pose = *pending;
+            pending.reset();
+            id = generation;
+            prepare = std::move(this->prepare);
+            this->prepare = nullptr;
+            version = clouds_version;
+            clouds = this->clouds;
+        }
+
+        if (prepare) {
+            TraceSpan span("snap_prepare");
+            clouds = prepare();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            // Other clouds were set while preparing, these ones are no longer needed.
+            if (version != clouds_version) {
+                continue;
+            }
+            this->clouds = clouds;
+        }
+
+        if (!clouds.source || !clouds.target || clouds.source->points_.empty() || clouds.target->points_.empty()) {
+            continue;
+        }
+
+        auto result = RegistrationICP(
+            *clouds.source,
+            *clouds.target,
+            clouds.max_correspondence_distance,
+            pose,
+            TransformationEstimationPointToPoint(),
+            ICPConvergenceCriteria(1e-6, 1e-6, SNAP_ITERATIONS)
+        );
+
+        // A newer request arrived in the meantime, so this result is already outdated.
+        if (!is_current(id)) {
+            continue;
+        }
+
+        on_result(id, result.transformation_);
+    }
+}
@@ -0,0 +1,220 @@
+#include <synthetic.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <random>
+
+#include <utils.h>
+
+/// Number of points generated from a single random state.
+static const size_t SYNTHETIC_BLOCK_SIZE = 1 << 16;
+/// Number of blocks generated in parallel before they are written to a file.
+static const size_t SYNTHETIC_WRITE_BATCH = 64;
+
+/// Edge length of the plane and the surface.
+static const double SYNTHETIC_SIZE = 10.0;
+/// Dimensions of the room.
+static const Eigen::Vector3d SYNTHETIC_ROOM_SIZE(8.0, 6.0, 3.0);
+
+static const double PI = 3.14159265358979323846;
+
+/// <summary>
+/// Mixes the bits of a value, so that neighbouring seeds produce unrelated random states.
+/// </summary>
+static uint64_t mix_seed(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ull;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+static double surface_height(double x, double y) {
+    return 0.5 * std::sin(0.8 * x) * std::cos(0.6 * y)
+        + 0.15 * std::sin(2.3 * x + 1.1 * y)
+        + 0.03 * std::sin(9.0 * x) * std::sin(7.0 * y);
+}
+
+/// <summary>
+/// Intersects a ray starting inside the room with its walls, floor or ceiling.
+/// </summary>
+static Eigen::Vector3d hit_room(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction) {
+    double t = std::numeric_limits<double>::infinity();
+
+    for (int axis = 0; axis < 3; axis++) {
+        if (direction[axis] > 0.0) {
+            t = std::min(t, (SYNTHETIC_ROOM_SIZE[axis] - origin[axis]) / direction[axis]);
+        }
+        else if (direction[axis] < 0.0) {
+            t = std::min(t, -origin[axis] / direction[axis]);
+        }
+    }
+
+    return origin + t * direction;
+}
+
+TransformationError compare_transformations(const Eigen::Matrix4d& estimate, const Eigen::Matrix4d& truth) {
+    Eigen::Matrix4d difference = truth.inverse() * estimate;
+    double cosine = std::clamp((difference.block<3, 3>(0, 0).trace() - 1.0) / 2.0, -1.0, 1.0);
+
+    TransformationError result;
+    result.rotation = std::acos(cosine);
+    result.translation = difference.block<3, 1>(0, 3).norm();
+    return result;
+}
+
+SyntheticScene::SyntheticScene(const SyntheticParameters& parameters_): parameters(parameters_) {
+    this->parameters.view_count = std::max<size_t>(this->parameters.view_count, 1);
+    this->parameters.overlap = std::clamp(this->parameters.overlap, 0.0, 1.0);
+
+    // Views are spaced so that together they cover the whole scene exactly once.
+    size_t gaps = this->parameters.view_count - 1;
+    this->view_width = 1.0 / (1.0 + double(gaps) * (1.0 - this->parameters.overlap));
+
+    std::mt19937_64 random(mix_seed(this->parameters.seed));
+    std::uniform_real_distribution<double> rotation(-this->parameters.max_rotation, this->parameters.max_rotation);
+    std::uniform_real_distribution<double> translation(-this->parameters.max_translation, this->parameters.max_translation);
+
+    this->ground_truth.push_back(Eigen::Matrix4d::Identity());
+    for (size_t i = 1; i < this->parameters.view_count; i++) {
+        double rx = rotation(random);
+        double ry = rotation(random);
+        double rz = rotation(random);
+        double tx = translation(random);
+        double ty = translation(random);
+        double tz = translation(random);
+        this->ground_truth.push_back(make_matrix(rx, ry, rz, tx, ty, tz));
+    }
+}
+
+size_t SyntheticScene::get_view_count() const {
+    return this->parameters.view_count;
+}
+
+const Eigen::Matrix4d& SyntheticScene::get_ground_truth(size_t view) const {
+    return this->ground_truth[view];
+}
+
+size_t SyntheticScene::get_block_count() const {
+    return (this->parameters.points_per_view + SYNTHETIC_BLOCK_SIZE - 1) / SYNTHETIC_BLOCK_SIZE;
+}
+
+size_t SyntheticScene::get_block_size(size_t block) const {
+    return std::min(SYNTHETIC_BLOCK_SIZE, this->parameters.points_per_view - block * SYNTHETIC_BLOCK_SIZE);
+}
+
+void SyntheticScene::generate_block(size_t view, size_t block, Eigen::Vector3d* points) const {
+    std::mt19937_64 random(mix_seed(mix_seed(this->parameters.seed ^ mix_seed(view)) ^ block));
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> noise(0.0, 1.0);
+
+    double view_start = double(view) * this->view_width * (1.0 - this->parameters.overlap);
+
+    // Maps points from the frame of the first view into the frame of this view.
+    Eigen::Matrix4d to_view = this->ground_truth[view].inverse();
+    Eigen::Matrix3d rotation = to_view.block<3, 3>(0, 0);
+    Eigen::Vector3d translation = to_view.block<3, 1>(0, 3);
+
+    size_t count = this->get_block_size(block);
+    for (size_t i = 0; i < count; i++) {
+        double u = view_start + this->view_width * uniform(random);
+        double v = uniform(random);
+        Eigen::Vector3d point;
+
+        switch (this->parameters.shape) {
+        case SYNTHETIC_PLANE:
+            point = Eigen::Vector3d(u * SYNTHETIC_SIZE, v * SYNTHETIC_SIZE, 0.0);
+            break;
+        case SYNTHETIC_ROOM: {
+            // Directions are distributed uniformly over the sphere, like the samples of a scanner.
+            double azimuth = 2.0 * PI * u;
+            double z = 2.0 * v - 1.0;
+            double r = std::sqrt(1.0 - z * z);
+            Eigen::Vector3d direction(r * std::cos(azimuth), r * std::sin(azimuth), z);
+            point = hit_room(0.5 * SYNTHETIC_ROOM_SIZE, direction);
+            break;
+        }
+        case SYNTHETIC_SURFACE:
+        default: {
+            double x = u * SYNTHETIC_SIZE;
+            double y = v * SYNTHETIC_SIZE;
+            point = Eigen::Vector3d(x, y, surface_height(x, y));
+            break;
+        }
+        }
+
+        if (this->parameters.noise > 0.0) {
+            point += this->parameters.noise * Eigen::Vector3d(noise(random), noise(random), noise(random));
+        }
+
+        points[i] = rotation * point + translation;
+    }
+}
+
+open3d::geometry::PointCloud SyntheticScene::generate_cloud(size_t view) const {
+    open3d::geometry::PointCloud cloud;
+    cloud.points_.resize(this->parameters.points_per_view);
+
+    parallel_for(this->get_block_count(), [this, view, &cloud](size_t start, size_t end) {
+        for (size_t block = start; block < end; block++) {
+            this->generate_block(view, block, cloud.points_.data() + block * SYNTHETIC_BLOCK_SIZE);
+        }
+    }, 2);
+
+    return cloud;
+}
+
+std::shared_ptr<Entry> SyntheticScene::generate_entry(size_t view) const {
+    auto entry = std::make_shared<Entry>(this->generate_cloud(view));
+    entry->name = std::string("Ansicht ") + std::to_string(view + 1);
+    return entry;
+}
+
+bool SyntheticScene::write_ply(size_t view, const std::string& path, std::function<bool(double)> update_progress) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    file << "ply\n"
+        << "format binary_little_endian 1.0\n"
+        << "element vertex " << this->parameters.points_per_view << "\n"
+        << "property float x\n"
+        << "property float y\n"
+        << "property float z\n"
+        << "end_header\n";
+
+    size_t block_count = this->get_block_count();
+    std::vector<Eigen::Vector3d> points(SYNTHETIC_WRITE_BATCH * SYNTHETIC_BLOCK_SIZE);
+    std::vector<float> buffer;
+
+    for (size_t first = 0; first < block_count; first += SYNTHETIC_WRITE_BATCH) {
+        size_t last = std::min(first + SYNTHETIC_WRITE_BATCH, block_count);
+
+        parallel_for(last - first, [this, view, first, &points](size_t start, size_t end) {
+            for (size_t i = start; i < end; i++) {
+                this->generate_block(view, first + i, points.data() + i * SYNTHETIC_BLOCK_SIZE);
+            }
+        }, 2);
+
+        size_t count = (last - first - 1) * SYNTHETIC_BLOCK_SIZE + this->get_block_size(last - 1);
+        buffer.resize(3 * count);
+        for (size_t i = 0; i < count; i++) {
+            buffer[3 * i + 0] = float(points[i].x());
+            buffer[3 * i + 1] = float(points[i].y());
+            buffer[3 * i + 2] = float(points[i].z());
+        }
+
+        file.write(reinterpret_cast<const char*>(buffer.data()), std::streamsize(buffer.size() * sizeof(float)));
+        if (!file) {
+            return false;
+        }
+
+        if (update_progress && !update_progress(double(last) / double(block_count))) {
+            return false;
+        }
+    }
+
+    return bool(file.flush());
+}
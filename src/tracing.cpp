@@ -0,0 +1,225 @@
+#include <tracing.h>
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+/// Spans are stored in chunks of this many spans.
+static const size_t TRACE_CHUNK_SIZE = 4096;
+
+/// Each thread records at most this many spans per trace, so that a forgotten trace cannot exhaust memory.
+static const size_t MAX_SPANS_PER_THREAD = 1 << 20;
+
+struct TraceEvent {
+    const char* name;
+    int64_t begin;
+    int64_t duration;
+};
+
+/// <summary>
+/// Part of the span list of one thread. Only the owning thread appends, publishing
+/// every span by incrementing `count`, so readers never see partially written spans.
+/// </summary>
+struct TraceChunk {
+    TraceEvent events[TRACE_CHUNK_SIZE];
+    std::atomic<size_t> count{ 0 };
+    std::atomic<TraceChunk*> next{ nullptr };
+};
+
+struct ThreadBuffer {
+    uint32_t thread_id;
+    std::atomic<const char*> name{ nullptr };
+
+    /// <summary>
+    /// The chunk list. `first` never changes, `last` and `span_count` are only used by the owning thread.
+    /// </summary>
+    TraceChunk* first;
+    TraceChunk* last;
+    size_t span_count;
+
+    /// <summary>
+    /// The trace the spans belong to, see `trace_epoch`. Only changed by the owning thread while holding `mutex`.
+    /// </summary>
+    uint64_t epoch;
+
+    /// <summary>
+    /// Held by the owning thread while it clears the spans of an earlier trace, and by `write_trace` while it reads them.
+    /// </summary>
+    std::mutex mutex;
+
+    ThreadBuffer* next_buffer;
+};
+
+/// Buffers of all threads that ever recorded. Buffers are never freed, so that spans of finished threads can still be written.
+static std::atomic<ThreadBuffer*> thread_buffers(nullptr);
+static std::atomic<uint32_t> next_thread_id(1);
+
+static std::atomic<bool> tracing_enabled(false);
+
+/// Spans are written relative to this point in time.
+static const std::chrono::steady_clock::time_point trace_origin = std::chrono::steady_clock::now();
+
+/// Spans that began before this offset from `trace_origin` belong to an earlier trace.
+static std::atomic<int64_t> trace_start(0);
+
+/// Counts the traces started so far. Buffers of an earlier trace are cleared by their thread when it records the next span.
+static std::atomic<uint64_t> trace_epoch(0);
+
+static int64_t since_origin(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time - trace_origin).count();
+}
+
+static ThreadBuffer& thread_buffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+
+    if (!buffer) {
+        buffer = new ThreadBuffer();
+        buffer->thread_id = next_thread_id.fetch_add(1);
+        buffer->first = new TraceChunk();
+        buffer->last = buffer->first;
+        buffer->span_count = 0;
+        buffer->epoch = trace_epoch.load();
+
+        buffer->next_buffer = thread_buffers.load();
+        while (!thread_buffers.compare_exchange_weak(buffer->next_buffer, buffer)) {}
+    }
+
+    return *buffer;
+}
+
+void set_tracing_enabled(bool enabled) {
+    if (enabled) {
+        trace_start.store(since_origin(std::chrono::steady_clock::now()));
+        trace_epoch.fetch_add(1);
+    }
+
+    tracing_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool is_tracing_enabled() {
+    return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+void set_trace_thread_name(const char* name) {
+    thread_buffer().name.store(name);
+}
+
+void record_trace_span(const char* name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+    ThreadBuffer& buffer = thread_buffer();
+
+    // The first span of a new trace makes room, so that the limit applies to every trace anew.
+    uint64_t epoch = trace_epoch.load(std::memory_order_relaxed);
+    if (buffer.epoch != epoch) {
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+
+        TraceChunk* chunk = buffer.first->next.load(std::memory_order_relaxed);
+        while (chunk) {
+            TraceChunk* next = chunk->next.load(std::memory_order_relaxed);
+            delete chunk;
+            chunk = next;
+        }
+
+        buffer.first->next.store(nullptr, std::memory_order_relaxed);
+        buffer.first->count.store(0, std::memory_order_relaxed);
+        buffer.last = buffer.first;
+        buffer.span_count = 0;
+        buffer.epoch = epoch;
+    }
+
+    if (buffer.span_count >= MAX_SPANS_PER_THREAD) {
+        return;
+    }
+
+    TraceChunk* chunk = buffer.last;
+    size_t count = chunk->count.load(std::memory_order_relaxed);
+
+    if (count == TRACE_CHUNK_SIZE) {
+        TraceChunk* next = new TraceChunk();
+        chunk->next.store(next, std::memory_order_release);
+        buffer.last = next;
+        chunk = next;
+        count = 0;
+    }
+
+    int64_t begin_ns = since_origin(begin);
+    chunk->events[count] = TraceEvent{ name, begin_ns, since_origin(end) - begin_ns };
+    chunk->count.store(count + 1, std::memory_order_release);
+    buffer.span_count++;
+}
+
+/// Writes a string as a JSON string literal.
+static void write_json_string(std::ofstream& out, const char* text) {
+    out << '"';
+
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\' << *c;
+        }
+        else if (static_cast<unsigned char>(*c) < 0x20) {
+            out << ' ';
+        }
+        else {
+            out << *c;
+        }
+    }
+
+    out << '"';
+}
+
+bool write_trace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+
+    int64_t start = trace_start.load();
+    uint64_t epoch = trace_epoch.load();
+    bool first_event = true;
+
+    auto separator = [&out, &first_event]() {
+        out << (first_event ? "\n" : ",\n");
+        first_event = false;
+    };
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (ThreadBuffer* buffer = thread_buffers.load(); buffer; buffer = buffer->next_buffer) {
+        // Threads that recorded nothing since the trace started only hold spans of earlier traces.
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        if (buffer->epoch != epoch) {
+            continue;
+        }
+
+        if (const char* name = buffer->name.load()) {
+            separator();
+            out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->thread_id << ",\"args\":{\"name\":";
+            write_json_string(out, name);
+            out << "}}";
+        }
+
+        for (TraceChunk* chunk = buffer->first; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+
+            for (size_t i = 0; i < count; i++) {
+                const TraceEvent& event = chunk->events[i];
+                if (event.begin < start) {
+                    continue;
+                }
+
+                // Timestamps are given in microseconds.
+                separator();
+                out << "{\"ph\":\"X\",\"name\":";
+                write_json_string(out, event.name);
+                out << ",\"pid\":1,\"tid\":" << buffer->thread_id
+                    << ",\"ts\":" << double(event.begin - start) / 1000.0
+                    << ",\"dur\":" << double(event.duration) / 1000.0 << "}";
+            }
+        }
+    }
+
+    out << "\n]}\n";
+    return bool(out);
+}
@@ -1,6 +1,10 @@
 #include <utils.h>
 #include <math.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 Eigen::Matrix4d make_matrix(double x_rotation, double y_rotation, double z_rotation, double x_translation, double y_translation, double z_translation) {
     double crx = cos(x_rotation);
     double srx = sin(x_rotation);
@@ -40,3 +44,73 @@ Eigen::Matrix4d make_matrix(double x_rotation, double y_rotation, double z_rotat
 
     return result;
 }
+
+/// Number of cores the calling thread may use for `parallel_for`, or 0 for all of them.
+/// Tasks of `for_each_parallel` get a share of the cores of the thread that started them.
+static thread_local size_t core_budget = 0;
+
+/// <summary>
+/// Returns the number of cores the calling thread may use.
+/// </summary>
+/// <returns></returns>
+static size_t available_cores() {
+    size_t core_count = std::max(1u, std::thread::hardware_concurrency());
+    return core_budget > 0 ? std::min(core_budget, core_count) : core_count;
+}
+
+void parallel_for(size_t count, const std::function<void(size_t, size_t)>& body, size_t min_parallel) {
+    size_t core_count = available_cores();
+
+    if (count < min_parallel || core_count == 1) {
+        body(0, count);
+        return;
+    }
+
+    size_t start = 0;
+    size_t diff = count / core_count;
+
+    std::vector<std::thread> threads;
+
+    for (size_t k = 0; k < core_count - 1; k++) {
+        threads.emplace_back([&body, start, diff]() { body(start, start + diff); });
+        start += diff;
+    }
+
+    body(start, count);
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void for_each_parallel(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+
+    size_t core_count = available_cores();
+    size_t thread_count = std::min(count, core_count);
+    std::atomic<size_t> next(0);
+
+    auto work = [&body, &next, count, core_count, thread_count](size_t k) {
+        size_t outer_budget = core_budget;
+        core_budget = core_count / thread_count + (k < core_count % thread_count ? 1 : 0);
+
+        for (size_t i = next++; i < count; i = next++) {
+            body(i);
+        }
+
+        core_budget = outer_budget;
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t k = 1; k < thread_count; k++) {
+        threads.emplace_back(work, k);
+    }
+
+    work(0);
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}